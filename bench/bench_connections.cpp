@@ -0,0 +1,337 @@
+// 连接数/延迟基准：单线程epoll客户端同时保持N个连接，每个连接循环发送同一个GET请求，
+// 统计吞吐、延迟分位数和出错数；给出服务器pid时按100ms采样服务器的线程数与常驻内存峰值。
+// 服务器回复Connection: close或主动断开时重新连接，新连接的请求延迟从connect开始计算，
+// 因此对每请求一个连接的旧模型与保持连接的事件循环使用同一套测量。
+//
+// 用法: bench_connections <host> <port> <path> <connections> <seconds> [server_pid]
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Client {
+    int fd = -1;
+    bool connecting = false;
+    std::string request;
+    size_t sent = 0;
+    std::string response;
+    size_t head_end = 0;            // 响应头结束位置（含空行），0表示未收完
+    long content_length = -1;       // -1表示没有Content-Length，读到连接关闭为止
+    bool close_after = false;
+    Clock::time_point started;
+};
+
+struct ServerSample {
+    long threads = 0;
+    long rss_kb = 0;
+};
+
+// 读取 /proc/<pid>/status 中的线程数和常驻内存
+bool sample_server(int pid, ServerSample& sample) {
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    if (!status.is_open()) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 8, "Threads:") == 0) {
+            sample.threads = std::atol(line.c_str() + 8);
+        } else if (line.compare(0, 6, "VmRSS:") == 0) {
+            sample.rss_kb = std::atol(line.c_str() + 6);
+        }
+    }
+    return true;
+}
+
+// 响应头收完后解析Content-Length与Connection
+void parse_head(Client& c) {
+    size_t pos = c.response.find("\r\n\r\n");
+    if (pos == std::string::npos) {
+        return;
+    }
+    c.head_end = pos + 4;
+    c.content_length = -1;
+    c.close_after = c.response.compare(0, 8, "HTTP/1.0") == 0;
+    size_t line = c.response.find("\r\n") + 2;
+    while (line < pos) {
+        size_t eol = c.response.find("\r\n", line);
+        std::string header = c.response.substr(line, eol - line);
+        size_t colon = header.find(':');
+        if (colon != std::string::npos) {
+            std::string name = header.substr(0, colon);
+            std::string value = header.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(' '));
+            if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+                c.content_length = std::atol(value.c_str());
+            } else if (strcasecmp(name.c_str(), "Connection") == 0) {
+                c.close_after = strcasecmp(value.c_str(), "close") == 0;
+            }
+        }
+        line = eol + 2;
+    }
+}
+
+class Bench {
+public:
+    Bench(const sockaddr_in& addr, const std::string& request, int server_pid)
+        : addr_(addr), request_(request), server_pid_(server_pid), errors_(0), reconnects_(0) {
+        epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    }
+
+    ~Bench() {
+        for (Client& c : clients_) {
+            if (c.fd >= 0) {
+                close(c.fd);
+            }
+        }
+        close(epfd_);
+    }
+
+    void run(size_t connections, double seconds) {
+        clients_.resize(connections);
+        Clock::time_point begin = Clock::now();
+        for (size_t i = 0; i < connections; ++i) {
+            open_connection(i);
+        }
+
+        std::vector<epoll_event> events(1024);
+        Clock::time_point deadline = begin + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(seconds));
+        Clock::time_point next_sample = begin;
+        while (Clock::now() < deadline) {
+            if (server_pid_ > 0 && Clock::now() >= next_sample) {
+                ServerSample sample;
+                if (sample_server(server_pid_, sample)) {
+                    peak_.threads = std::max(peak_.threads, sample.threads);
+                    peak_.rss_kb = std::max(peak_.rss_kb, sample.rss_kb);
+                }
+                next_sample += std::chrono::milliseconds(100);
+            }
+            int n = epoll_wait(epfd_, events.data(), static_cast<int>(events.size()), 50);
+            for (int i = 0; i < n; ++i) {
+                size_t index = events[i].data.u64;
+                if (events[i].events & EPOLLOUT) {
+                    handle_write(index);
+                } else {
+                    handle_read(index);
+                }
+            }
+        }
+        elapsed_ = std::chrono::duration<double>(Clock::now() - begin).count();
+        connected_ = 0;
+        for (const Client& c : clients_) {
+            connected_ += c.fd >= 0 && !c.connecting;
+        }
+    }
+
+    void report(size_t connections) {
+        std::sort(latencies_us_.begin(), latencies_us_.end());
+        auto percentile = [this](double p) -> double {
+            if (latencies_us_.empty()) {
+                return 0;
+            }
+            size_t i = static_cast<size_t>(p * (latencies_us_.size() - 1));
+            return latencies_us_[i] / 1000.0;
+        };
+        std::cout << "连接数 " << connections << "，结束时保持 " << connected_ << "，运行 " << elapsed_ << " 秒" << std::endl;
+        std::cout << "完成请求 " << latencies_us_.size() << "，" << latencies_us_.size() / elapsed_ << " 请求/秒"
+                  << "，其中非2xx " << not_ok_ << "，重新连接 " << reconnects_ << "，出错 " << errors_ << std::endl;
+        std::cout << "延迟(ms) p50 " << percentile(0.50) << "  p90 " << percentile(0.90)
+                  << "  p99 " << percentile(0.99) << "  max " << percentile(1.0) << std::endl;
+        if (server_pid_ > 0) {
+            std::cout << "服务器峰值 线程 " << peak_.threads << "，RSS " << peak_.rss_kb / 1024.0 << " MB" << std::endl;
+        }
+    }
+
+private:
+    sockaddr_in addr_;
+    std::string request_;
+    int server_pid_;
+    int epfd_;
+    std::vector<Client> clients_;
+    std::vector<uint32_t> latencies_us_;
+    size_t errors_;
+    size_t reconnects_;
+    size_t not_ok_ = 0;             // 非2xx响应（如过载时的503）
+    size_t connected_ = 0;
+    double elapsed_ = 0;
+    ServerSample peak_;
+
+    void watch(size_t index, uint32_t events, int op) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = index;
+        epoll_ctl(epfd_, op, clients_[index].fd, &ev);
+    }
+
+    void open_connection(size_t index) {
+        Client& c = clients_[index];
+        c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (c.fd < 0) {
+            std::cerr << "创建套接字失败: " << strerror(errno) << std::endl;
+            ++errors_;
+            return;
+        }
+        int one = 1;
+        setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        c.started = Clock::now();
+        c.request = request_;
+        c.sent = 0;
+        c.response.clear();
+        c.head_end = 0;
+        c.connecting = true;
+        int rc = connect(c.fd, reinterpret_cast<const sockaddr*>(&addr_), sizeof(addr_));
+        if (rc != 0 && errno != EINPROGRESS) {
+            fail(index);
+            return;
+        }
+        watch(index, EPOLLOUT, EPOLL_CTL_ADD);
+    }
+
+    // 出错或连接被关闭：记一次错误并重新连接
+    void fail(size_t index) {
+        ++errors_;
+        reconnect(index);
+    }
+
+    void reconnect(size_t index) {
+        Client& c = clients_[index];
+        if (c.fd >= 0) {
+            close(c.fd);
+            c.fd = -1;
+        }
+        ++reconnects_;
+        open_connection(index);
+    }
+
+    void start_request(size_t index) {
+        Client& c = clients_[index];
+        c.started = Clock::now();
+        c.sent = 0;
+        c.response.clear();
+        c.head_end = 0;
+        handle_write(index);
+    }
+
+    void handle_write(size_t index) {
+        Client& c = clients_[index];
+        if (c.connecting) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err != 0) {
+                fail(index);
+                return;
+            }
+            c.connecting = false;
+        }
+        while (c.sent < c.request.size()) {
+            ssize_t n = send(c.fd, c.request.data() + c.sent, c.request.size() - c.sent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EAGAIN) {
+                    watch(index, EPOLLOUT, EPOLL_CTL_MOD);
+                    return;
+                }
+                fail(index);
+                return;
+            }
+            c.sent += n;
+        }
+        watch(index, EPOLLIN, EPOLL_CTL_MOD);
+    }
+
+    void handle_read(size_t index) {
+        Client& c = clients_[index];
+        char buffer[16384];
+        bool eof = false;
+        while (true) {
+            ssize_t n = recv(c.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                c.response.append(buffer, n);
+                continue;
+            }
+            if (n == 0) {
+                eof = true;
+            } else if (errno != EAGAIN) {
+                fail(index);
+                return;
+            }
+            break;
+        }
+        if (c.head_end == 0) {
+            parse_head(c);
+        }
+        bool complete = c.head_end != 0 &&
+            (c.content_length >= 0 ? c.response.size() >= c.head_end + c.content_length : eof);
+        if (!complete) {
+            if (eof) {
+                fail(index);
+            }
+            return;
+        }
+
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - c.started).count();
+        latencies_us_.push_back(static_cast<uint32_t>(us));
+        if (c.response.size() < 10 || c.response[9] != '2') {
+            ++not_ok_;
+        }
+        if (c.close_after || eof) {
+            reconnect(index);
+        } else {
+            start_request(index);
+        }
+    }
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 6) {
+        std::cerr << "用法: " << argv[0] << " <host> <port> <path> <connections> <seconds> [server_pid]" << std::endl;
+        return 1;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(std::atoi(argv[2])));
+    if (inet_pton(AF_INET, argv[1], &addr.sin_addr) != 1) {
+        std::cerr << "无效的地址: " << argv[1] << std::endl;
+        return 1;
+    }
+    size_t connections = std::strtoul(argv[4], nullptr, 10);
+    double seconds = std::atof(argv[5]);
+    int server_pid = argc > 6 ? std::atoi(argv[6]) : 0;
+
+    // 每个连接一个描述符，按连接数提高软限制
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < connections + 64) {
+        limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, connections + 64);
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    std::ostringstream request;
+    request << "GET " << argv[3] << " HTTP/1.1\r\nHost: " << argv[1] << "\r\nConnection: keep-alive\r\n\r\n";
+
+    Bench bench(addr, request.str(), server_pid);
+    bench.run(connections, seconds);
+    bench.report(connections);
+    return 0;
+}
@@ -0,0 +1,159 @@
+// 请求解析基准：单线程反复解析几种典型请求头，输出每核每秒解析的请求数。
+// 对照组按原先 HttpServer::parse_request 的做法实现：istringstream逐行读取、
+// 每个头字段分配字符串、转小写后放入std::map、复制请求体。
+// 另外测量chunked请求体的解码速度。
+//
+// 用法: bench_http_parser [秒数]
+#include "http_parser.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstdlib>
+#include <cstdio>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Sample {
+    const char* name;
+    std::string raw;
+};
+
+std::vector<Sample> samples() {
+    std::vector<Sample> list;
+    list.push_back({"浏览器GET",
+        "GET /api/my-files?page=2&limit=20 HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+        "Accept: application/json, text/plain, */*\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "Cookie: session_id=0123456789abcdef0123456789abcdef\r\n"
+        "Referer: http://localhost/\r\n"
+        "Connection: keep-alive\r\n\r\n"});
+    list.push_back({"curl GET",
+        "GET /api/shared-files HTTP/1.1\r\nHost: localhost\r\nUser-Agent: curl/8.5.0\r\nAccept: */*\r\n\r\n"});
+    list.push_back({"JSON POST",
+        "POST /api/login HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 44\r\n"
+        "Origin: http://localhost\r\n"
+        "Connection: keep-alive\r\n\r\n"
+        "{\"username\":\"admin\",\"password\":\"admin123\"}\n"});
+    return list;
+}
+
+// 原先的解析方式，只保留与请求头相关的部分
+size_t parse_with_istringstream(const std::string& raw) {
+    std::istringstream iss(raw);
+    std::string line;
+    std::string method;
+    std::string target;
+    if (std::getline(iss, line)) {
+        std::istringstream line_iss(line);
+        line_iss >> method >> target;
+    }
+    std::map<std::string, std::string> headers;
+    while (std::getline(iss, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            break;
+        }
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            std::string name = line.substr(0, colon);
+            std::string value = line.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(' '));
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            headers[name] = value;
+        }
+    }
+    std::string body;
+    size_t header_end = raw.find("\r\n\r\n");
+    if (header_end != std::string::npos) {
+        body = raw.substr(header_end + 4);
+    }
+    return headers.size() + body.size() + method.size() + target.size();
+}
+
+size_t parse_with_http_parser(const std::string& raw) {
+    ParsedRequest req;
+    if (HttpParser::parse_head(raw.data(), raw.size(), req, 65536) != HttpParser::Result::Complete) {
+        std::cerr << "解析失败" << std::endl;
+        std::exit(1);
+    }
+    return req.header_count + req.content_length + req.method.size() + req.target.size();
+}
+
+// 在给定时间内每批调用fn batch次，返回每秒调用次数
+template <typename Fn>
+double rate(double seconds, int batch, Fn fn) {
+    size_t sink = 0;
+    size_t calls = 0;
+    Clock::time_point begin = Clock::now();
+    Clock::time_point deadline = begin + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(seconds));
+    while (Clock::now() < deadline) {
+        for (int i = 0; i < batch; ++i) {
+            sink += fn();
+        }
+        calls += batch;
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+    if (sink == 0) {
+        std::cerr << "结果为空" << std::endl;
+    }
+    return calls / elapsed;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 2.0;
+
+    std::cout << "扫描实现: " << HttpParser::simd_level() << std::endl;
+    for (const Sample& sample : samples()) {
+        double before = rate(seconds, 1000, [&sample]() { return parse_with_istringstream(sample.raw); });
+        double after = rate(seconds, 1000, [&sample]() { return parse_with_http_parser(sample.raw); });
+        std::cout << sample.name << " (" << sample.raw.size() << " 字节): istringstream "
+                  << before / 1e6 << " M请求/秒，HttpParser " << after / 1e6 << " M请求/秒，"
+                  << after / before << " 倍" << std::endl;
+    }
+
+    // chunked解码：1MB请求体切成4KB的块
+    std::string encoded;
+    const size_t kChunk = 4096;
+    const size_t kBody = 1024 * 1024;
+    std::string piece(kChunk, 'x');
+    char size_line[32];
+    for (size_t sent = 0; sent < kBody; sent += kChunk) {
+        snprintf(size_line, sizeof(size_line), "%zx\r\n", kChunk);
+        encoded += size_line;
+        encoded += piece;
+        encoded += "\r\n";
+    }
+    encoded += "0\r\n\r\n";
+    std::string out;
+    out.reserve(kBody);
+    double decodes = rate(seconds, 1, [&encoded, &out]() -> size_t {
+        ChunkedDecoder decoder;
+        out.clear();
+        size_t consumed = 0;
+        if (!decoder.feed(encoded.data(), encoded.size(), out, consumed) || !decoder.done()) {
+            std::cerr << "chunked解码失败" << std::endl;
+            std::exit(1);
+        }
+        return out.size();
+    });
+    std::cout << "chunked解码 (4KB块): " << decodes * kBody / (1024 * 1024) << " MB/秒" << std::endl;
+    return 0;
+}
@@ -0,0 +1,117 @@
+// 登录口令校验基准：新建数据库并注册一个用户（当前默认参数 scrypt N=2^15, r=8, p=1），
+// 先在单个线程中串行调用 Database::checkPassword，再用多个客户端线程同时调用使KDF线程池饱和，
+// 输出每秒校验通过的次数、每次校验的平均耗时，以及因排队已满返回 Busy 的次数。
+//
+// 用法: bench_password_hasher [数据库路径] [并发线程数] [秒数]
+#include "database.h"
+#include "password_hasher.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* kUser = "bench_user";
+const char* kPassword = "correct horse battery staple";
+const int kBusyBackoffMs = 10;
+
+struct Counts {
+    std::atomic<uint64_t> valid{0};
+    std::atomic<uint64_t> busy{0};
+    std::atomic<uint64_t> invalid{0};
+    std::atomic<uint64_t> valid_micros{0};  // 校验通过的调用的总耗时
+};
+
+// 在给定时间内反复校验，直到截止时间后的第一次调用返回
+void run_client(Database& db, Clock::time_point deadline, Counts& counts) {
+    while (Clock::now() < deadline) {
+        Clock::time_point begin = Clock::now();
+        Database::PasswordCheck result = db.checkPassword(kUser, kPassword);
+        uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - begin).count();
+        switch (result) {
+            case Database::PasswordCheck::Valid:
+                counts.valid.fetch_add(1);
+                counts.valid_micros.fetch_add(micros);
+                break;
+            case Database::PasswordCheck::Busy:
+                // 登录接口此时回复503，客户端稍后重试；不等待的话被拒绝的线程会空转抢占KDF线程的CPU
+                counts.busy.fetch_add(1);
+                std::this_thread::sleep_for(std::chrono::milliseconds(kBusyBackoffMs));
+                break;
+            default:
+                counts.invalid.fetch_add(1);
+                break;
+        }
+    }
+}
+
+void report(const char* name, const Counts& counts, double seconds) {
+    uint64_t valid = counts.valid.load();
+    std::cout << name << ": " << valid / seconds << " 次/秒，平均 "
+              << (valid > 0 ? counts.valid_micros.load() / 1000.0 / valid : 0.0) << " 毫秒/次，Busy "
+              << counts.busy.load() << "，失败 " << counts.invalid.load() << std::endl;
+}
+
+double seconds_since(Clock::time_point begin) {
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string path = argc > 1 ? argv[1] : "bench_password_hasher.db";
+    int clients = argc > 2 ? std::atoi(argv[2]) : 200;
+    double seconds = argc > 3 ? std::atof(argv[3]) : 5.0;
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::remove((path + suffix).c_str());
+    }
+
+    std::string encoded;
+    PasswordHasher::hash_now(kPassword, encoded);
+    size_t params_end = 0;
+    for (int i = 0; i < 4 && params_end != std::string::npos; ++i) {   // "scrypt$logN$r$p$" 之后是盐
+        params_end = encoded.find('$', params_end + 1);
+    }
+    std::cout << "哈希参数: " << encoded.substr(0, params_end) << "，CPU " << std::thread::hardware_concurrency()
+              << " 核" << std::endl;
+
+    {
+        Database db(path);
+        if (!db.initialize() || !db.createUser(kUser, kPassword)) {
+            std::cerr << "数据库初始化或注册用户失败" << std::endl;
+            return 1;
+        }
+
+        Counts serial;
+        Clock::time_point begin = Clock::now();
+        run_client(db, begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds)), serial);
+        report("串行", serial, seconds_since(begin));
+
+        Counts saturated;
+        std::vector<std::thread> threads;
+        begin = Clock::now();
+        Clock::time_point deadline = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        for (int i = 0; i < clients; ++i) {
+            threads.emplace_back(run_client, std::ref(db), deadline, std::ref(saturated));
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        std::string name = std::to_string(clients) + " 个并发客户端";
+        report(name.c_str(), saturated, seconds_since(begin));
+        db.close();
+    }
+
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::remove((path + suffix).c_str());
+    }
+    return 0;
+}
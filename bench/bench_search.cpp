@@ -0,0 +1,134 @@
+// 全文搜索基准：新建数据库，在一个事务里写入合成的文件目录（默认100万行，三分之二已分享），
+// 由迁移建立的触发器同步维护 files_fts；然后对几类查询在给定时间内反复调用
+// Database::searchFiles（每页20行），输出每次调用的平均耗时和命中行数：
+//   精确     每行独有的编号，只命中一行
+//   约千行   1000个项目名之一，约 行数/1000 行
+//   宽泛     4个类别词之一，约 行数/4 行，全部参与bm25排序
+//   LIKE常见 两个字的词（三元组索引用不上），按时间顺序扫描，很快凑满一页
+//   LIKE无果 两个字且不存在的词，最坏情况：扫描上限内的全部行（最新的2万个文件）
+//
+// 用法: bench_search [数据库路径] [行数] [每类秒数]
+#include "database.h"
+#include <sqlite3.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* kKinds[] = {"report", "invoice", "photo", "backup"};
+const char* kTopics[] = {"季度报告", "会议纪要", "产品设计", "客户资料"};
+const int kViewerId = 2;    // 不是上传者，只能搜到已分享的文件
+
+double seconds_since(Clock::time_point begin) {
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+// 用一个连接在单个事务中批量写入；逐行走 Database::addFile 时每行都是一个事务
+bool build_catalog(const std::string& path, int rows) {
+    sqlite3* db = nullptr;
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+        sqlite3_close(db);
+        return false;
+    }
+    sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(db,
+        "INSERT INTO files (filename, filepath, file_type, file_size, uploader_id, upload_time, category, is_shared, description) "
+        "VALUES (?, ?, 'text/plain', ?, 1, datetime('2024-01-01', '+' || ? || ' seconds'), ?, ?, ?)",
+        -1, &stmt, nullptr);
+    bool ok = stmt != nullptr;
+    char name[96];
+    char description[96];
+    for (int i = 0; ok && i < rows; ++i) {
+        const char* kind = kKinds[i % 4];
+        std::snprintf(name, sizeof(name), "%s_proj%03d_f%07d.txt", kind, (i / 4) % 1000, i);
+        std::snprintf(description, sizeof(description), "%s %s 第%d版", kTopics[(i / 7) % 4], kind, i % 10);
+        std::string filepath = std::string("shared/documents/") + name;
+        sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, filepath.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 3, 1024 + i % 4096);
+        sqlite3_bind_int(stmt, 4, i);
+        sqlite3_bind_text(stmt, 5, "documents", -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 6, i % 3 != 0 ? 1 : 0);
+        sqlite3_bind_text(stmt, 7, description, -1, SQLITE_STATIC);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    ok = ok && sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr) == SQLITE_OK;
+    sqlite3_close(db);
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string path = argc > 1 ? argv[1] : "bench_search.db";
+    int rows = argc > 2 ? std::atoi(argv[2]) : 1000000;
+    double seconds = argc > 3 ? std::atof(argv[3]) : 2.0;
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::remove((path + suffix).c_str());
+    }
+
+    // 先由Database执行迁移，建好表、索引和FTS触发器
+    {
+        Database db(path);
+        if (!db.initialize()) {
+            std::cerr << "数据库初始化失败" << std::endl;
+            return 1;
+        }
+        db.close();
+    }
+    Clock::time_point build_begin = Clock::now();
+    if (!build_catalog(path, rows)) {
+        std::cerr << "写入合成目录失败" << std::endl;
+        return 1;
+    }
+    std::cout << "写入 " << rows << " 行（含FTS索引）: " << seconds_since(build_begin) << " 秒" << std::endl;
+
+    char exact[16];
+    std::snprintf(exact, sizeof(exact), "f%07d", rows / 6 * 3 + 1);   // 行号不是3的倍数的已分享
+    struct Query {
+        const char* name;
+        std::string keyword;
+    };
+    std::vector<Query> queries = {
+        {"精确", exact},
+        {"约千行", "proj042"},
+        {"宽泛", "invoice"},
+        {"LIKE常见", "纪要"},
+        {"LIKE无果", "zq"},
+    };
+
+    {
+        Database db(path);
+        if (!db.initialize()) {
+            std::cerr << "数据库初始化失败" << std::endl;
+            return 1;
+        }
+        for (const Query& query : queries) {
+            size_t hits = db.searchFiles(query.keyword, kViewerId, 20, 0).size();   // 预热，并记录首页行数
+            size_t calls = 0;
+            Clock::time_point begin = Clock::now();
+            do {
+                db.searchFiles(query.keyword, kViewerId, 20, 0);
+                ++calls;
+            } while (seconds_since(begin) < seconds);
+            double ms = seconds_since(begin) * 1000.0 / calls;
+            std::cout << query.name << " \"" << query.keyword << "\": " << ms << " 毫秒/次，首页 " << hits
+                      << " 行，共 " << calls << " 次" << std::endl;
+        }
+        db.close();
+    }
+
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::remove((path + suffix).c_str());
+    }
+    return 0;
+}
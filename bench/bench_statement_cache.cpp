@@ -0,0 +1,86 @@
+// 预编译语句缓存基准：新建数据库写入一批文件并分享其中一半，
+// 然后在给定时间内反复调用 getSharedFiles（每页100行，循环翻页）和 getFileById，
+// 输出每次调用的平均耗时，以及预编译语句缓存的命中/未命中次数。
+//
+// 用法: bench_statement_cache [数据库路径] [文件数] [秒数]
+#include "database.h"
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 在给定时间内反复调用fn(i)，返回每次调用的平均微秒数
+template <typename Fn>
+double micros_per_call(double seconds, Fn fn) {
+    size_t calls = 0;
+    Clock::time_point begin = Clock::now();
+    Clock::time_point deadline = begin + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(seconds));
+    while (Clock::now() < deadline) {
+        for (int i = 0; i < 100; ++i) {
+            fn(calls++);
+        }
+    }
+    return std::chrono::duration<double, std::micro>(Clock::now() - begin).count() / calls;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string path = argc > 1 ? argv[1] : "bench_statement_cache.db";
+    int file_count = argc > 2 ? std::atoi(argv[2]) : 2000;
+    double seconds = argc > 3 ? std::atof(argv[3]) : 3.0;
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::remove((path + suffix).c_str());
+    }
+
+    {
+        Database db(path);
+        if (!db.initialize()) {
+            std::cerr << "数据库初始化失败" << std::endl;
+            return 1;
+        }
+        for (int i = 0; i < file_count; ++i) {
+            std::string name = "file_" + std::to_string(i) + ".txt";
+            if (!db.addFile(name, "shared/documents/" + name, "text/plain", 1024 + i, 1, "documents")) {
+                std::cerr << "写入文件记录失败" << std::endl;
+                return 1;
+            }
+        }
+        for (int id = 1; id <= file_count; id += 2) {
+            db.toggleFileShare(id, true);
+        }
+
+        int pages = std::max(1, file_count / 2 / 100);
+        size_t rows = 0;
+        double list_us = micros_per_call(seconds, [&](size_t i) {
+            rows += db.getSharedFiles(100, static_cast<int>(i % pages) * 100).size();
+        });
+        size_t found = 0;
+        double lookup_us = micros_per_call(seconds, [&](size_t i) {
+            FileInfo* file = db.getFileById(static_cast<int>(i % file_count) + 1);
+            found += file != nullptr;
+            delete file;
+        });
+
+        std::cout << "文件 " << file_count << "，已分享 " << (file_count + 1) / 2 << std::endl;
+        std::cout << "getSharedFiles(100行/页): " << list_us << " 微秒/次" << std::endl;
+        std::cout << "getFileById: " << lookup_us << " 微秒/次" << std::endl;
+        std::cout << "语句缓存 命中 " << db.statementCacheHits() << "，未命中 " << db.statementCacheMisses() << std::endl;
+        if (rows == 0 || found == 0) {
+            std::cerr << "查询没有返回结果" << std::endl;
+        }
+        db.close();
+    }
+
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::remove((path + suffix).c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+// 落盘策略基准：多个线程按上传提交的顺序写入文件——写临时文件、sync_before_commit、
+// store_blob改名到对象目录、sync_after_commit——分别在 None、PerFile、Batched 三种策略下
+// 运行给定时间，输出每秒完成的文件数和写入速度。
+// 对象名用计数器散列出的64位十六进制串代替内容的SHA-256，同样均匀分布在两级目录中，
+// 计算哈希的开销不计入。文件写在给定目录下新建的 bench_sync_storage 子目录中，运行前后整个删除；
+// 给定目录应位于待测的磁盘上。
+//
+// 用法: bench_sync_policy [目录] [线程数] [文件KB] [每种策略秒数]
+#include "file_manager.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <filesystem>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// splitmix64，把连续的计数器打散成均匀分布的对象名
+uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+std::string object_name(uint64_t seq) {
+    char hex[65];
+    for (int i = 0; i < 4; ++i) {
+        std::snprintf(hex + i * 16, 17, "%016llx", static_cast<unsigned long long>(mix(seq * 4 + i)));
+    }
+    return std::string(hex, 64);
+}
+
+struct Counts {
+    std::atomic<uint64_t> files{0};
+    std::atomic<uint64_t> failed{0};
+};
+
+// 与上传路径相同的步骤：写临时文件 → 提交前同步 → 改名到位 → 提交后同步
+void run_writer(FileManager& files, const std::string& root, const std::vector<char>& content,
+                std::atomic<uint64_t>& seq, Clock::time_point deadline, Counts& counts) {
+    std::string upload_dir = root + "/.uploads/";
+    while (Clock::now() < deadline) {
+        uint64_t n = seq.fetch_add(1);
+        std::string temp_path = upload_dir + std::to_string(n) + ".part";
+        int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        bool ok = fd >= 0 && write(fd, content.data(), content.size()) == static_cast<ssize_t>(content.size());
+        if (fd >= 0) {
+            close(fd);
+        }
+        ok = ok && files.sync_before_commit(temp_path) && files.store_blob(temp_path, object_name(n)) &&
+             files.sync_after_commit();
+        (ok ? counts.files : counts.failed).fetch_add(1);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string root = std::string(argc > 1 ? argv[1] : ".") + "/bench_sync_storage";
+    int threads = argc > 2 ? std::atoi(argv[2]) : 8;
+    size_t file_kb = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 64;
+    double seconds = argc > 4 ? std::atof(argv[4]) : 3.0;
+
+    std::vector<char> content(file_kb * 1024);
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = static_cast<char>(mix(i));
+    }
+
+    struct Policy {
+        const char* name;
+        FileManager::SyncPolicy policy;
+    };
+    const Policy policies[] = {
+        {"None", FileManager::SyncPolicy::None},
+        {"PerFile", FileManager::SyncPolicy::PerFile},
+        {"Batched", FileManager::SyncPolicy::Batched},
+    };
+
+    std::cout << threads << " 个线程，每个文件 " << file_kb << "KB" << std::endl;
+    for (const Policy& policy : policies) {
+        // 每种策略都从空目录开始，目录规模和页缓存中的脏页相同
+        std::filesystem::remove_all(root);
+        sync();
+        FileManager files(root);
+        if (!files.initialize()) {
+            std::cerr << "存储目录初始化失败: " << root << std::endl;
+            return 1;
+        }
+        files.setSyncPolicy(policy.policy);
+
+        Counts counts;
+        std::atomic<uint64_t> seq{0};
+        std::vector<std::thread> writers;
+        Clock::time_point begin = Clock::now();
+        Clock::time_point deadline = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        for (int i = 0; i < threads; ++i) {
+            writers.emplace_back(run_writer, std::ref(files), std::cref(root), std::cref(content), std::ref(seq),
+                                 deadline, std::ref(counts));
+        }
+        for (std::thread& writer : writers) {
+            writer.join();
+        }
+        double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+        files.setSyncPolicy(FileManager::SyncPolicy::None);    // 停止组提交线程
+
+        uint64_t done = counts.files.load();
+        std::cout << policy.name << ": " << done / elapsed << " 文件/秒，"
+                  << done * content.size() / elapsed / (1024 * 1024) << " MB/秒，失败 " << counts.failed.load()
+                  << std::endl;
+    }
+
+    std::filesystem::remove_all(root);
+    return 0;
+}
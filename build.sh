@@ -52,6 +52,15 @@ else
     echo "✓ OpenSSL 开发库已安装"
 fi
 
+# 检查 zlib 与 brotli 开发库
+if ! pkg-config --exists zlib libbrotlienc; then
+    echo "✗ zlib 或 brotli 开发库未安装"
+    echo "请安装: sudo apt install zlib1g-dev libbrotli-dev"
+    exit 1
+else
+    echo "✓ zlib 与 brotli 开发库已安装"
+fi
+
 echo
 echo "所有依赖检查完成，开始构建..."
 
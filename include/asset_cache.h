@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <ctime>
+#include <sys/types.h>
+
+// 缓存中的一个静态文件，加载后不再修改，可在多个请求间共享
+struct StaticAsset {
+    std::string content_type;
+    std::string body;            // 原始内容
+    std::string gzip;            // 预压缩变体，压缩收益不足时为空
+    std::string brotli;
+    std::string etag;            // 基于内容SHA-256的强ETag（含引号）
+    std::string last_modified;
+    std::string cache_control;
+    off_t size;
+    struct timespec mtime;
+};
+
+/**
+ * 静态资源内存缓存
+ * 启动时加载静态目录下的文件，保存内容、预压缩变体、强ETag和MIME类型；
+ * 通过inotify监听目录变化并重新加载，inotify不可用时每次访问按mtime校验。
+ * 文件名带内容哈希（如 app.3f9a1c2b.js）的资源标记为immutable，可被浏览器长期缓存
+ */
+class AssetCache {
+public:
+    using CompressiblePredicate = std::function<bool(const std::string& content_type)>;
+
+    AssetCache(const std::string& root, CompressiblePredicate compressible);
+    ~AssetCache();
+
+    AssetCache(const AssetCache&) = delete;
+    AssetCache& operator=(const AssetCache&) = delete;
+
+    // 加载整个目录并启动监听线程
+    bool start();
+    void stop();
+
+    // 按文件路径（root + 请求路径）查找，未缓存或超出容量时返回nullptr
+    std::shared_ptr<const StaticAsset> find(const std::string& path);
+
+    // 静态文件的Content-Type
+    static std::string content_type_for(const std::string& path);
+
+private:
+    std::string root_;
+    CompressiblePredicate compressible_;
+
+    std::shared_mutex mutex_;
+    std::map<std::string, std::shared_ptr<const StaticAsset>> assets_;
+    size_t total_bytes_;
+
+    int inotify_fd_;
+    std::map<int, std::string> watch_dirs_;   // inotify watch描述符 -> 目录
+    std::thread watcher_;
+    std::atomic<bool> running_;
+
+    std::shared_ptr<const StaticAsset> load_file(const std::string& path);
+    void reload(const std::string& path);
+    void remove(const std::string& path);
+    void add_watch(const std::string& dir);
+    void watch_loop();
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+// 响应内容编码
+enum class ContentEncoding {
+    Identity,
+    Gzip,
+    Deflate,
+    Brotli
+};
+
+/**
+ * HTTP内容压缩
+ * 负责Accept-Encoding协商以及gzip/deflate（zlib流式）和brotli编码
+ */
+class Compression {
+public:
+    // 按Accept-Encoding选择编码：优先q值高者，q值相同时br > gzip > deflate；
+    // allow_brotli为false时不选择br（动态响应只用zlib，brotli仅用于预压缩的静态文件）
+    static ContentEncoding negotiate(const std::string& accept_encoding, bool allow_brotli);
+    
+    // Content-Encoding头的取值
+    static const char* encoding_name(ContentEncoding encoding);
+    
+    // 把整个input压缩后追加到out（内部以64KB为单位分块喂给zlib）；encoding须为Gzip或Deflate
+    static bool zlib_compress(const std::string& input, ContentEncoding encoding,
+                              std::string& out, int level = 6);
+    
+    static bool brotli_compress(const std::string& input, std::string& out, int quality = 11);
+};
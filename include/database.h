@@ -1,9 +1,17 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
 #include <sqlite3.h>
+#include "statement_cache.h"
+#include "session_cache.h"
+#include "download_counter.h"
+#include "password_hasher.h"
 
 // 用户信息结构
 struct User {
@@ -19,25 +27,43 @@ struct User {
 
 // 文件信息结构
 struct FileInfo {
-    int id;
+    int id = 0;
+    int uploader_id = 0;
+    int download_count = 0;
+    bool is_public = false;
+    bool is_shared = false;    // 是否分享
+    long file_size = 0;
     std::string filename;
     std::string filepath;
-    std::string mime_type;
-    std::string file_type;      // 添加file_type字段
-    long size;
-    long file_size;             // 添加file_size字段 
-    std::string uploader;
-    int uploader_id;            // 添加uploader_id字段
+    std::string file_type;     // MIME类型
+    std::string uploader;      // 上传者用户名，查询未关联用户表时为空
     std::string upload_time;
-    std::string uploaded_at;    // 添加uploaded_at字段
-    std::string category;  // "video", "document", "image", "other"
-    int download_count;
-    bool is_public;
-    bool is_shared;            // 是否分享
+    std::string category;      // "videos", "documents", "images", "others"
     std::string shared_at;     // 分享时间
     std::string description;   // 文件描述
 };
 
+// 列表查询的一行，字段与FileInfo相同，文本直接指向SQLite的列缓冲区，只在回调期间有效。
+// 列表接口用它把结果直接序列化成JSON，不必为每行构造FileInfo
+struct FileRow {
+    int id = 0;
+    int uploader_id = 0;
+    int download_count = 0;
+    bool is_public = false;
+    bool is_shared = false;
+    long file_size = 0;
+    std::string_view filename;
+    std::string_view filepath;
+    std::string_view file_type;
+    std::string_view uploader;
+    std::string_view upload_time;
+    std::string_view category;
+    std::string_view shared_at;
+    std::string_view description;
+};
+
+using FileRowVisitor = std::function<void(const FileRow&)>;
+
 // 会话信息结构
 struct Session {
     std::string session_id;
@@ -48,9 +74,20 @@ struct Session {
     std::string expires_at;     // 添加expires_at字段
 };
 
+// 列表游标：上一页最后一行的排序时间（upload_time 或 shared_at）和id，下一页从它之后继续
+struct FileCursor {
+    std::string key;
+    int id;
+    
+    FileCursor() : id(0) {}
+    FileCursor(const std::string& key, int id) : key(key), id(id) {}
+};
+
 /**
  * 数据库管理类
- * 负责SQLite数据库的所有操作，包括用户管理、文件管理、会话管理等
+ * 负责SQLite数据库的所有操作，包括用户管理、文件管理、会话管理等。
+ * 数据库运行在WAL模式下：写操作经唯一的写连接串行执行，查询从只读连接池中各取一个连接，
+ * 读写互不阻塞，多个工作线程的查询可以并行
  */
 class Database {
 public:
@@ -62,6 +99,10 @@ public:
     
     // 关闭数据库连接
     void close();
+    
+    // 用EXPLAIN QUERY PLAN检查热点查询是否仍走索引，出现全表扫描或临时排序时记录日志并返回false。
+    // 调试构建中initialize遇到退化直接失败；tools/check_query_plans在ctest中对新建的数据库执行同样的检查
+    bool checkQueryPlans();
 
     // === 用户管理 ===
     // 创建用户
@@ -70,6 +111,11 @@ public:
     // 验证用户登录
     User* authenticateUser(const std::string& username, const std::string& password);
     
+    // 校验用户名密码；KDF线程池繁忙时返回Busy，由调用方提示稍后重试。
+    // 密码正确但哈希是旧格式或旧参数时，顺便用当前参数重新哈希写回
+    enum class PasswordCheck { Valid, Invalid, Busy };
+    PasswordCheck checkPassword(const std::string& username, const std::string& password);
+    
     // 根据ID获取用户
     User* getUserById(int user_id);
     
@@ -96,6 +142,15 @@ public:
     
     // 获取用户上传的文件
     std::vector<FileInfo> getUserFiles(int user_id, int limit = 100, int offset = 0);
+    std::vector<FileInfo> getUserFiles(int user_id, int limit, const FileCursor& after);  // 游标分页
+    
+    // 列表的流式版本：逐行回调，不构造FileInfo，返回行数
+    size_t listUserFiles(int user_id, int limit, int offset, const FileRowVisitor& visit);
+    size_t listUserFiles(int user_id, int limit, const FileCursor& after, const FileRowVisitor& visit);
+    size_t listSharedFiles(int limit, int offset, const FileRowVisitor& visit);
+    size_t listSharedFiles(int limit, const FileCursor& after, const FileRowVisitor& visit);
+    size_t listFiles(int limit, int offset, const std::string& category, const FileRowVisitor& visit);
+    size_t listFiles(int limit, const FileCursor& after, const std::string& category, const FileRowVisitor& visit);
     
     // 获取公开文件列表
     std::vector<FileInfo> getPublicFiles(int limit = 100, int offset = 0);
@@ -105,6 +160,7 @@ public:
     
     // 获取所有分享的文件
     std::vector<FileInfo> getSharedFiles(int limit = 100, int offset = 0);
+    std::vector<FileInfo> getSharedFiles(int limit, const FileCursor& after);  // 游标分页
     
     // 管理员获取所有文件（包含完整信息）
     std::vector<FileInfo> getAllFilesForAdmin();
@@ -118,20 +174,44 @@ public:
     // 获取用户存储使用情况
     std::pair<long, long> getUserStorageInfo(int user_id); // 返回 (已使用, 配额)
     
+    // 上传提交：在一个BEGIN IMMEDIATE事务中按条件占用配额、插入文件记录并更新storage_used，
+    // 同一用户并发上传时不会超出配额。成功时file_id为新记录ID；配额不足时available为剩余空间。
+    // 文件内容按content_hash去重：blobs表中该内容的引用计数加一；所有语句执行成功后、提交前在写锁内
+    // 调用store_content把内容放到filepath（已存在则丢弃上传的副本），返回false时整个上传回滚，
+    // 提交失败时删除本次新增的内容
+    enum class UploadStatus { Committed, QuotaExceeded, Failed };
+    UploadStatus commitUpload(const std::string& filename, const std::string& filepath,
+                              const std::string& file_type, long file_size, int uploader_id,
+                              const std::string& category, const std::string& content_hash,
+                              const std::function<bool()>& store_content, int& file_id, long& available);
+    
     // 根据分类获取文件
     std::vector<FileInfo> getFilesByCategory(const std::string& category, int limit = 100, int offset = 0);
     
     // 根据ID获取文件信息
     FileInfo* getFileById(int file_id);
     
-    // 更新文件下载次数
+    // 更新文件下载次数：只在内存中累加，后台每5秒批量写入一次，关闭数据库时写入剩余部分；
+    // 因此文件信息中的download_count最多滞后一个周期，进程崩溃时最多丢失一个周期的计数
     bool incrementDownloadCount(int file_id);
     
-    // 删除文件记录
-    bool deleteFile(int file_id);
+    // 把累积的下载次数在一个事务中写入files表，失败时放回下个周期重试
+    bool flushDownloadCounts();
+    
+    // 删除文件记录并退还上传者的存储用量；文件内容不再被任何记录引用时（或是去重之前的旧文件），
+    // 在同一写锁内调用remove_content删除磁盘上的内容，不会误删同时上传的相同内容
+    bool deleteFile(int file_id, const std::function<void(const std::string& filepath)>& remove_content);
     
-    // 搜索文件
-    std::vector<FileInfo> searchFiles(const std::string& keyword, int limit = 100, int offset = 0);
+    // 存储占用：logical为所有文件记录大小之和（即各用户storage_used计入的大小），
+    // physical为去重后磁盘上实际存放的字节数
+    bool getStorageUsage(long& logical, long& physical);
+    
+    // 全文搜索文件名、描述和分类，范围为所有分享的文件加上viewer_id本人的文件，按相关度排序。
+    // 关键词按空白拆分，每个词都须作为子串出现（中文同样适用）；含少于3个字符的词时改用LIKE扫描，
+    // 只在最新上传的2万个文件中按时间倒序查找
+    std::vector<FileInfo> searchFiles(const std::string& keyword, int viewer_id, int limit = 20, int offset = 0);
+    // 该关键词是否会走LIKE扫描，供调用方单独限流
+    static bool searchNeedsScan(const std::string& keyword);
 
     // === 会话管理 ===
     // 创建会话
@@ -161,10 +241,15 @@ public:
     
     // === 源码中额外需要的方法 ===
     std::string generateSessionId();
-    void cleanupExpiredSessions();
+    void cleanupExpiredSessions();     // 由会话缓存的后台清理线程定期调用
     int addFileRecord(const std::string& filename, const std::string& filepath,
                      const std::string& file_type, long file_size, const std::string& uploader, int uploader_id);
     std::vector<FileInfo> getFiles(int limit, int offset, const std::string& category);
+    std::vector<FileInfo> getFiles(int limit, const FileCursor& after, const std::string& category);
+    
+    // 游标与不透明令牌互转，令牌可直接放在URL查询参数中；格式错误时decodeCursor返回false
+    static std::string encodeCursor(const FileCursor& cursor);
+    static bool decodeCursor(const std::string& token, FileCursor& cursor);
     FileInfo getFileByName(const std::string& filename);
     int getFileCount();
     long getTotalFileSize();
@@ -172,34 +257,128 @@ public:
     // 用于main.cpp的方法别名
     bool verify_password(const std::string& username, const std::string& password);
     User get_user(const std::string& username);
-    bool create_session(const std::string& session_id, const std::string& username, const std::string& role);
+    // 会话的角色取自用户表，不由调用方传入
+    bool create_session(const std::string& session_id, const std::string& username);
     Session get_session(const std::string& session_id);
     std::string get_session_user(const std::string& session_id);
     bool create_user(const std::string& username, const std::string& password, const std::string& role = "user");
     std::vector<FileInfo> get_files(int page, int limit, const std::string& category);
     int get_total_files(const std::string& category);
+    
+    // 预编译语句缓存命中/未命中次数（写连接与全部读连接合计）
+    uint64_t statementCacheHits() const;
+    uint64_t statementCacheMisses() const;
+    
+    // 尚未写入数据库的下载次数 / 已批量写入的下载次数
+    uint64_t pendingDownloadCount() const;
+    uint64_t flushedDownloadCount() const;
 
 private:
-    sqlite3* db_;
+    // 一个SQLite连接及其语句缓存
+    struct Connection {
+        sqlite3* db;
+        StatementCache statements;      // 每条SQL每个连接只编译一次
+        
+        Connection() : db(nullptr) {}
+    };
+    
+    // 一次SQL执行占用的连接与语句，析构时先归还语句再归还连接（或释放写锁）；
+    // 可隐式转换为sqlite3_stmt*直接传给sqlite3_*函数
+    class Statement {
+    public:
+        Statement(Database* owner, Connection* reader, std::unique_lock<std::mutex> write_lock,
+                  StatementCache::Handle stmt);
+        Statement(Statement&& other) noexcept;
+        ~Statement();
+        
+        Statement(const Statement&) = delete;
+        Statement& operator=(const Statement&) = delete;
+        Statement& operator=(Statement&&) = delete;
+        
+        operator sqlite3_stmt*() const { return stmt_; }
+        
+    private:
+        Database* owner_;
+        Connection* reader_;                    // 读语句占用的只读连接
+        std::unique_lock<std::mutex> write_lock_; // 写语句持有的写锁
+        StatementCache::Handle stmt_;
+    };
+    
+    sqlite3* db_;                   // 唯一的写连接，只在持有write_mutex_时使用
     std::string db_path_;
+    Connection writer_;
+    std::mutex write_mutex_;
+    
+    // 会话缓存：鉴权先查这里，未命中才查sessions表
+    SessionCache sessions_;
+    
+    // 下载次数写回缓冲
+    DownloadCounter downloads_;
+    std::atomic<uint64_t> downloads_flushed_;
+    
+    // 密码哈希，KDF在自己的有界线程池中计算
+    PasswordHasher passwords_;
+    
+    // 只读连接池：按需打开，数量不超过同时查询的线程数，关闭数据库前一直保留
+    mutable std::mutex readers_mutex_;
+    std::vector<std::unique_ptr<Connection>> readers_;
+    std::vector<Connection*> idle_readers_;
+    
+    // 取得查询语句（只读连接）/写语句（写连接，持有写锁直到语句析构）
+    Statement read_statement(std::string_view sql);
+    Statement write_statement(std::string_view sql);
+    
+    // 写事务：构造时取得写锁并BEGIN IMMEDIATE，析构时若未提交则回滚；
+    // 整个事务期间持有写锁，其他线程的写操作不会混入
+    class Transaction {
+    public:
+        explicit Transaction(Database* owner);
+        ~Transaction();
+        
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+        
+        bool active() const { return active_; }
+        StatementCache::Handle statement(std::string_view sql);
+        bool commit();
+        
+    private:
+        Database* owner_;
+        std::unique_lock<std::mutex> lock_;
+        bool active_;
+    };
+    
+    Connection* acquire_reader();
+    void release_reader(Connection* reader);
+    
+    // 打开连接并设置WAL及各项pragma
+    bool open_connection(sqlite3** db, bool read_only);
     
     // 执行SQL语句
     bool execute(const std::string& sql);
-    
-    // 创建表
-    bool createTables();
-    
-    // 升级表结构
-    bool upgradeTables();
+    bool execute_locked(const std::string& sql);   // 调用方已持有写锁
+    
+    // 一个结构版本：sql和apply二选一
+    struct Migration {
+        int version;
+        const char* description;
+        const char* sql;
+        bool (Database::*apply)();
+    };
+    static const Migration kMigrations[];
+    
+    // 按PRAGMA user_version执行尚未执行的迁移
+    bool migrate();
+    int schemaVersion();
+    bool columnExists(const std::string& table, const std::string& column);
+    bool migrateLegacyColumns();
     
     // 创建默认管理员账户
     bool createDefaultAdmin();
     
-    // 密码哈希
-    std::string hashPassword(const std::string& password);
-    
-    // 验证密码
-    bool verifyPassword(const std::string& password, const std::string& hash);
+    // 用当前参数重新哈希密码，仅当哈希仍是expected_hash时写回（期间改过密码则放弃）
+    void rehashPassword(const std::string& username, const std::string& password,
+                        const std::string& expected_hash);
     
     // 生成时间戳
     std::string getCurrentTimestamp();
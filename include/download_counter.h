@@ -0,0 +1,62 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <utility>
+#include <shared_mutex>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * 下载次数的内存累加器（写回缓冲）
+ * 下载时只对文件对应的计数器做一次原子加，不访问数据库；后台线程定期取出全部增量，
+ * 由调用方在一个事务中批量写入files表。文件ID按取模分片，每个分片一把读写锁，
+ * 已有计数器的文件只需读锁
+ */
+class DownloadCounter {
+public:
+    DownloadCounter();
+    ~DownloadCounter();
+
+    DownloadCounter(const DownloadCounter&) = delete;
+    DownloadCounter& operator=(const DownloadCounter&) = delete;
+
+    void add(int file_id);
+
+    // 取出并清零全部增量 (file_id, 次数)；上个周期起没有下载的文件顺便移出表
+    std::vector<std::pair<int, uint64_t>> take();
+
+    // 写库失败时把取出的增量放回，下个周期重试
+    void restore(const std::vector<std::pair<int, uint64_t>>& counts);
+
+    // 尚未写入数据库的下载次数，进程崩溃时最多丢失这么多
+    uint64_t pending() const { return pending_.load(); }
+
+    // 启动后台写回线程，每个周期调用一次on_flush
+    void start_flusher(std::chrono::seconds interval, std::function<void()> on_flush);
+    void stop_flusher();
+
+private:
+    static const size_t kShardCount = 16;
+
+    struct Shard {
+        std::shared_mutex mutex;
+        std::unordered_map<int, std::atomic<uint64_t>> counts;  // 节点地址稳定，读锁下即可原子加
+    };
+
+    Shard shards_[kShardCount];
+    std::atomic<uint64_t> pending_;
+
+    std::thread flusher_;
+    std::mutex flusher_mutex_;
+    std::condition_variable flusher_cond_;
+    bool stopping_;
+
+    Shard& shard_for(int file_id);
+};
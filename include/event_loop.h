@@ -0,0 +1,140 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <sys/types.h>
+#include <unordered_map>
+#include <deque>
+#include "multipart_parser.h"
+#include "http_parser.h"
+#include "mapped_file.h"
+
+class HttpServer;
+
+// 已打开的文件描述符，同一响应的多个文件区间共享一个fd，最后一个引用释放时关闭
+struct FileHandle {
+    int fd;
+
+    explicit FileHandle(int fd_) : fd(fd_) {}
+    ~FileHandle();
+    FileHandle(const FileHandle&) = delete;
+    FileHandle& operator=(const FileHandle&) = delete;
+};
+
+// 响应输出片段：内存数据，由sendfile直接从页缓存发送的文件区间，
+// 文件映射中的一段，或共享缓冲区（如静态资源缓存中的内容）中的一段；后两者直接发送，不复制
+struct OutputChunk {
+    std::string data;
+    std::shared_ptr<FileHandle> file;
+    std::shared_ptr<const MappedFile> mapping;
+    std::shared_ptr<const std::string> shared;
+    off_t offset;
+    size_t length;
+
+    OutputChunk() : offset(0), length(0) {}
+    explicit OutputChunk(std::string data_) : data(std::move(data_)), offset(0), length(0) {}
+    OutputChunk(std::shared_ptr<FileHandle> file_, off_t offset_, size_t length_)
+        : file(std::move(file_)), offset(offset_), length(length_) {}
+    OutputChunk(std::shared_ptr<const MappedFile> mapping_, off_t offset_, size_t length_)
+        : mapping(std::move(mapping_)), offset(offset_), length(length_) {}
+    OutputChunk(std::shared_ptr<const std::string> shared_, off_t offset_, size_t length_)
+        : shared(std::move(shared_)), offset(offset_), length(length_) {}
+};
+
+// 单个客户端连接的状态，只在所属事件循环线程中访问
+struct Connection {
+    int fd;
+    uint64_t id;                 // 连接序号，防止fd复用后把响应写给新连接
+    std::string read_buffer;     // 已接收但尚未处理的数据
+    std::deque<OutputChunk> output;  // 待发送的响应片段
+    size_t output_offset;        // 队首内存片段中已发送的字节数
+    bool processing;             // 请求是否正在工作线程中处理
+    bool close_after_write;      // 响应发送完毕后关闭连接
+    bool read_paused;            // 流水线预读已达上限，暂停读取
+    bool peer_closed;            // 对端已关闭写方向
+    int requests_served;         // 本连接已处理的请求数
+    std::chrono::steady_clock::time_point last_active;
+    std::chrono::steady_clock::time_point last_progress;  // 待发送响应最近一次有数据发出的时间
+
+    // 当前请求：请求头解析完成后记下长度，等待请求体时不再重复解析
+    size_t head_length;          // 0表示请求头尚未完整
+    size_t content_length;
+    bool request_keep_alive;
+
+    // 边接收边处理的请求体（流式上传或chunked编码），请求头已移出read_buffer
+    bool receiving_body;
+    std::string request_head;
+    size_t body_remaining;       // Content-Length请求体中尚未接收的字节数
+    std::unique_ptr<ChunkedDecoder> chunked;
+    std::string chunked_body;    // 非上传请求解码后的请求体
+    std::unique_ptr<MultipartParser> upload;
+
+    Connection(int fd_, uint64_t id_)
+        : fd(fd_), id(id_), output_offset(0), processing(false), close_after_write(false),
+          read_paused(false), peer_closed(false), requests_served(0),
+          last_active(std::chrono::steady_clock::now()), last_progress(last_active), head_length(0), content_length(0),
+          request_keep_alive(false), receiving_body(false), body_remaining(0) {}
+};
+
+/**
+ * 边缘触发的epoll事件循环
+ * 每个循环持有一个SO_REUSEPORT监听套接字，负责accept、读取请求头和非阻塞写回响应；
+ * 完整的请求交给HttpServer的工作线程池处理，处理结果通过eventfd投递回本循环；
+ * 上传路由的multipart请求体在本循环中流式解析落盘，不在内存中缓冲；支持chunked请求体。
+ * 支持HTTP/1.1持久连接：同一连接上的流水线请求按到达顺序逐个处理，空闲超时的连接定期回收
+ */
+class EventLoop {
+public:
+    EventLoop(HttpServer* server, int listen_fd);
+    ~EventLoop();
+
+    bool init();
+    void run();      // 阻塞运行，直到stop()被调用
+    void stop();
+
+    // 工作线程处理完请求后调用（线程安全），output按顺序发送
+    void post_response(int fd, uint64_t conn_id, std::vector<OutputChunk> output);
+
+    size_t connection_count() const { return connection_count_.load(); }
+
+private:
+    // 工作线程交还的响应
+    struct Completion {
+        int fd;
+        uint64_t conn_id;
+        std::vector<OutputChunk> output;
+    };
+
+    HttpServer* server_;
+    int listen_fd_;
+    int epoll_fd_;
+    int wake_fd_;
+    std::atomic<bool> running_;
+    std::atomic<size_t> connection_count_;
+    uint64_t next_conn_id_;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+
+    std::mutex completions_mutex_;
+    std::vector<Completion> completions_;
+
+    void handle_accept();
+    void handle_read(Connection& conn);
+    void handle_write(Connection& conn);
+    void handle_read_buffered(Connection& conn);
+    void try_dispatch(Connection& conn);
+    void begin_body(Connection& conn, const ParsedRequest& req, const std::string* boundary);
+    void receive_body(Connection& conn);
+    void reset_body(Connection& conn);
+    void fail_body(Connection& conn, std::string response);
+    void send_continue(Connection& conn);
+    void start_request(Connection& conn, std::string raw_request, std::vector<MultipartPart> parts);
+    void sweep_idle(std::chrono::steady_clock::time_point now);
+    void drain_completions();
+    void close_connection(int fd);
+    void send_error(Connection& conn, std::string response);
+};
@@ -3,7 +3,12 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
+#include <chrono>
 #include "database.h"
+#include "sync_batcher.h"
+#include "mapped_file.h"
+#include "line_index.h"
 
 // 文件上传结果
 struct UploadResult {
@@ -19,11 +24,23 @@ struct UploadResult {
  * 负责文件的上传、下载、预览、安全检查等操作
  */
 class FileManager {
+public:
+    // 上传内容的落盘策略
+    //   None    只写入页缓存，由内核回写；掉电可能丢失最近上传的文件
+    //   PerFile 提交前对每个文件fdatasync，改名后fsync所在目录，数据与目录项都在写库前落盘
+    //   Batched 组提交：提交后、应答前等待后台线程的下一次syncfs，同一批的上传合并为一次同步；
+    //           单次刷盘很慢（机械盘、网络块设备）且并发上传多时才比PerFile划算
+    enum class SyncPolicy { None, PerFile, Batched };
+
 private:
     std::string base_path;
     std::map<std::string, std::string> mime_types;
     std::vector<std::string> allowed_types;
     long max_file_size;
+    SyncPolicy sync_policy_;
+    SyncBatcher sync_batcher_;
+    MappedFileCache mapped_files_;
+    LineIndexCache line_indexes_;
 
 public:
     FileManager(const std::string& base_path);
@@ -33,7 +50,7 @@ public:
     bool initialize();
     
     // 文件上传
-    bool save_file(const std::string& filename, const std::string& content, const std::string& uploader);
+    bool save_file(const std::string& filename, const std::string& content);
     UploadResult upload_file(const std::string& filename, const std::vector<uint8_t>& data);
     
     // 文件读取
@@ -42,6 +59,18 @@ public:
     std::vector<uint8_t> readFile(const std::string& filepath);
     bool file_exists(const std::string& filepath);
     
+    // 只读映射整个文件，热点文件的映射缓存在LRU中，命中时没有系统调用；失败返回nullptr。
+    // 内容删除后调用forget_mapping，避免映射和行索引继续占用已删除文件的页
+    std::shared_ptr<const MappedFile> map_file(const std::string& filepath);
+    void forget_mapping(const std::string& filepath);
+    const MappedFileCache& mapping_cache() const { return mapped_files_; }
+    
+    // 文本文件的行索引，首次调用时扫描整个文件建立，之后从缓存返回；用于按行分页预览
+    std::shared_ptr<const LineIndex> line_index(const std::string& filepath);
+    // 已缓存的行索引，没有时返回nullptr而不建立
+    std::shared_ptr<const LineIndex> cached_line_index(const std::string& filepath);
+    const LineIndexCache& line_index_cache() const { return line_indexes_; }
+    
     // 文件信息
     std::string get_mime_type(const std::string& filename);
     std::string getMimeType(const std::string& filename);
@@ -50,6 +79,9 @@ public:
     long get_file_size(const std::string& filepath);
     long getFileSize(const std::string& filepath);
     
+    // 本身已经压缩过的MIME类型（视频、音频、常见图片、压缩包等），HTTP传输时再压缩没有收益
+    std::set<std::string> get_compressed_mime_types() const;
+    
     // 安全检查
     bool is_safe_path(const std::string& path);
     bool isPathSafe(const std::string& path);
@@ -72,6 +104,17 @@ public:
     // 文件删除
     bool deleteFile(const std::string& filepath);
     
+    // 内容寻址存储：上传内容按SHA-256存放在 objects/ab/cd/<哈希>，内容相同的文件共用一份。
+    // store_blob把上传的临时文件改名到位，内容已存在时直接删除临时文件；
+    // 两者都应在数据库写锁内调用，与引用计数的增减保持一致
+    std::string blob_path(const std::string& sha256) const;
+    bool store_blob(const std::string& temp_path, const std::string& sha256);
+    
+    // 按落盘策略同步上传内容：sync_before_commit在提交事务前对临时文件调用，
+    // sync_after_commit在提交成功后、应答客户端前调用
+    bool sync_before_commit(const std::string& temp_path);
+    bool sync_after_commit();
+    
     // 文件预览
     std::string generatePreview(const std::string& filepath, const std::string& file_type);
     bool isPreviewSupported(const std::string& file_type);
@@ -85,6 +128,10 @@ public:
     void setMaxFileSize(long max_size) { max_file_size = max_size; }
     void setAllowedTypes(const std::vector<std::string>& types) { allowed_types = types; }
     void setStorageRoot(const std::string& root) { base_path = root; }
+    void setSyncPolicy(SyncPolicy policy, std::chrono::milliseconds batch_window = std::chrono::milliseconds(0));
+    // 映射缓存的总预算和单个文件上限，更大的文件照常映射但不缓存
+    void setMappingBudget(size_t budget_bytes, size_t max_entry_bytes) { mapped_files_.set_budget(budget_bytes, max_entry_bytes); }
+    SyncPolicy get_sync_policy() const { return sync_policy_; }
     long get_max_file_size() const { return max_file_size; }
     
     // 源码中需要的额外方法
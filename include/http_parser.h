@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+// 请求头中的一个字段，视图指向原始请求缓冲区
+struct HeaderField {
+    std::string_view name;
+    std::string_view value;
+};
+
+// 解析后的请求头；所有string_view都指向传入parse_head的缓冲区，缓冲区须在使用期间保持不变
+struct ParsedRequest {
+    static const size_t kMaxHeaders = 64;
+
+    std::string_view method;
+    std::string_view target;     // 请求目标（路径+查询串）
+    std::string_view path;
+    std::string_view query;      // 不含'?'
+    std::string_view version;    // "HTTP/1.1"
+    HeaderField headers[kMaxHeaders];
+    size_t header_count;
+
+    size_t head_length;          // 请求行+请求头+结尾空行的字节数
+    size_t content_length;
+    bool has_content_length;
+    bool chunked;                // Transfer-Encoding: chunked
+    bool keep_alive;             // 按HTTP版本和Connection头判断的客户端意愿
+
+    ParsedRequest() : header_count(0), head_length(0), content_length(0),
+                      has_content_length(false), chunked(false), keep_alive(false) {}
+
+    // 按名称查找请求头（不区分大小写），不存在时返回空视图
+    std::string_view header(std::string_view name) const;
+    bool has_header(std::string_view name) const;
+};
+
+/**
+ * HTTP/1.x请求头解析器
+ * 单遍扫描，不分配内存：行结束符和非法控制字符的查找按CPU能力选择AVX2、SSE4.2或标量实现
+ */
+class HttpParser {
+public:
+    enum class Result {
+        Complete,       // 请求头完整，req已填充
+        Incomplete,     // 需要更多数据
+        Error           // 格式错误
+    };
+
+    // 解析data开头的请求头；max_head_length限制请求头长度，超过视为错误
+    static Result parse_head(const char* data, size_t len, ParsedRequest& req, size_t max_head_length);
+
+    // 当前使用的扫描实现名称（avx2/sse4.2/scalar），用于启动日志
+    static const char* simd_level();
+};
+
+/**
+ * Transfer-Encoding: chunked 请求体的增量解码器
+ */
+class ChunkedDecoder {
+public:
+    ChunkedDecoder() : state_(State::Size), chunk_remaining_(0), line_length_(0), size_seen_(false) {}
+
+    // 解码data中的数据并追加到out，返回消耗的字节数；格式错误时返回false
+    bool feed(const char* data, size_t len, std::string& out, size_t& consumed);
+
+    bool done() const { return state_ == State::Done; }
+
+private:
+    enum class State {
+        Size,           // 块大小行
+        Extension,      // 块扩展，忽略到行尾
+        SizeLF,
+        Data,
+        DataCR,
+        DataLF,
+        Trailer,        // 结尾的trailer字段，忽略到空行
+        Done
+    };
+
+    State state_;
+    size_t chunk_remaining_;
+    size_t line_length_;        // 当前行已读取的字节数，防止超长行
+    bool size_seen_;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <unordered_map>
@@ -10,6 +11,7 @@
 // 前向声明
 struct User;
 struct FileInfo;
+struct FileRow;
 
 // JSON值类型枚举
 enum class JsonType {
@@ -75,6 +77,9 @@ public:
     static std::string error_response(const std::string& message, int code = 400);
     static std::string data_response(const std::string& data, const std::string& message = "success");
     
+    // 带下一页游标的列表响应，next_cursor为空时输出null表示没有下一页
+    static std::string cursor_response(const std::string& data, const std::string& message, const std::string& next_cursor);
+    
     // 对象序列化
     static std::string serialize_user(const User& user);
     static std::string serialize_file(const FileInfo& file);
@@ -84,8 +89,13 @@ public:
     static std::string serialize_users(const std::vector<User>& users);
     static std::string serialize_files(const std::vector<FileInfo>& files);
     
+    // 把一个文件对象直接追加到out末尾，字符串边追加边转义，不产生中间字符串；
+    // 与serialize_file输出相同，用于流式列表
+    static void append_file(std::string& out, const FileRow& row);
+    
     // 分页响应
-    static std::string paginated_response(const std::string& data, int total, int page, int limit);
+    static std::string paginated_response(const std::string& data, int total, int page, int limit,
+                                          const std::string& next_cursor = "");
     
     // 系统状态序列化
     static std::string serialize_system_status(const std::map<std::string, std::string>& status);
@@ -93,6 +103,7 @@ public:
     
     // 工具方法
     static std::string escape_json_string(const std::string& str);
+    static void append_escaped(std::string& out, std::string_view str);
     static std::map<std::string, std::string> parse_form_data(const std::string& data);
     
     // JsonValue工厂方法
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <list>
+#include <unordered_map>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+#include "mapped_file.h"
+
+// 文本预览的一页：文件中的字节区间 [begin, end)，两端都落在UTF-8字符边界上
+struct TextPage {
+    size_t begin = 0;
+    size_t end = 0;
+    bool whole_lines = false;   // 按行分页且以完整的行结束，此时next_line有效
+    size_t first_line = 0;
+    size_t next_line = 0;
+};
+
+/**
+ * 文本文件的行索引
+ * 对整个映射做一次向量化的换行符扫描（按CPU能力选择AVX2、SSE2或标量实现），每kStride行记录一次行首偏移，
+ * 定位任意一行最多再向后查找kStride-1个换行符；索引大小约为 行数/kStride*8 字节，
+ * 几百MB的日志也只有几百KB。索引持有文件映射，分页时不再重新映射
+ */
+class LineIndex {
+public:
+    static constexpr size_t kStride = 256;
+
+    static std::shared_ptr<const LineIndex> build(std::shared_ptr<const MappedFile> file);
+
+    const MappedFile& file() const { return *file_; }
+    // 行数：最后一行没有换行符结尾时也计入
+    size_t line_count() const { return line_count_; }
+    // 第line行（从0开始）的起始偏移，line不小于行数时返回文件大小
+    size_t line_offset(size_t line) const;
+    // 索引自身占用的内存
+    size_t memory_bytes() const { return checkpoints_.capacity() * sizeof(uint64_t); }
+
+    // 从first_line开始取最多max_lines行；超过max_bytes时在之前最后一个完整行处结束，
+    // 单独一行就超过max_bytes时截断在UTF-8字符边界，whole_lines为false
+    TextPage page_by_lines(size_t first_line, size_t max_lines, size_t max_bytes) const;
+
+    // 按字节偏移分页，不需要索引：起点向后、终点向前对齐到UTF-8字符边界
+    static TextPage page_by_bytes(const MappedFile& file, size_t offset, size_t max_bytes);
+
+    // 统计换行符个数，与建索引使用同一实现
+    static size_t count_newlines(const char* data, size_t len);
+    // 当前使用的扫描实现名称（avx2/sse2/scalar），用于启动日志
+    static const char* simd_level();
+
+private:
+    LineIndex() : line_count_(0) {}
+
+    std::shared_ptr<const MappedFile> file_;
+    std::vector<uint64_t> checkpoints_;     // checkpoints_[k] 为第 k*kStride 行的起始偏移
+    size_t line_count_;
+};
+
+/**
+ * 行索引的LRU缓存
+ * 以路径为键，首次预览时建立索引，同一文件的并发请求等待同一次构建；按条目数淘汰，
+ * 被淘汰的索引连同它持有的映射在最后一个请求结束后释放
+ */
+class LineIndexCache {
+public:
+    using Mapper = std::function<std::shared_ptr<const MappedFile>(const std::string&)>;
+
+    explicit LineIndexCache(size_t max_entries);
+
+    LineIndexCache(const LineIndexCache&) = delete;
+    LineIndexCache& operator=(const LineIndexCache&) = delete;
+
+    // 构建失败（文件无法映射）时返回nullptr，且不缓存失败结果
+    std::shared_ptr<const LineIndex> get(const std::string& path, const Mapper& mapper);
+    // 只查缓存：没有条目或仍在构建中时返回nullptr，不构建也不等待
+    std::shared_ptr<const LineIndex> peek(const std::string& path);
+    void invalidate(const std::string& path);
+    size_t entries() const;
+
+private:
+    using IndexFuture = std::shared_future<std::shared_ptr<const LineIndex>>;
+
+    struct Entry {
+        std::string path;
+        IndexFuture index;
+    };
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_;      // 表头为最近使用
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    size_t max_entries_;
+};
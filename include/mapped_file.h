@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <ctime>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+/**
+ * 只读内存映射的文件
+ * 通过shared_ptr共享，最后一个引用释放时解除映射；读取内容不需要read系统调用，
+ * 也不会在用户态再复制一份。打开时提示内核按顺序预读，小文件整个立即读入，
+ * 大文件只读入实际访问的区间（见prefetch）。
+ * 映射期间文件被截断会导致访问越界页时收到SIGBUS，只用于不会原地修改的文件
+ * （上传内容按哈希存放，只会整体删除）
+ */
+class MappedFile {
+public:
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // 打开并映射整个文件，失败时返回nullptr；空文件不建立映射，data()为nullptr
+    static std::shared_ptr<const MappedFile> open(const std::string& path);
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+    // 提示内核立即异步读入 [offset, offset+length)，按页对齐，越界部分截掉
+    void prefetch(size_t offset, size_t length) const;
+
+    // 打开时的文件属性，用于生成ETag/Last-Modified
+    time_t mtime() const { return mtime_; }
+    long mtime_nsec() const { return mtime_nsec_; }
+
+private:
+    MappedFile() : data_(nullptr), size_(0), mtime_(0), mtime_nsec_(0) {}
+
+    const char* data_;
+    size_t size_;
+    time_t mtime_;
+    long mtime_nsec_;
+};
+
+/**
+ * 热点文件映射的LRU缓存
+ * 以路径为键，缓存的映射总大小不超过预算，超出时淘汰最久未用的；被淘汰的映射若仍有请求在用，
+ * 等最后一个引用释放后才解除。命中时只做一次哈希查找，没有任何系统调用。
+ * 超过单文件上限的文件照常映射，但不放入缓存
+ */
+class MappedFileCache {
+public:
+    MappedFileCache(size_t budget_bytes, size_t max_entry_bytes);
+
+    MappedFileCache(const MappedFileCache&) = delete;
+    MappedFileCache& operator=(const MappedFileCache&) = delete;
+
+    std::shared_ptr<const MappedFile> get(const std::string& path);
+
+    // 文件删除后调用，之后同一路径重新映射
+    void invalidate(const std::string& path);
+
+    void set_budget(size_t budget_bytes, size_t max_entry_bytes);
+
+    size_t bytes() const;
+    size_t entries() const;
+    uint64_t hits() const { return hits_.load(); }
+    uint64_t misses() const { return misses_.load(); }
+
+private:
+    struct Entry {
+        std::string path;
+        std::shared_ptr<const MappedFile> file;
+    };
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_;      // 表头为最近使用
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    size_t budget_;
+    size_t max_entry_;
+    size_t bytes_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+
+    // 淘汰直到总大小不超过预算，调用方持有mutex_
+    void evict_locked();
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <openssl/evp.h>
+
+// multipart/form-data中的一个字段
+struct MultipartPart {
+    std::string name;           // 字段名
+    std::string filename;       // 文件名（普通字段为空）
+    std::string content_type;   // 分段的Content-Type
+    std::string value;          // 普通字段的值
+    std::string temp_path;      // 文件字段落盘的临时文件路径
+    std::string sha256;         // 文件字段内容的SHA-256（十六进制），落盘时顺带计算
+    size_t size;                // 字段内容字节数
+
+    MultipartPart() : size(0) {}
+    bool is_file() const { return !temp_path.empty(); }
+};
+
+/**
+ * 增量式multipart/form-data解析器
+ * 按到达顺序喂入请求体数据，文件字段直接写入临时文件并同时计算SHA-256，内存占用与文件大小无关，
+ * 也不需要事后重读文件；分界线使用Boyer-Moore-Horspool算法扫描
+ */
+class MultipartParser {
+public:
+    MultipartParser(const std::string& boundary, const std::string& temp_dir);
+    ~MultipartParser();
+
+    MultipartParser(const MultipartParser&) = delete;
+    MultipartParser& operator=(const MultipartParser&) = delete;
+
+    // 喂入一段请求体数据，格式错误或写盘失败时返回false
+    bool feed(const char* data, size_t len);
+
+    // 是否已读到结束分界线
+    bool finished() const { return state_ == State::Done; }
+
+    // 取走已解析的字段，临时文件的清理责任随之转移给调用方
+    std::vector<MultipartPart> take_parts();
+
+    // 从Content-Type头中提取boundary参数
+    static bool extract_boundary(const std::string& content_type, std::string& boundary);
+
+private:
+    enum class State {
+        Preamble,       // 第一个分界线之前
+        BoundaryLine,   // 分界线之后，等待CRLF或结束标记"--"
+        Headers,        // 分段头部
+        Body,           // 分段内容
+        Done,
+        Error
+    };
+
+    State state_;
+    std::string delimiter_;     // "\r\n--" + boundary
+    size_t skip_[256];          // BMH坏字符跳转表
+    std::string buffer_;        // 尚未消费的数据，长度不超过一次feed加分界线长度
+    std::string temp_dir_;
+    std::vector<MultipartPart> parts_;
+    int current_fd_;            // 当前文件字段的临时文件
+    EVP_MD_CTX* digest_;        // 当前文件字段的SHA-256
+
+    size_t find_delimiter() const;
+    bool begin_part(const std::string& headers);
+    bool write_body(const char* data, size_t len);
+    bool end_part();
+    void fail();
+};
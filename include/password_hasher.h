@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include "thread_pool.h"
+
+/**
+ * 密码哈希
+ * 新密码使用带随机盐的scrypt（内存困难型KDF），编码为 "scrypt$logN$r$p$盐$哈希"（十六进制），
+ * 参数随哈希保存，日后提高参数不影响已有哈希的校验。旧版本的无盐SHA-256哈希仍可校验，
+ * 校验通过时提示调用方用当前参数重新哈希。
+ * 一次scrypt要占用几十毫秒CPU和32MB内存，计算放在专用的有界线程池中，
+ * 同时进行的KDF数量不超过线程数，排队已满时直接返回Busy，不拖垮处理其他请求的工作线程
+ */
+class PasswordHasher {
+public:
+    PasswordHasher(size_t threads, size_t max_queue);
+
+    PasswordHasher(const PasswordHasher&) = delete;
+    PasswordHasher& operator=(const PasswordHasher&) = delete;
+
+    enum class Result {
+        Match,              // 密码正确，哈希已是当前参数
+        MatchNeedsRehash,   // 密码正确，但哈希是旧格式或旧参数
+        Mismatch,
+        Busy                // KDF线程池排队已满
+    };
+
+    // 在KDF线程池中计算，调用线程等待结果
+    Result hash(const std::string& password, std::string& encoded);
+    Result verify(const std::string& password, const std::string& encoded);
+    // 用户不存在时按当前参数校验一个固定的哈希，耗时与真实账户相同，
+    // 不能从登录耗时判断用户名是否存在；结果只会是Mismatch或Busy
+    Result verify_dummy(const std::string& password);
+
+    // 在调用线程中直接计算
+    static bool hash_now(const std::string& password, std::string& encoded);
+    static Result verify_now(const std::string& password, const std::string& encoded);
+
+private:
+    ThreadPool pool_;
+
+    static const std::string& dummy_hash();
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ctime>
+#include <cstddef>
+#include <cstdint>
+
+// 一个断点续传上传会话
+struct ResumableUpload {
+    std::string id;
+    int user_id;
+    std::string filename;
+    std::string file_type;
+    std::string category;
+    long size;
+    size_t chunk_size;
+    std::string temp_path;      // 预分配的临时文件，完成后改名到内容存储
+    int fd;
+
+    // 以下字段由mutex保护；块的内容在锁外用pwrite写入
+    std::mutex mutex;
+    std::vector<uint8_t> chunks;    // 每块的状态，见ResumableUploads::ChunkState
+    size_t received_chunks;
+    size_t writing_chunks;
+    bool finishing;
+    time_t last_active;
+
+    ResumableUpload() : user_id(0), size(0), chunk_size(0), fd(-1), received_chunks(0),
+                        writing_chunks(0), finishing(false), last_active(0) {}
+    ~ResumableUpload();
+
+    ResumableUpload(const ResumableUpload&) = delete;
+    ResumableUpload& operator=(const ResumableUpload&) = delete;
+};
+
+// 上传进度
+struct UploadProgress {
+    long size;
+    size_t chunk_size;
+    long received_bytes;
+    long offset;                    // 从文件开头起连续收到的字节数
+    std::vector<size_t> missing;    // 尚未收到的块序号（最多kMaxMissingListed个）
+
+    UploadProgress() : size(0), chunk_size(0), received_bytes(0), offset(0) {}
+};
+
+/**
+ * 断点续传上传（参考tus协议）
+ * 创建会话时按文件大小用fallocate预分配临时文件，之后客户端按固定块大小分块上传，
+ * 每块带SHA-256校验和，可以乱序、重传，也可以通过多个连接并行上传：
+ * 各块用pwrite写到各自的偏移，互不加锁，只有块状态的更新需要短暂持有会话锁。
+ * 连接中断后查询进度，只补传缺少的块；全部收到后计算整个文件的SHA-256，交给内容存储。
+ * 会话只保存在内存中，进程重启后未完成的上传需要重新开始
+ */
+class ResumableUploads {
+public:
+    explicit ResumableUploads(const std::string& temp_dir);
+    ~ResumableUploads();
+
+    ResumableUploads(const ResumableUploads&) = delete;
+    ResumableUploads& operator=(const ResumableUploads&) = delete;
+
+    enum class Status {
+        Ok,
+        NotFound,
+        BadRequest,         // 偏移未对齐、长度不符等
+        Conflict,           // 块正在被另一个请求写入，或会话已在完成中
+        ChecksumMismatch,
+        Incomplete,         // 还有块没有收到
+        TooMany,            // 会话数量超过上限
+        QuotaExceeded,      // 加上本用户未完成会话预留的空间后超出配额
+        Failed              // 磁盘空间不足或写盘失败
+    };
+
+    static constexpr size_t kDefaultChunkSize = 8 * 1024 * 1024;
+    static constexpr size_t kMinChunkSize = 256 * 1024;
+    static constexpr size_t kMaxChunkSize = 15 * 1024 * 1024;  // 须小于非流式请求体上限16MB
+    static constexpr size_t kMaxMissingListed = 1024;
+
+    // 创建会话并预分配临时文件；chunk_size为0时使用默认块大小。
+    // available为用户的剩余配额（配额减已用），本用户未完成的会话按各自的大小预留，
+    // 预留加上size超过available时返回QuotaExceeded；会话数量与配额在插入会话的同一临界区内检查
+    Status create(int user_id, const std::string& filename, const std::string& file_type,
+                  const std::string& category, long size, size_t chunk_size, long available,
+                  std::shared_ptr<ResumableUpload>& upload);
+
+    // 查找会话，只返回属于user_id的会话
+    std::shared_ptr<ResumableUpload> find(const std::string& id, int user_id);
+
+    // 写入一块：offset须为块大小的整数倍，除最后一块外长度须等于块大小；
+    // checksum为"sha256 <base64>"。已收到的块再次上传时直接返回Ok
+    Status write_chunk(ResumableUpload& upload, long offset, const std::string& data, const std::string& checksum);
+
+    void progress(ResumableUpload& upload, UploadProgress& progress);
+
+    // 全部块已收到时标记为完成中（此后不再接受写入），并读回整个文件计算SHA-256
+    Status finish(ResumableUpload& upload, std::string& sha256);
+
+    // 结束会话：关闭并删除临时文件（已改名移走时忽略）
+    void remove(const std::string& id);
+
+    size_t size() const;
+    // 用户未完成的会话预留的总字节数
+    long reserved_bytes(int user_id) const;
+
+private:
+    enum ChunkState : uint8_t { Missing = 0, Writing = 1, Received = 2 };
+
+    static constexpr size_t kMaxSessions = 1024;
+    static constexpr size_t kMaxSessionsPerUser = 8;
+    static constexpr time_t kIdleTimeout = 24 * 3600;   // 超过一天没有活动的会话在创建新会话时清理
+
+    std::string temp_dir_;
+    mutable std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<ResumableUpload>> uploads_;
+
+    // 删除过期会话，调用方持有mutex_
+    void sweep_locked(time_t now);
+    long reserved_bytes_locked(int user_id) const;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <utility>
+
+struct HttpRequest;
+struct HttpResponse;
+
+// 路由处理器类型定义
+using RouteHandler = std::function<void(const HttpRequest&, HttpResponse&)>;
+
+enum class HttpMethod {
+    GET,
+    HEAD,
+    POST,
+    PUT,
+    PATCH,
+    DELETE,
+    OPTIONS,
+    Unknown
+};
+
+// 单个路由的并发上限，排队中和执行中的请求都计入
+struct RouteLimit {
+    int max_inflight;
+    std::atomic<int> inflight;
+    
+    explicit RouteLimit(int max) : max_inflight(max), inflight(0) {}
+};
+
+// 某个路径上某个方法的路由
+struct RouteEntry {
+    RouteHandler handler;
+    bool upload;                        // 请求体以流式multipart方式解析
+    std::unique_ptr<RouteLimit> limit;  // 并发上限，未设置时为空
+    
+    RouteEntry() : upload(false) {}
+};
+
+// 匹配到的路径参数，视图分别指向路由模式和请求路径，不分配内存
+struct RouteParams {
+    static const size_t kMaxParams = 8;
+    
+    std::pair<std::string_view, std::string_view> items[kMaxParams];
+    size_t count;
+    
+    RouteParams() : count(0) {}
+};
+
+/**
+ * 按路径段组织的前缀树路由
+ * 模式段支持静态文本、":name"参数段和"*name"通配段（匹配剩余全部路径），
+ * 优先级为 静态 > 参数 > 通配。路由在服务器启动前注册，之后只读，匹配时不加锁也不分配内存
+ */
+class Router {
+public:
+    enum class Result {
+        Found,
+        NotFound,
+        MethodNotAllowed    // 路径存在但不支持该方法
+    };
+    
+    Router();
+    ~Router();
+    
+    // 取得（必要时创建）某个方法和路径模式的路由项
+    RouteEntry& entry(HttpMethod method, const std::string& pattern);
+    
+    // 匹配请求；MethodNotAllowed时allow为该路径支持的方法列表
+    Result match(HttpMethod method, std::string_view path, const RouteEntry*& entry,
+                 RouteParams& params, std::string* allow = nullptr) const;
+    
+    static HttpMethod parse_method(std::string_view method);
+    static const char* method_name(HttpMethod method);
+    
+private:
+    static const size_t kMethodCount = static_cast<size_t>(HttpMethod::Unknown);
+    
+    struct Node {
+        std::string segment;                            // 静态段文本
+        std::vector<std::unique_ptr<Node>> children;    // 静态子节点
+        std::unique_ptr<Node> param_child;
+        std::string param_name;
+        std::unique_ptr<Node> wildcard_child;
+        std::string wildcard_name;
+        RouteEntry entries[kMethodCount];
+        
+        // HEAD没有单独的处理器时回退到GET
+        const RouteEntry* find_entry(HttpMethod method) const;
+        bool has_handler(HttpMethod method) const;
+        bool has_any_handler() const;
+    };
+    
+    std::unique_ptr<Node> root_;
+    
+    // any_method为true时只要求节点上有任意方法的处理器，用于区分405和404
+    const Node* match_node(const Node* node, std::string_view rest, HttpMethod method,
+                           bool any_method, RouteParams& params) const;
+};
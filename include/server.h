@@ -2,10 +2,19 @@
 
 #include <string>
 #include <map>
+#include <set>
 #include <functional>
 #include <thread>
 #include <vector>
 #include <mutex>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include "thread_pool.h"
+#include "event_loop.h"
+#include "multipart_parser.h"
+#include "asset_cache.h"
+#include "router.h"
 
 // HTTP请求结构
 struct HttpRequest {
@@ -15,7 +24,8 @@ struct HttpRequest {
     std::string query_string; // 查询字符串
     std::map<std::string, std::string> headers;  // 请求头
     std::string body;       // 请求体
-    std::map<std::string, std::string> params;   // 查询参数
+    std::map<std::string, std::string> params;   // 查询参数与路径参数（同名时路径参数优先）
+    std::vector<MultipartPart> parts;  // 流式上传路由中已解析的表单字段（body为空）
 };
 
 // HTTP响应结构
@@ -25,12 +35,39 @@ struct HttpResponse {
     std::map<std::string, std::string> headers;  // 响应头
     std::string body;       // 响应体
     
-    HttpResponse() : status_code(200), status_text("OK") {}
+    // 文件响应体：file_path非空时忽略body，由服务器用sendfile从页缓存直接发送，
+    // 并自动支持Range请求
+    std::string file_path;
+    off_t file_offset;
+    long file_length;       // -1 表示发送到文件末尾
+    
+    // 映射响应体：mapped_file非空时忽略body，直接从映射发送file_offset起的file_length字节，
+    // 与文件响应体一样带验证器并支持Range；适合已缓存映射的小文件，省去open/stat
+    std::shared_ptr<const MappedFile> mapped_file;
+    
+    // 共享响应体：shared_body非空时忽略body，直接发送其中的内容，不复制；
+    // 用于多个请求共用的缓存内容（如静态资源及其预压缩变体）。验证器和Accept-Ranges由处理器设置
+    std::shared_ptr<const std::string> shared_body;
+    
+    HttpResponse() : status_code(200), status_text("OK"), file_offset(0), file_length(-1) {}
+    
+    void set_file_body(const std::string& path, off_t offset = 0, long length = -1) {
+        file_path = path;
+        file_offset = offset;
+        file_length = length;
+    }
+    
+    void set_mapped_body(std::shared_ptr<const MappedFile> file, off_t offset = 0, long length = -1) {
+        mapped_file = std::move(file);
+        file_offset = offset;
+        file_length = length;
+    }
+    
+    void set_shared_body(std::shared_ptr<const std::string> content) {
+        shared_body = std::move(content);
+    }
 };
 
-// 路由处理器类型定义
-using RouteHandler = std::function<void(const HttpRequest&, HttpResponse&)>;
-
 class HttpServer {
 public:
 
@@ -39,13 +76,27 @@ private:
     int server_fd_;
     int server_socket;
     int port;
-    std::map<std::string, RouteHandler> routes_;
     std::map<std::string, RouteHandler> routes;
     std::map<std::string, RouteHandler> post_routes;
+    Router router_;                                            // start()之后只读，匹配时无需加锁
+
+    std::unique_ptr<AssetCache> asset_cache_;                  // 静态资源缓存，start()时创建
+    std::set<std::string> incompressible_types_;              // 已是压缩格式、不再压缩的MIME类型
+    std::string upload_temp_dir_;
     std::string static_root_;
-    std::mutex routes_mutex_;
-    bool running_;
+    std::atomic<bool> running_;
     bool running;
+    
+    // 事件循环与工作线程池
+    int io_threads_;
+    size_t worker_threads_;
+    size_t max_queue_size_;
+    int keep_alive_timeout_;        // 空闲连接超时（秒）
+    int max_keep_alive_requests_;   // 单个连接最多处理的请求数
+    int send_timeout_;              // 响应发送停滞超时（秒）
+    std::vector<std::unique_ptr<EventLoop>> loops_;
+    std::vector<std::thread> loop_threads_;
+    std::unique_ptr<ThreadPool> worker_pool_;
 
 public:
     HttpServer(int port);
@@ -55,25 +106,77 @@ public:
     void stop();
     bool is_running() const;
     
+    // 注册路由，须在start()之前调用。路径支持":name"参数段和"*name"通配段，
+    // 如 "/api/files/:id/content"，匹配到的值放入request.params
     void addRoute(const std::string& method, const std::string& path, RouteHandler handler);
     void setStaticRoot(const std::string& root);
     
+    // 线程配置，须在start()之前调用；0表示按CPU核数自动选择
+    void setIoThreads(int threads);
+    void setWorkerThreads(size_t threads, size_t max_queue_size);
+    void setKeepAlive(int idle_timeout_seconds, int max_requests);
+    // 响应发送停滞超时：客户端在这段时间内一个字节也没有接收时断开，释放连接占用的fd、映射和预读缓冲
+    void setSendTimeout(int seconds);
+    
+    // 限制单个路由同时占用的工作线程池名额，超过时直接返回503，须在start()之前调用
+    void setRouteConcurrency(const std::string& method, const std::string& path, int max_inflight);
+    
+    // 设置不做压缩的MIME类型（视频、图片、压缩包等），须在start()之前调用
+    void setIncompressibleTypes(const std::set<std::string>& mime_types);
+    
     void add_route(const std::string& path, RouteHandler handler);
     void add_post_route(const std::string& path, RouteHandler handler);
     
+    // 注册上传路由：multipart请求体在事件循环中边接收边解析，文件字段直接写入临时目录，
+    // 处理器通过request.parts取得字段；处理器未移走的临时文件在请求结束后删除
+    void add_upload_route(const std::string& path, RouteHandler handler);
+    void setUploadTempDir(const std::string& dir);
+    
     std::map<std::string, std::string> parse_query_params(const std::string& query_string);
 
 private:
-    void handle_client(int client_socket);
+    friend class EventLoop;
+    
+    // 创建一个SO_REUSEPORT监听套接字
+    int create_listener();
+    
+    // 把完整请求交给工作线程池，线程池已满时返回false
+    bool dispatch(EventLoop* loop, int fd, uint64_t conn_id, std::string raw_request, bool keep_alive,
+                  std::vector<MultipartPart> parts = {});
+    // 以下几个函数的path为请求行中未解码的路径，按解码后的路径匹配路由，与handleRoute一致
+    const RouteEntry* match_raw_path(std::string_view method, std::string_view raw_path) const;
+    bool is_upload_route(std::string_view method, std::string_view path) const;
+    RouteLimit* find_route_limit(std::string_view method, std::string_view path) const;
+    bool route_saturated(std::string_view method, std::string_view path) const;
+    RouteEntry* register_route(const std::string& method, const std::string& path);
+    std::string overload_response();
+    
+    // 设置Connection/Keep-Alive响应头
+    void set_connection_headers(HttpResponse& response, bool keep_alive);
+    
+    // 动态响应按Accept-Encoding整体即时压缩（不超过4MB），静态资源的压缩变体由AssetCache预先生成
+    bool is_compressible(const std::string& content_type) const;
+    void compress_body(const HttpRequest& request, HttpResponse& response);
+    
+    // 条件请求：If-None-Match / If-Modified-Since 命中时返回true（应答304）
+    bool is_not_modified(const HttpRequest& request, const HttpResponse& response);
+    
+    // 文件和映射响应体的验证器：未由处理器设置时按大小、修改时间和实体区间生成
+    void set_file_validators(HttpResponse& response, off_t size, time_t mtime, long mtime_nsec,
+                             off_t offset, size_t length);
+    
+    // 生成响应输出片段：处理文件/映射响应体、304、压缩、Range/If-Range（206/416）与multipart/byteranges
+    std::vector<OutputChunk> build_output(const HttpRequest& request, HttpResponse& response);
     
     // HTTP解析和生成
-    HttpRequest parse_request(const std::string& raw_request);
+    HttpRequest parse_request(std::string raw_request);
     std::string generate_response(const HttpResponse& response);
-    HttpResponse handleRoute(const HttpRequest& request);
+    std::string generate_head(const HttpResponse& response, size_t content_length);
+    HttpResponse handleRoute(HttpRequest& request);
     
     // 静态文件服务
-    bool handle_static_file(const std::string& path, HttpResponse& response);
-    std::string url_decode(const std::string& str);
+    bool handle_static_file(const HttpRequest& request, HttpResponse& response);
+    static std::string url_decode(const std::string& str);
     
     std::string get_mime_type(const std::string& path);
     std::string serve_static_file(const std::string& path);
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <ctime>
+#include <cstddef>
+#include <cstdint>
+
+// 缓存中的会话
+struct CachedSession {
+    int user_id;
+    std::string username;
+    std::string role;
+    std::string created_at;
+    std::string expires_at;     // 与sessions表相同的UTC时间文本
+    time_t expires;             // expires_at对应的时间戳，用于判断过期
+    
+    CachedSession() : user_id(0), expires(0) {}
+};
+
+/**
+ * 分片加锁的会话缓存，位于sessions表之前
+ * 会话ID按哈希分到固定数量的分片，每个分片一把读写锁，鉴权只需一次哈希查找；
+ * 读到过期项时顺手删除，后台清理线程定期扫描各分片并调用on_sweep清理数据库中的过期会话
+ */
+class SessionCache {
+public:
+    SessionCache();
+    ~SessionCache();
+    
+    SessionCache(const SessionCache&) = delete;
+    SessionCache& operator=(const SessionCache&) = delete;
+    
+    // 查找未过期的会话
+    bool get(const std::string& session_id, CachedSession& session);
+    void put(const std::string& session_id, const CachedSession& session);
+    void erase(const std::string& session_id);
+    
+    // 缓存未命中后查库回填时使用：查库前取epoch，回填时若期间该分片有过删除则放弃，
+    // 避免刚注销的会话被并发请求读到的旧数据重新放回缓存
+    uint64_t epoch(const std::string& session_id);
+    bool put_if_unchanged(const std::string& session_id, const CachedSession& session, uint64_t epoch);
+    
+    // 删除某个用户的全部会话（删除用户时调用）
+    void erase_user(int user_id);
+    
+    // 删除所有过期项，返回删除数量
+    size_t sweep();
+    
+    size_t size() const;
+    
+    // 启动后台清理线程，每个周期先清理内存再调用on_sweep
+    void start_sweeper(std::chrono::seconds interval, std::function<void()> on_sweep);
+    void stop_sweeper();
+    
+    // 把sessions表中的 "YYYY-MM-DD HH:MM:SS"（UTC）转为时间戳，格式错误时返回0
+    static time_t parse_timestamp(const std::string& text);
+    
+private:
+    static const size_t kShardCount = 16;
+    
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string, CachedSession> sessions;
+        uint64_t epoch = 0;     // 每次删除递增
+    };
+    
+    Shard shards_[kShardCount];
+    
+    std::thread sweeper_;
+    std::mutex sweeper_mutex_;
+    std::condition_variable sweeper_cond_;
+    bool stopping_;
+    
+    Shard& shard_for(const std::string& session_id);
+};
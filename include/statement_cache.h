@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <sqlite3.h>
+
+/**
+ * 单个SQLite连接的预编译语句缓存
+ * 每条SQL只在第一次使用时编译，用完后reset并清空绑定放回空闲列表供下次复用。
+ * 多个线程同时执行同一条SQL时各自取得不同的语句对象，空闲列表按SQL文本索引
+ */
+class StatementCache {
+public:
+    // 借出的语句，析构时归还缓存；可隐式转换为sqlite3_stmt*直接传给sqlite3_*函数
+    class Handle {
+    public:
+        Handle() : cache_(nullptr), stmt_(nullptr) {}
+        Handle(StatementCache* cache, std::string_view sql, sqlite3_stmt* stmt)
+            : cache_(cache), sql_(sql), stmt_(stmt) {}
+        ~Handle() { release(); }
+        
+        Handle(Handle&& other) noexcept : cache_(other.cache_), sql_(other.sql_), stmt_(other.stmt_) {
+            other.stmt_ = nullptr;
+        }
+        Handle& operator=(Handle&& other) noexcept;
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+        
+        operator sqlite3_stmt*() const { return stmt_; }
+        
+    private:
+        StatementCache* cache_;
+        std::string_view sql_;      // 指向缓存中的键，生命周期与缓存相同
+        sqlite3_stmt* stmt_;
+        
+        void release();
+    };
+    
+    explicit StatementCache(sqlite3* db = nullptr);
+    ~StatementCache();
+    
+    StatementCache(const StatementCache&) = delete;
+    StatementCache& operator=(const StatementCache&) = delete;
+    
+    // 绑定到连接；更换连接前会先释放旧连接上的全部语句
+    void attach(sqlite3* db);
+    
+    // 取得已编译的语句，编译失败时返回空句柄
+    Handle acquire(std::string_view sql);
+    
+    // 释放全部空闲语句，关闭连接前必须调用（借出中的语句由调用方先归还）
+    void clear();
+    
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+    
+private:
+    // 每条SQL最多保留的空闲语句数，超出时直接finalize，不让并发峰值留下大量对象
+    static const size_t kMaxIdlePerSql = 8;
+    
+    sqlite3* db_;
+    std::mutex mutex_;
+    std::map<std::string, std::vector<sqlite3_stmt*>, std::less<>> idle_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    
+    void give_back(std::string_view sql, sqlite3_stmt* stmt);
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * 文件落盘的组提交
+ * 多个线程各自写完文件后调用wait()，后台线程执行一次syncfs，把这期间所有文件的数据和目录项
+ * 一起写入磁盘，再唤醒这一批等待者；同步进行中到达的请求合并到下一批。
+ * 可以设置额外的收集窗口，以每次等待多出一个窗口的延迟换取更大的批次
+ */
+class SyncBatcher {
+public:
+    SyncBatcher();
+    ~SyncBatcher();
+
+    SyncBatcher(const SyncBatcher&) = delete;
+    SyncBatcher& operator=(const SyncBatcher&) = delete;
+
+    // path为要同步的文件系统上的任意目录；window为0时不额外等待
+    bool start(const std::string& path, std::chrono::milliseconds window);
+    void stop();
+    bool running() const;
+
+    // 等待一次在调用之后开始的syncfs完成，返回该次同步是否成功
+    bool wait();
+
+    uint64_t batches() const;
+
+private:
+    int fd_;
+    std::chrono::milliseconds window_;
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable request_cond_;
+    std::condition_variable done_cond_;
+    uint64_t requested_;        // 最后一个等待者的序号
+    uint64_t completed_;        // 已同步到的序号
+    uint64_t failed_;           // 最近一次失败的同步覆盖到的序号
+    uint64_t batches_;
+    bool stopping_;
+
+    void run();
+};
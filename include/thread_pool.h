@@ -0,0 +1,56 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
+
+/**
+ * 有界工作窃取线程池
+ * 每个工作线程有自己的任务队列，提交的任务轮流分配到各队列；线程优先从自己队列头部取任务，
+ * 空闲时从其他队列尾部窃取，避免所有线程争用同一把锁。
+ * 排队任务总数有上限，超过时submit返回false，由调用方决定如何降级
+ */
+class ThreadPool {
+public:
+    ThreadPool(size_t thread_count, size_t max_queue_size);
+    ~ThreadPool();
+
+    // 提交任务，队列已满或线程池已关闭时返回false
+    bool submit(std::function<void()> task);
+
+    // 停止接收新任务，执行完已排队任务后回收线程
+    void shutdown();
+
+    size_t queue_size() const { return queued_.load(); }
+    size_t thread_count() const { return workers_.size(); }
+    size_t steal_count() const { return steals_.load(); }
+
+private:
+    // 单个工作线程的任务队列
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    size_t max_queue_size_;
+
+    std::atomic<size_t> queued_;        // 已提交尚未取出的任务数，用于准入控制和唤醒判断
+    std::atomic<size_t> next_queue_;    // 轮询分配的下一个队列
+    std::atomic<size_t> steals_;
+    std::atomic<bool> stopping_;
+
+    // 空闲线程在此休眠
+    std::mutex sleep_mutex_;
+    std::condition_variable cond_;
+
+    void worker_loop(size_t index);
+    bool pop_local(size_t index, std::function<void()>& task);
+    bool steal(size_t index, std::function<void()>& task);
+};
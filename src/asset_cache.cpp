@@ -0,0 +1,328 @@
+#include "asset_cache.h"
+#include "compression.h"
+#include <openssl/evp.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <unistd.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+const off_t kMaxAssetSize = 8 * 1024 * 1024;         // 单个文件超过此大小不缓存，走sendfile
+const size_t kMaxCacheBytes = 64 * 1024 * 1024;      // 缓存总容量（含压缩变体）
+const size_t kMinCompressSize = 1024;
+const int kWatchPollMs = 500;
+
+const char* kImmutableCacheControl = "public, max-age=31536000, immutable";
+const char* kRevalidateCacheControl = "no-cache";
+
+size_t asset_bytes(const StaticAsset& asset) {
+    return asset.body.size() + asset.gzip.size() + asset.brotli.size();
+}
+
+std::string format_http_date(time_t t) {
+    char buf[64];
+    struct tm tm_utc;
+    gmtime_r(&t, &tm_utc);
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm_utc);
+    return buf;
+}
+
+// 内容SHA-256的前128位，作为强ETag
+std::string content_etag(const std::string& content) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len = 0;
+    if (!EVP_Digest(content.data(), content.size(), digest, &digest_len, EVP_sha256(), nullptr)) {
+        return "";
+    }
+    static const char* hex = "0123456789abcdef";
+    std::string etag = "\"";
+    for (unsigned int i = 0; i < 16 && i < digest_len; ++i) {
+        etag += hex[digest[i] >> 4];
+        etag += hex[digest[i] & 0x0f];
+    }
+    etag += "\"";
+    return etag;
+}
+
+// 文件名是否带内容指纹，如 app.3f9a1c2b.js 或 app-3f9a1c2b.css
+bool is_fingerprinted(const std::string& path) {
+    std::string name = std::filesystem::path(path).filename().string();
+    size_t ext_pos = name.find_last_of('.');
+    if (ext_pos == std::string::npos || ext_pos == 0) {
+        return false;
+    }
+    std::string stem = name.substr(0, ext_pos);
+    size_t sep = stem.find_last_of(".-");
+    if (sep == std::string::npos || stem.size() - sep - 1 < 8) {
+        return false;
+    }
+    for (size_t i = sep + 1; i < stem.size(); ++i) {
+        if (!isxdigit(static_cast<unsigned char>(stem[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+AssetCache::AssetCache(const std::string& root, CompressiblePredicate compressible)
+    : root_(root), compressible_(std::move(compressible)), total_bytes_(0),
+      inotify_fd_(-1), running_(false) {
+    while (root_.size() > 1 && root_.back() == '/') {
+        root_.pop_back();
+    }
+}
+
+AssetCache::~AssetCache() {
+    stop();
+}
+
+std::string AssetCache::content_type_for(const std::string& path) {
+    std::string ext;
+    size_t dot_pos = path.find_last_of('.');
+    if (dot_pos != std::string::npos) {
+        ext = path.substr(dot_pos + 1);
+    }
+    
+    if (ext == "html" || ext == "htm") {
+        return "text/html; charset=utf-8";
+    } else if (ext == "css") {
+        return "text/css";
+    } else if (ext == "js") {
+        return "application/javascript";
+    } else if (ext == "json" || ext == "map") {
+        return "application/json";
+    } else if (ext == "svg") {
+        return "image/svg+xml";
+    } else if (ext == "txt") {
+        return "text/plain; charset=utf-8";
+    } else if (ext == "png") {
+        return "image/png";
+    } else if (ext == "jpg" || ext == "jpeg") {
+        return "image/jpeg";
+    } else if (ext == "ico") {
+        return "image/x-icon";
+    } else if (ext == "woff2") {
+        return "font/woff2";
+    }
+    return "application/octet-stream";
+}
+
+bool AssetCache::start() {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(root_, ec)) {
+        std::cerr << "静态目录不存在: " << root_ << std::endl;
+        return false;
+    }
+    
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0) {
+        std::cerr << "inotify不可用，静态资源改为按mtime校验: " << strerror(errno) << std::endl;
+    } else {
+        add_watch(root_);
+    }
+    
+    for (auto it = std::filesystem::recursive_directory_iterator(root_, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (it->is_directory(ec)) {
+            add_watch(it->path().string());
+        } else if (it->is_regular_file(ec)) {
+            reload(it->path().string());
+        }
+    }
+    
+    std::cout << "静态资源缓存: " << assets_.size() << " 个文件, " << total_bytes_ / 1024 << "KB" << std::endl;
+    
+    if (inotify_fd_ >= 0) {
+        running_ = true;
+        watcher_ = std::thread([this]() { watch_loop(); });
+    }
+    return true;
+}
+
+void AssetCache::stop() {
+    running_ = false;
+    if (watcher_.joinable()) {
+        watcher_.join();
+    }
+    if (inotify_fd_ >= 0) {
+        close(inotify_fd_);
+        inotify_fd_ = -1;
+    }
+}
+
+std::shared_ptr<const StaticAsset> AssetCache::find(const std::string& path) {
+    std::shared_ptr<const StaticAsset> asset;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = assets_.find(path);
+        if (it != assets_.end()) {
+            asset = it->second;
+        }
+    }
+    
+    if (inotify_fd_ >= 0) {
+        return asset;
+    }
+    
+    // 没有inotify时每次访问校验mtime，变化或新出现的文件重新加载
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (asset) {
+            remove(path);
+        }
+        return nullptr;
+    }
+    if (asset && asset->size == st.st_size && asset->mtime.tv_sec == st.st_mtim.tv_sec &&
+        asset->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+        return asset;
+    }
+    reload(path);
+    
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = assets_.find(path);
+    return it != assets_.end() ? it->second : nullptr;
+}
+
+std::shared_ptr<const StaticAsset> AssetCache::load_file(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size > kMaxAssetSize) {
+        return nullptr;
+    }
+    
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        return nullptr;
+    }
+    auto asset = std::make_shared<StaticAsset>();
+    asset->body.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (asset->body.size() != static_cast<size_t>(st.st_size)) {
+        return nullptr;  // 读取期间文件被修改，等待下一次变更通知
+    }
+    
+    asset->size = st.st_size;
+    asset->mtime = st.st_mtim;
+    asset->content_type = content_type_for(path);
+    asset->etag = content_etag(asset->body);
+    asset->last_modified = format_http_date(st.st_mtime);
+    asset->cache_control = is_fingerprinted(path) ? kImmutableCacheControl : kRevalidateCacheControl;
+    
+    // 加载时只做一次，使用最高压缩级别；压缩收益不足10%的变体不保留
+    if (asset->body.size() >= kMinCompressSize && compressible_ && compressible_(asset->content_type)) {
+        std::string encoded;
+        if (Compression::zlib_compress(asset->body, ContentEncoding::Gzip, encoded, 9) &&
+            encoded.size() < asset->body.size() * 9 / 10) {
+            asset->gzip.swap(encoded);
+        }
+        encoded.clear();
+        if (Compression::brotli_compress(asset->body, encoded, 11) &&
+            encoded.size() < asset->body.size() * 9 / 10) {
+            asset->brotli.swap(encoded);
+        }
+    }
+    
+    return asset;
+}
+
+void AssetCache::reload(const std::string& path) {
+    std::shared_ptr<const StaticAsset> asset = load_file(path);
+    
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = assets_.find(path);
+    if (it != assets_.end()) {
+        total_bytes_ -= asset_bytes(*it->second);
+        assets_.erase(it);
+    }
+    if (asset && total_bytes_ + asset_bytes(*asset) <= kMaxCacheBytes) {
+        total_bytes_ += asset_bytes(*asset);
+        assets_[path] = std::move(asset);
+    }
+}
+
+void AssetCache::remove(const std::string& path) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = assets_.find(path);
+    if (it != assets_.end()) {
+        total_bytes_ -= asset_bytes(*it->second);
+        assets_.erase(it);
+    }
+}
+
+void AssetCache::add_watch(const std::string& dir) {
+    if (inotify_fd_ < 0) {
+        return;
+    }
+    int wd = inotify_add_watch(inotify_fd_, dir.c_str(),
+                               IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                               IN_MOVED_TO | IN_ATTRIB | IN_ONLYDIR);
+    if (wd >= 0) {
+        watch_dirs_[wd] = dir;
+    }
+}
+
+void AssetCache::watch_loop() {
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    
+    while (running_) {
+        struct pollfd pfd;
+        pfd.fd = inotify_fd_;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, kWatchPollMs) <= 0) {
+            continue;
+        }
+        
+        ssize_t len = read(inotify_fd_, buffer, sizeof(buffer));
+        if (len <= 0) {
+            continue;
+        }
+        
+        for (char* ptr = buffer; ptr < buffer + len; ) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+            
+            auto dir_it = watch_dirs_.find(event->wd);
+            if (dir_it == watch_dirs_.end()) {
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                watch_dirs_.erase(dir_it);
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+            std::string path = dir_it->second + "/" + event->name;
+            
+            if (event->mask & IN_ISDIR) {
+                // 新建或移入的子目录：加入监听并加载其中已有的文件
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    add_watch(path);
+                    std::error_code ec;
+                    for (auto it = std::filesystem::recursive_directory_iterator(path, ec);
+                         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+                        if (it->is_directory(ec)) {
+                            add_watch(it->path().string());
+                        } else if (it->is_regular_file(ec)) {
+                            reload(it->path().string());
+                        }
+                    }
+                }
+                continue;
+            }
+            
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                remove(path);
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ATTRIB)) {
+                reload(path);
+            }
+        }
+    }
+}
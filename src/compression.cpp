@@ -0,0 +1,140 @@
+#include "compression.h"
+#include <zlib.h>
+#include <brotli/encode.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+
+namespace {
+
+const size_t kZlibChunk = 64 * 1024;
+
+// 编码在q值相同时的优先级，数值越大越优先
+int encoding_rank(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::Brotli: return 3;
+        case ContentEncoding::Gzip: return 2;
+        case ContentEncoding::Deflate: return 1;
+        default: return 0;
+    }
+}
+
+} // namespace
+
+ContentEncoding Compression::negotiate(const std::string& accept_encoding, bool allow_brotli) {
+    ContentEncoding best = ContentEncoding::Identity;
+    double best_q = 0.0;
+    
+    size_t pos = 0;
+    while (pos < accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', pos);
+        if (end == std::string::npos) {
+            end = accept_encoding.size();
+        }
+        std::string item = accept_encoding.substr(pos, end - pos);
+        pos = end + 1;
+        
+        // 拆分 "coding;q=0.8"
+        std::string coding = item.substr(0, item.find(';'));
+        coding.erase(0, coding.find_first_not_of(" \t"));
+        coding.erase(coding.find_last_not_of(" \t") + 1);
+        std::transform(coding.begin(), coding.end(), coding.begin(), ::tolower);
+        
+        double q = 1.0;
+        size_t q_pos = item.find("q=");
+        if (q_pos != std::string::npos) {
+            q = std::atof(item.c_str() + q_pos + 2);
+        }
+        if (q <= 0.0) {
+            continue;
+        }
+        
+        ContentEncoding candidate;
+        if (coding == "br" && allow_brotli) {
+            candidate = ContentEncoding::Brotli;
+        } else if (coding == "gzip" || coding == "x-gzip" || coding == "*") {
+            candidate = ContentEncoding::Gzip;
+        } else if (coding == "deflate") {
+            candidate = ContentEncoding::Deflate;
+        } else {
+            continue;
+        }
+        
+        if (q > best_q || (q == best_q && encoding_rank(candidate) > encoding_rank(best))) {
+            best = candidate;
+            best_q = q;
+        }
+    }
+    
+    return best;
+}
+
+const char* Compression::encoding_name(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::Gzip: return "gzip";
+        case ContentEncoding::Deflate: return "deflate";
+        case ContentEncoding::Brotli: return "br";
+        default: return "identity";
+    }
+}
+
+bool Compression::zlib_compress(const std::string& input, ContentEncoding encoding,
+                                std::string& out, int level) {
+    if (encoding != ContentEncoding::Gzip && encoding != ContentEncoding::Deflate) {
+        return false;
+    }
+    
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    
+    // windowBits加16输出gzip封装，否则为HTTP deflate要求的zlib封装
+    int window_bits = encoding == ContentEncoding::Gzip ? 15 + 16 : 15;
+    if (deflateInit2(&stream, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    
+    unsigned char buffer[kZlibChunk];
+    size_t consumed = 0;
+    int rc = Z_OK;
+    
+    do {
+        size_t slice = std::min(kZlibChunk, input.size() - consumed);
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data() + consumed));
+        stream.avail_in = static_cast<uInt>(slice);
+        consumed += slice;
+        int flush = consumed >= input.size() ? Z_FINISH : Z_NO_FLUSH;
+        
+        do {
+            stream.next_out = buffer;
+            stream.avail_out = sizeof(buffer);
+            rc = deflate(&stream, flush);
+            if (rc == Z_STREAM_ERROR) {
+                deflateEnd(&stream);
+                return false;
+            }
+            out.append(reinterpret_cast<char*>(buffer), sizeof(buffer) - stream.avail_out);
+        } while (stream.avail_out == 0);
+    } while (rc != Z_STREAM_END);
+    
+    deflateEnd(&stream);
+    return true;
+}
+
+bool Compression::brotli_compress(const std::string& input, std::string& out, int quality) {
+    size_t encoded_size = BrotliEncoderMaxCompressedSize(input.size());
+    if (encoded_size == 0) {
+        return false;
+    }
+    
+    std::string encoded(encoded_size, '\0');
+    if (!BrotliEncoderCompress(quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                               input.size(), reinterpret_cast<const uint8_t*>(input.data()),
+                               &encoded_size, reinterpret_cast<uint8_t*>(&encoded[0]))) {
+        return false;
+    }
+    encoded.resize(encoded_size);
+    out.append(encoded);
+    return true;
+}
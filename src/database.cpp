@@ -3,32 +3,91 @@
 #include <sstream>
 #include <iomanip>
 #include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
 #include <ctime>
-#include <openssl/sha.h>
 #include <random>
+#include <thread>
+#include <algorithm>
 
-Database::Database(const std::string& db_path) : db_(nullptr), db_path_(db_path) {
+namespace {
+
+// 写连接与读连接共用的pragma。WAL下synchronous=NORMAL只在检查点时fsync，
+// 掉电最多丢失最近提交的事务，但不会损坏数据库
+const char* kConnectionPragmas =
+    "PRAGMA synchronous = NORMAL;"
+    "PRAGMA temp_store = MEMORY;"
+    "PRAGMA mmap_size = 268435456;"     // 256MB内存映射读
+    "PRAGMA cache_size = -16384;";      // 每个连接16MB页缓存
+
+const int kBusyTimeoutMs = 5000;
+
+// 下载次数写回周期，也是进程崩溃时可能丢失计数的时间窗口
+const int kDownloadFlushSeconds = 5;
+
+// 同时计算的KDF不超过一半核心（至少1个、至多4个），每个约占32MB内存；
+// 排队超过kPasswordQueue个登录请求时直接拒绝
+const size_t kPasswordQueue = 64;
+
+size_t password_threads() {
+    unsigned int cores = std::thread::hardware_concurrency();
+    return std::max(1u, std::min(4u, cores / 2));
+}
+
+} // namespace
+
+Database::Database(const std::string& db_path)
+    : db_(nullptr), db_path_(db_path), downloads_flushed_(0), passwords_(password_threads(), kPasswordQueue) {
 }
 
 Database::~Database() {
     close();
 }
 
+bool Database::open_connection(sqlite3** db, bool read_only) {
+    // 每个连接同一时刻只被一个线程使用（写连接由write_mutex_保护），不需要SQLite内部的互斥锁
+    int flags = SQLITE_OPEN_NOMUTEX | (read_only ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    if (sqlite3_open_v2(db_path_.c_str(), db, flags, nullptr) != SQLITE_OK) {
+        std::cerr << "Cannot open database: " << sqlite3_errmsg(*db) << std::endl;
+        sqlite3_close(*db);
+        *db = nullptr;
+        return false;
+    }
+    
+    sqlite3_busy_timeout(*db, kBusyTimeoutMs);
+    
+    // journal_mode=WAL写入数据库文件，由写连接设置一次即可
+    std::string pragmas = read_only ? kConnectionPragmas : std::string("PRAGMA journal_mode = WAL;") + kConnectionPragmas;
+    char* errMsg = nullptr;
+    if (sqlite3_exec(*db, pragmas.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::cerr << "设置数据库参数失败: " << (errMsg ? errMsg : "") << std::endl;
+        sqlite3_free(errMsg);
+        sqlite3_close(*db);
+        *db = nullptr;
+        return false;
+    }
+    return true;
+}
+
 bool Database::initialize() {
-    int rc = sqlite3_open(db_path_.c_str(), &db_);
-    if (rc != SQLITE_OK) {
-        std::cerr << "Cannot open database: " << sqlite3_errmsg(db_) << std::endl;
+    if (!open_connection(&db_, false)) {
         return false;
     }
+    writer_.db = db_;
+    writer_.statements.attach(db_);
     
-    if (!createTables()) {
-        std::cerr << "Failed to create tables" << std::endl;
+    if (!migrate()) {
+        std::cerr << "Failed to migrate database schema" << std::endl;
         return false;
     }
     
-    if (!upgradeTables()) {
-        std::cerr << "Failed to upgrade tables" << std::endl;
+    // 热点查询退化为全表扫描或临时排序：调试构建拒绝启动，使索引回归在开发时就暴露；发布构建只告警
+    if (!checkQueryPlans()) {
+#ifndef NDEBUG
+        std::cerr << "热点查询计划退化，调试构建拒绝启动" << std::endl;
         return false;
+#endif
     }
     
     if (!createDefaultAdmin()) {
@@ -36,18 +95,150 @@ bool Database::initialize() {
         return false;
     }
     
+    // 每分钟清理一次过期会话（缓存与sessions表）
+    sessions_.start_sweeper(std::chrono::seconds(60), [this]() { cleanupExpiredSessions(); });
+    downloads_.start_flusher(std::chrono::seconds(kDownloadFlushSeconds), [this]() { flushDownloadCounts(); });
+    
     std::cout << "数据库初始化成功" << std::endl;
     return true;
 }
 
 void Database::close() {
+    sessions_.stop_sweeper();
+    
+    // 正常关闭时写入剩余的下载次数
+    downloads_.stop_flusher();
+    flushDownloadCounts();
+    
+    // 缓存的语句不释放时sqlite3_close会返回SQLITE_BUSY
+    {
+        std::lock_guard<std::mutex> lock(readers_mutex_);
+        for (auto& reader : readers_) {
+            reader->statements.attach(nullptr);
+            sqlite3_close(reader->db);
+        }
+        readers_.clear();
+        idle_readers_.clear();
+    }
+    
+    std::lock_guard<std::mutex> lock(write_mutex_);
     if (db_) {
+        // 最后一个连接关闭时SQLite执行检查点并删除-wal文件
+        writer_.statements.attach(nullptr);
+        writer_.db = nullptr;
         sqlite3_close(db_);
         db_ = nullptr;
     }
 }
 
+uint64_t Database::statementCacheHits() const {
+    uint64_t hits = writer_.statements.hits();
+    std::lock_guard<std::mutex> lock(readers_mutex_);
+    for (const auto& reader : readers_) {
+        hits += reader->statements.hits();
+    }
+    return hits;
+}
+
+uint64_t Database::statementCacheMisses() const {
+    uint64_t misses = writer_.statements.misses();
+    std::lock_guard<std::mutex> lock(readers_mutex_);
+    for (const auto& reader : readers_) {
+        misses += reader->statements.misses();
+    }
+    return misses;
+}
+
+Database::Connection* Database::acquire_reader() {
+    {
+        std::lock_guard<std::mutex> lock(readers_mutex_);
+        if (!idle_readers_.empty()) {
+            Connection* reader = idle_readers_.back();
+            idle_readers_.pop_back();
+            return reader;
+        }
+    }
+    
+    // 所有读连接都在使用中，为当前线程新开一个
+    auto reader = std::make_unique<Connection>();
+    if (!open_connection(&reader->db, true)) {
+        return nullptr;
+    }
+    reader->statements.attach(reader->db);
+    
+    std::lock_guard<std::mutex> lock(readers_mutex_);
+    readers_.push_back(std::move(reader));
+    return readers_.back().get();
+}
+
+void Database::release_reader(Connection* reader) {
+    std::lock_guard<std::mutex> lock(readers_mutex_);
+    idle_readers_.push_back(reader);
+}
+
+Database::Statement Database::read_statement(std::string_view sql) {
+    Connection* reader = acquire_reader();
+    if (reader == nullptr) {
+        return Statement(this, nullptr, std::unique_lock<std::mutex>(), StatementCache::Handle());
+    }
+    StatementCache::Handle stmt = reader->statements.acquire(sql);
+    return Statement(this, reader, std::unique_lock<std::mutex>(), std::move(stmt));
+}
+
+Database::Statement Database::write_statement(std::string_view sql) {
+    std::unique_lock<std::mutex> lock(write_mutex_);
+    StatementCache::Handle stmt = writer_.statements.acquire(sql);
+    return Statement(this, nullptr, std::move(lock), std::move(stmt));
+}
+
+Database::Transaction::Transaction(Database* owner)
+    : owner_(owner), lock_(owner->write_mutex_), active_(false) {
+    active_ = owner_->db_ != nullptr && owner_->execute_locked("BEGIN IMMEDIATE");
+}
+
+Database::Transaction::~Transaction() {
+    if (active_) {
+        owner_->execute_locked("ROLLBACK");
+    }
+}
+
+StatementCache::Handle Database::Transaction::statement(std::string_view sql) {
+    return owner_->writer_.statements.acquire(sql);
+}
+
+bool Database::Transaction::commit() {
+    if (!active_ || !owner_->execute_locked("COMMIT")) {
+        return false;
+    }
+    active_ = false;
+    return true;
+}
+
+Database::Statement::Statement(Database* owner, Connection* reader, std::unique_lock<std::mutex> write_lock,
+                               StatementCache::Handle stmt)
+    : owner_(owner), reader_(reader), write_lock_(std::move(write_lock)), stmt_(std::move(stmt)) {
+}
+
+Database::Statement::Statement(Statement&& other) noexcept
+    : owner_(other.owner_), reader_(other.reader_), write_lock_(std::move(other.write_lock_)),
+      stmt_(std::move(other.stmt_)) {
+    other.reader_ = nullptr;
+}
+
+Database::Statement::~Statement() {
+    // 语句必须在连接归还、写锁释放之前reset
+    stmt_ = StatementCache::Handle();
+    if (reader_ != nullptr) {
+        owner_->release_reader(reader_);
+    }
+}
+
 bool Database::execute(const std::string& sql) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    return execute_locked(sql);
+}
+
+bool Database::execute_locked(const std::string& sql) {
     char* errMsg = nullptr;
     int rc = sqlite3_exec(db_, sql.c_str(), nullptr, nullptr, &errMsg);
     
@@ -60,9 +251,235 @@ bool Database::execute(const std::string& sql) {
     return true;
 }
 
-bool Database::createTables() {
-    // 创建用户表
-    std::string sql = R"(
+namespace {
+
+// 热点查询，集中定义以便启动时用EXPLAIN QUERY PLAN核对执行计划
+// 列表按 (排序时间, id) 降序，id保证顺序唯一；*AfterSql 为游标分页版本，从游标之后继续取
+const char* kUserFilesSql =
+    "SELECT id, filename, filepath, file_type, file_size, uploader_id, upload_time, category, download_count, is_public, is_shared, shared_at, description "
+    "FROM files WHERE uploader_id = ? ORDER BY upload_time DESC, id DESC LIMIT ? OFFSET ?";
+const char* kUserFilesAfterSql =
+    "SELECT id, filename, filepath, file_type, file_size, uploader_id, upload_time, category, download_count, is_public, is_shared, shared_at, description "
+    "FROM files WHERE uploader_id = ? AND (upload_time, id) < (?, ?) ORDER BY upload_time DESC, id DESC LIMIT ?";
+const char* kSharedFilesSql =
+    "SELECT f.id, f.filename, f.filepath, f.file_type, f.file_size, f.uploader_id, f.upload_time, f.category, f.download_count, f.is_public, f.is_shared, f.shared_at, f.description, u.username "
+    "FROM files f LEFT JOIN users u ON f.uploader_id = u.id WHERE f.is_shared = 1 ORDER BY f.shared_at DESC, f.id DESC LIMIT ? OFFSET ?";
+const char* kSharedFilesAfterSql =
+    "SELECT f.id, f.filename, f.filepath, f.file_type, f.file_size, f.uploader_id, f.upload_time, f.category, f.download_count, f.is_public, f.is_shared, f.shared_at, f.description, u.username "
+    "FROM files f LEFT JOIN users u ON f.uploader_id = u.id WHERE f.is_shared = 1 AND (f.shared_at, f.id) < (?, ?) ORDER BY f.shared_at DESC, f.id DESC LIMIT ?";
+// 搜索：结果列与分享列表相同。文件名命中的权重高于描述，再高于分类
+const char* kSearchSql =
+    "SELECT f.id, f.filename, f.filepath, f.file_type, f.file_size, f.uploader_id, f.upload_time, f.category, f.download_count, f.is_public, f.is_shared, f.shared_at, f.description, u.username "
+    "FROM files_fts JOIN files f ON f.id = files_fts.rowid LEFT JOIN users u ON f.uploader_id = u.id "
+    "WHERE files_fts MATCH ? AND (f.is_shared = 1 OR f.uploader_id = ?) "
+    "ORDER BY bm25(files_fts, 10.0, 2.0, 1.0), f.id DESC LIMIT ? OFFSET ?";
+// 含少于3个字的词时三元组索引用不上，退化为按时间顺序扫描匹配，每个词追加一个LIKE条件。
+// 扫描范围限定为最新的kMaxSearchScanRows个文件：先从idx_files_time取第N新的上传时间，
+// 再在该时间之后的索引区间内顺序匹配，无论是否命中都不会读遍整张表
+const int kMaxSearchScanRows = 20000;
+const char* kSearchLikeSql =
+    "SELECT f.id, f.filename, f.filepath, f.file_type, f.file_size, f.uploader_id, f.upload_time, f.category, f.download_count, f.is_public, f.is_shared, f.shared_at, f.description, u.username "
+    "FROM files f LEFT JOIN users u ON f.uploader_id = u.id "
+    "WHERE (f.is_shared = 1 OR f.uploader_id = ?1) "
+    "AND f.upload_time >= ifnull((SELECT upload_time FROM files ORDER BY upload_time DESC LIMIT 1 OFFSET ?2), '')";
+const char* kSearchLikeWordSql =
+    " AND (f.filename || char(10) || ifnull(f.description, '') || char(10) || f.category) LIKE ? ESCAPE '\\'";
+const char* kSearchLikeOrderSql =
+    " ORDER BY f.upload_time DESC, f.id DESC LIMIT ? OFFSET ?";
+const size_t kMaxSearchWords = 8;
+const char* kFilesSql =
+    "SELECT id, filename, filepath, file_type, file_size, uploader_id, upload_time, category, download_count, is_public, is_shared, shared_at, description FROM files "
+    "ORDER BY upload_time DESC, id DESC LIMIT ? OFFSET ?";
+const char* kFilesAfterSql =
+    "SELECT id, filename, filepath, file_type, file_size, uploader_id, upload_time, category, download_count, is_public, is_shared, shared_at, description FROM files "
+    "WHERE (upload_time, id) < (?, ?) ORDER BY upload_time DESC, id DESC LIMIT ?";
+const char* kFilesByCategorySql =
+    "SELECT id, filename, filepath, file_type, file_size, uploader_id, upload_time, category, download_count, is_public, is_shared, shared_at, description FROM files "
+    "WHERE category = ? ORDER BY upload_time DESC, id DESC LIMIT ? OFFSET ?";
+const char* kFilesByCategoryAfterSql =
+    "SELECT id, filename, filepath, file_type, file_size, uploader_id, upload_time, category, download_count, is_public, is_shared, shared_at, description FROM files "
+    "WHERE category = ? AND (upload_time, id) < (?, ?) ORDER BY upload_time DESC, id DESC LIMIT ?";
+const char* kFileCountSql = "SELECT COUNT(*) FROM files";
+const char* kFileCountByCategorySql = "SELECT COUNT(*) FROM files WHERE category = ?";
+const char* kSessionSql =
+    "SELECT s.session_id, s.user_id, s.created_at, s.expires_at, u.username, u.role "
+    "FROM sessions s JOIN users u ON s.user_id = u.id "
+    "WHERE s.session_id = ? AND s.expires_at > datetime('now')";
+
+
+const char kBase64Url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+std::string base64url_encode(const std::string& input) {
+    std::string out;
+    out.reserve((input.size() + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 2 < input.size(); i += 3) {
+        uint32_t n = (static_cast<unsigned char>(input[i]) << 16) |
+                     (static_cast<unsigned char>(input[i + 1]) << 8) |
+                     static_cast<unsigned char>(input[i + 2]);
+        out += kBase64Url[(n >> 18) & 63];
+        out += kBase64Url[(n >> 12) & 63];
+        out += kBase64Url[(n >> 6) & 63];
+        out += kBase64Url[n & 63];
+    }
+    if (i < input.size()) {
+        uint32_t n = static_cast<unsigned char>(input[i]) << 16;
+        if (i + 1 < input.size()) {
+            n |= static_cast<unsigned char>(input[i + 1]) << 8;
+        }
+        out += kBase64Url[(n >> 18) & 63];
+        out += kBase64Url[(n >> 12) & 63];
+        if (i + 1 < input.size()) {
+            out += kBase64Url[(n >> 6) & 63];
+        }
+    }
+    return out;
+}
+
+bool base64url_decode(const std::string& input, std::string& out) {
+    out.clear();
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (char c : input) {
+        const char* pos = strchr(kBase64Url, c);
+        if (c == '\0' || pos == nullptr) {
+            return false;
+        }
+        buffer = (buffer << 6) | static_cast<uint32_t>(pos - kBase64Url);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out += static_cast<char>((buffer >> bits) & 0xFF);
+        }
+    }
+    return true;
+}
+
+// 按空白拆分搜索关键词，多余的词忽略
+std::vector<std::string> split_search_words(const std::string& keyword) {
+    std::vector<std::string> words;
+    std::istringstream stream(keyword);
+    std::string word;
+    while (words.size() < kMaxSearchWords && stream >> word) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+// 三元组分词器无法匹配少于3个字符（按UTF-8字符计）的词
+bool trigram_searchable(const std::vector<std::string>& words) {
+    for (const std::string& word : words) {
+        size_t chars = 0;
+        for (unsigned char c : word) {
+            if ((c & 0xC0) != 0x80) {
+                ++chars;
+            }
+        }
+        if (chars < 3) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// FTS5查询：每个词加引号作为短语（三元组下即子串匹配），各词之间为AND
+std::string build_match_query(const std::vector<std::string>& words) {
+    std::string query;
+    for (const std::string& word : words) {
+        if (!query.empty()) {
+            query += ' ';
+        }
+        query += '"';
+        for (char c : word) {
+            query += c;
+            if (c == '"') {
+                query += '"';
+            }
+        }
+        query += '"';
+    }
+    return query;
+}
+
+// LIKE模式：词作为子串，转义其中的通配符
+std::string build_like_pattern(const std::string& word) {
+    std::string pattern = "%";
+    for (char c : word) {
+        if (c == '%' || c == '_' || c == '\\') {
+            pattern += '\\';
+        }
+        pattern += c;
+    }
+    pattern += '%';
+    return pattern;
+}
+
+// 列的文本，NULL时为空；指向SQLite的缓冲区，在下一次step之前有效
+std::string_view column_view(sqlite3_stmt* stmt, int column) {
+    const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+    if (text == nullptr) {
+        return std::string_view();
+    }
+    return std::string_view(text, sqlite3_column_bytes(stmt, column));
+}
+
+// 文件列表查询的结果行：前13列顺序固定，分享列表和搜索多一列上传者用户名
+size_t visit_file_rows(sqlite3_stmt* stmt, const FileRowVisitor& visit) {
+    bool has_uploader = sqlite3_column_count(stmt) > 13;
+    size_t count = 0;
+    FileRow row;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        row.id = sqlite3_column_int(stmt, 0);
+        row.filename = column_view(stmt, 1);
+        row.filepath = column_view(stmt, 2);
+        row.file_type = column_view(stmt, 3);
+        row.file_size = sqlite3_column_int64(stmt, 4);
+        row.uploader_id = sqlite3_column_int(stmt, 5);
+        row.upload_time = column_view(stmt, 6);
+        row.category = column_view(stmt, 7);
+        row.download_count = sqlite3_column_int(stmt, 8);
+        row.is_public = sqlite3_column_int(stmt, 9) != 0;
+        row.is_shared = sqlite3_column_int(stmt, 10) != 0;
+        row.shared_at = column_view(stmt, 11);
+        row.description = column_view(stmt, 12);
+        row.uploader = has_uploader ? column_view(stmt, 13) : std::string_view();
+        visit(row);
+        ++count;
+    }
+    return count;
+}
+
+FileInfo to_file_info(const FileRow& row) {
+    FileInfo file;
+    file.id = row.id;
+    file.uploader_id = row.uploader_id;
+    file.download_count = row.download_count;
+    file.is_public = row.is_public;
+    file.is_shared = row.is_shared;
+    file.file_size = row.file_size;
+    file.filename = row.filename;
+    file.filepath = row.filepath;
+    file.file_type = row.file_type;
+    file.uploader = row.uploader;
+    file.upload_time = row.upload_time;
+    file.category = row.category;
+    file.shared_at = row.shared_at;
+    file.description = row.description;
+    return file;
+}
+
+std::vector<FileInfo> read_file_rows(sqlite3_stmt* stmt) {
+    std::vector<FileInfo> files;
+    visit_file_rows(stmt, [&files](const FileRow& row) { files.push_back(to_file_info(row)); });
+    return files;
+}
+
+} // namespace
+
+// 数据库结构迁移，按版本号顺序执行，已执行到的版本记录在PRAGMA user_version中。
+// 只能在末尾追加新版本，已发布的迁移不再修改
+const Database::Migration Database::kMigrations[] = {
+    {1, "创建基础表", R"(
         CREATE TABLE IF NOT EXISTS users (
             id INTEGER PRIMARY KEY AUTOINCREMENT,
             username TEXT UNIQUE NOT NULL,
@@ -73,14 +490,6 @@ bool Database::createTables() {
             storage_quota INTEGER DEFAULT 1073741824,
             storage_used INTEGER DEFAULT 0
         );
-    )";
-    
-    if (!execute(sql)) {
-        return false;
-    }
-    
-    // 创建文件表
-    sql = R"(
         CREATE TABLE IF NOT EXISTS files (
             id INTEGER PRIMARY KEY AUTOINCREMENT,
             filename TEXT NOT NULL,
@@ -97,14 +506,6 @@ bool Database::createTables() {
             description TEXT DEFAULT '',
             FOREIGN KEY (uploader_id) REFERENCES users (id)
         );
-    )";
-    
-    if (!execute(sql)) {
-        return false;
-    }
-    
-    // 创建会话表
-    sql = R"(
         CREATE TABLE IF NOT EXISTS sessions (
             session_id TEXT PRIMARY KEY,
             user_id INTEGER NOT NULL,
@@ -112,142 +513,253 @@ bool Database::createTables() {
             expires_at DATETIME NOT NULL,
             FOREIGN KEY (user_id) REFERENCES users (id)
         );
-    )";
-    
-    return execute(sql);
+    )", nullptr},
+    
+    // 引入版本号之前的数据库可能缺少配额和分享字段，新建的库已包含这些列
+    {2, "补齐配额与分享字段", nullptr, &Database::migrateLegacyColumns},
+    
+    // 个人文件、分享文件和分类列表的过滤与排序都走索引，不再全表扫描加临时排序；
+    // 分享文件只占少数，用部分索引
+    {3, "热点查询索引", R"(
+        CREATE INDEX IF NOT EXISTS idx_files_uploader_time ON files (uploader_id, upload_time DESC);
+        CREATE INDEX IF NOT EXISTS idx_files_shared ON files (shared_at DESC, upload_time DESC) WHERE is_shared = 1;
+        CREATE INDEX IF NOT EXISTS idx_files_category_time ON files (category, upload_time DESC);
+        CREATE INDEX IF NOT EXISTS idx_files_time ON files (upload_time DESC);
+        CREATE INDEX IF NOT EXISTS idx_sessions_expires ON sessions (expires_at);
+    )", nullptr},
+    
+    // 游标分页按 (时间, id) 排序。id即rowid，本就是每个索引的隐含末列，索引改为升序后
+    // 反向扫描正好得到 (时间 DESC, id DESC)，范围条件 (时间, id) < (?, ?) 也能直接定位；
+    // 旧数据中已分享但没有分享时间的文件用上传时间补齐，否则游标无法越过它们
+    {4, "游标分页索引", R"(
+        DROP INDEX IF EXISTS idx_files_uploader_time;
+        DROP INDEX IF EXISTS idx_files_shared;
+        DROP INDEX IF EXISTS idx_files_category_time;
+        DROP INDEX IF EXISTS idx_files_time;
+        CREATE INDEX idx_files_uploader_time ON files (uploader_id, upload_time);
+        CREATE INDEX idx_files_shared ON files (shared_at) WHERE is_shared = 1;
+        CREATE INDEX idx_files_category_time ON files (category, upload_time);
+        CREATE INDEX idx_files_time ON files (upload_time);
+        UPDATE files SET shared_at = upload_time WHERE is_shared = 1 AND shared_at IS NULL;
+    )", nullptr},
+    
+    // 文件名、描述和分类的全文索引。三元组分词按字符切分，中文文件名不需要分词也能做子串搜索；
+    // 外部内容表不重复存储文本，由触发器与files同步，只在这三列变化时更新
+    {5, "文件全文索引", R"(
+        CREATE VIRTUAL TABLE files_fts USING fts5(
+            filename, description, category,
+            content = 'files', content_rowid = 'id', tokenize = 'trigram'
+        );
+        CREATE TRIGGER files_fts_insert AFTER INSERT ON files BEGIN
+            INSERT INTO files_fts (rowid, filename, description, category)
+            VALUES (new.id, new.filename, new.description, new.category);
+        END;
+        CREATE TRIGGER files_fts_delete AFTER DELETE ON files BEGIN
+            INSERT INTO files_fts (files_fts, rowid, filename, description, category)
+            VALUES ('delete', old.id, old.filename, old.description, old.category);
+        END;
+        CREATE TRIGGER files_fts_update AFTER UPDATE OF filename, description, category ON files BEGIN
+            INSERT INTO files_fts (files_fts, rowid, filename, description, category)
+            VALUES ('delete', old.id, old.filename, old.description, old.category);
+            INSERT INTO files_fts (rowid, filename, description, category)
+            VALUES (new.id, new.filename, new.description, new.category);
+        END;
+        INSERT INTO files_fts (files_fts) VALUES ('rebuild');
+    )", nullptr},
+    
+    // 内容寻址存储：每份不同的内容一行，refcount为引用它的文件记录数，归零时删除内容。
+    // 此前上传的文件content_hash为空，仍按各自的filepath存放；部分索引只覆盖这些旧文件，
+    // 统计物理占用时不用扫描整个files表
+    {6, "内容寻址存储", R"(
+        CREATE TABLE blobs (
+            hash TEXT PRIMARY KEY,
+            size INTEGER NOT NULL,
+            refcount INTEGER NOT NULL,
+            created_at DATETIME DEFAULT CURRENT_TIMESTAMP
+        ) WITHOUT ROWID;
+        ALTER TABLE files ADD COLUMN content_hash TEXT NULL;
+        CREATE INDEX idx_files_unhashed_size ON files (file_size) WHERE content_hash IS NULL;
+    )", nullptr},
+};
+
+int Database::schemaVersion() {
+    Statement stmt = write_statement("PRAGMA user_version");
+    if (!stmt || sqlite3_step(stmt) != SQLITE_ROW) {
+        return -1;
+    }
+    return sqlite3_column_int(stmt, 0);
 }
 
-bool Database::upgradeTables() {
-    // 检查列是否存在的辅助函数
-    auto columnExists = [this](const std::string& table, const std::string& column) -> bool {
-        std::string sql = "SELECT COUNT(*) FROM pragma_table_info(?) WHERE name = ?";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+bool Database::migrate() {
+    int version = schemaVersion();
+    if (version < 0) {
+        return false;
+    }
+    
+    for (const Migration& migration : kMigrations) {
+        if (migration.version <= version) {
+            continue;
+        }
+        
+        // 每个版本在一个事务中完成，失败时回滚，下次启动从该版本重新执行
+        if (!execute("BEGIN IMMEDIATE")) {
             return false;
         }
-        sqlite3_bind_text(stmt, 1, table.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, column.c_str(), -1, SQLITE_STATIC);
-        bool exists = false;
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            exists = sqlite3_column_int(stmt, 0) > 0;
+        bool ok = migration.sql != nullptr ? execute(migration.sql) : (this->*migration.apply)();
+        ok = ok && execute("PRAGMA user_version = " + std::to_string(migration.version));
+        if (!ok || !execute("COMMIT")) {
+            execute("ROLLBACK");
+            std::cerr << "数据库迁移失败: 版本 " << migration.version << " (" << migration.description << ")" << std::endl;
+            return false;
         }
-        sqlite3_finalize(stmt);
-        return exists;
-    };
+        std::cout << "数据库迁移到版本 " << migration.version << ": " << migration.description << std::endl;
+    }
+    return true;
+}
 
-    // 为用户表添加配额字段
-    if (!columnExists("users", "storage_quota")) {
-        execute("ALTER TABLE users ADD COLUMN storage_quota INTEGER DEFAULT 1073741824");
+bool Database::columnExists(const std::string& table, const std::string& column) {
+    Statement stmt = write_statement("SELECT COUNT(*) FROM pragma_table_info(?) WHERE name = ?");
+    if (!stmt) {
+        return false;
     }
-    if (!columnExists("users", "storage_used")) {
-        execute("ALTER TABLE users ADD COLUMN storage_used INTEGER DEFAULT 0");
+    sqlite3_bind_text(stmt, 1, table.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, column.c_str(), -1, SQLITE_STATIC);
+    return sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) > 0;
+}
+
+bool Database::migrateLegacyColumns() {
+    static const char* const columns[][3] = {
+        {"users", "storage_quota", "INTEGER DEFAULT 1073741824"},
+        {"users", "storage_used", "INTEGER DEFAULT 0"},
+        {"files", "is_shared", "INTEGER DEFAULT 0"},
+        {"files", "shared_at", "DATETIME NULL"},
+        {"files", "description", "TEXT DEFAULT ''"},
+    };
+    for (const auto& column : columns) {
+        if (!columnExists(column[0], column[1]) &&
+            !execute(std::string("ALTER TABLE ") + column[0] + " ADD COLUMN " + column[1] + " " + column[2])) {
+            return false;
+        }
     }
     
-    // 为文件表添加分享字段
-    if (!columnExists("files", "is_shared")) {
-        execute("ALTER TABLE files ADD COLUMN is_shared INTEGER DEFAULT 0");
-    }
-    if (!columnExists("files", "shared_at")) {
-        execute("ALTER TABLE files ADD COLUMN shared_at DATETIME NULL");
+    // 旧版本默认公开的文件改为不分享
+    return execute("UPDATE files SET is_public = 0, is_shared = 0 WHERE is_public = 1");
+}
+
+bool Database::checkQueryPlans() {
+    static const char* const hot_queries[] = {
+        kUserFilesSql, kUserFilesAfterSql, kSharedFilesSql, kSharedFilesAfterSql,
+        kFilesSql, kFilesAfterSql, kFilesByCategorySql, kFilesByCategoryAfterSql,
+        kFileCountSql, kFileCountByCategorySql, kSessionSql
+    };
+    
+    // 一次性的诊断语句不经过语句缓存，用完即释放，不在读连接上常驻
+    Connection* reader = acquire_reader();
+    if (reader == nullptr) {
+        return false;
     }
-    if (!columnExists("files", "description")) {
-        execute("ALTER TABLE files ADD COLUMN description TEXT DEFAULT ''");
+    bool ok = true;
+    for (const char* sql : hot_queries) {
+        std::string explain = std::string("EXPLAIN QUERY PLAN ") + sql;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(reader->db, explain.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "SQL编译失败: " << sqlite3_errmsg(reader->db) << "\n    " << sql << std::endl;
+            sqlite3_finalize(stmt);
+            ok = false;
+            continue;
+        }
+        // 计划的第4列是描述；不带索引的SCAN是全表扫描，TEMP B-TREE是额外排序
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char* detail = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+            std::string plan = detail ? detail : "";
+            bool full_scan = plan.compare(0, 5, "SCAN ") == 0 && plan.find("INDEX") == std::string::npos;
+            if (full_scan || plan.find("TEMP B-TREE") != std::string::npos) {
+                std::cerr << "查询计划退化: " << plan << "\n    " << sql << std::endl;
+                ok = false;
+            }
+        }
+        sqlite3_finalize(stmt);
     }
-    
-    // 更新现有文件的默认分享状态
-    execute("UPDATE files SET is_public = 0, is_shared = 0 WHERE is_public = 1");
-    
-    return true;
+    release_reader(reader);
+    return ok;
 }
 
 // 获取用户文件
 std::vector<FileInfo> Database::getUserFiles(int user_id, int limit, int offset) {
-    std::string sql = "SELECT id, filename, filepath, file_type, file_size, uploader_id, upload_time, category, download_count, is_public, is_shared, shared_at, description FROM files WHERE uploader_id = ? ORDER BY upload_time DESC LIMIT ? OFFSET ?";
-    
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        return {};
+    std::vector<FileInfo> files;
+    listUserFiles(user_id, limit, offset, [&files](const FileRow& row) { files.push_back(to_file_info(row)); });
+    return files;
+}
+
+std::vector<FileInfo> Database::getUserFiles(int user_id, int limit, const FileCursor& after) {
+    std::vector<FileInfo> files;
+    listUserFiles(user_id, limit, after, [&files](const FileRow& row) { files.push_back(to_file_info(row)); });
+    return files;
+}
+
+size_t Database::listUserFiles(int user_id, int limit, int offset, const FileRowVisitor& visit) {
+    Statement stmt = read_statement(kUserFilesSql);
+    if (!stmt) {
+        return 0;
     }
     
     sqlite3_bind_int(stmt, 1, user_id);
     sqlite3_bind_int(stmt, 2, limit);
     sqlite3_bind_int(stmt, 3, offset);
     
-    std::vector<FileInfo> files;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        FileInfo file;
-        file.id = sqlite3_column_int(stmt, 0);
-        file.filename = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        file.filepath = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        file.file_type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        file.file_size = sqlite3_column_int64(stmt, 4);
-        file.uploader_id = sqlite3_column_int(stmt, 5);
-        file.upload_time = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-        file.category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-        file.download_count = sqlite3_column_int(stmt, 8);
-        file.is_public = sqlite3_column_int(stmt, 9) != 0;
-        file.is_shared = sqlite3_column_int(stmt, 10) != 0;
-        const char* shared_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 11));
-        file.shared_at = shared_at ? shared_at : "";
-        const char* description = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 12));
-        file.description = description ? description : "";
-        
-        // 设置其他字段
-        file.size = file.file_size;
-        file.mime_type = file.file_type;
-        file.uploader = "User " + std::to_string(file.uploader_id);
-        
-        files.push_back(file);
+    return visit_file_rows(stmt, visit);
+}
+
+size_t Database::listUserFiles(int user_id, int limit, const FileCursor& after, const FileRowVisitor& visit) {
+    Statement stmt = read_statement(kUserFilesAfterSql);
+    if (!stmt) {
+        return 0;
     }
     
-    sqlite3_finalize(stmt);
-    return files;
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_text(stmt, 2, after.key.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, after.id);
+    sqlite3_bind_int(stmt, 4, limit);
+    
+    return visit_file_rows(stmt, visit);
 }
 
 // 获取分享的文件
 std::vector<FileInfo> Database::getSharedFiles(int limit, int offset) {
-    std::string sql = "SELECT f.id, f.filename, f.filepath, f.file_type, f.file_size, f.uploader_id, f.upload_time, f.category, f.download_count, f.is_public, f.is_shared, f.shared_at, f.description, u.username FROM files f LEFT JOIN users u ON f.uploader_id = u.id WHERE f.is_shared = 1 ORDER BY f.shared_at DESC, f.upload_time DESC LIMIT ? OFFSET ?";
-    
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        return {};
+    std::vector<FileInfo> files;
+    listSharedFiles(limit, offset, [&files](const FileRow& row) { files.push_back(to_file_info(row)); });
+    return files;
+}
+
+std::vector<FileInfo> Database::getSharedFiles(int limit, const FileCursor& after) {
+    std::vector<FileInfo> files;
+    listSharedFiles(limit, after, [&files](const FileRow& row) { files.push_back(to_file_info(row)); });
+    return files;
+}
+
+size_t Database::listSharedFiles(int limit, int offset, const FileRowVisitor& visit) {
+    Statement stmt = read_statement(kSharedFilesSql);
+    if (!stmt) {
+        return 0;
     }
     
     sqlite3_bind_int(stmt, 1, limit);
     sqlite3_bind_int(stmt, 2, offset);
     
-    std::vector<FileInfo> files;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        FileInfo file;
-        file.id = sqlite3_column_int(stmt, 0);
-        file.filename = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        file.filepath = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        file.file_type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        file.file_size = sqlite3_column_int64(stmt, 4);
-        file.uploader_id = sqlite3_column_int(stmt, 5);
-        file.upload_time = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-        file.category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-        file.download_count = sqlite3_column_int(stmt, 8);
-        file.is_public = sqlite3_column_int(stmt, 9) != 0;
-        file.is_shared = sqlite3_column_int(stmt, 10) != 0;
-        const char* shared_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 11));
-        file.shared_at = shared_at ? shared_at : "";
-        const char* description = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 12));
-        file.description = description ? description : "";
-        const char* username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 13));
-        file.uploader = username ? username : "Unknown";
-        
-        // 设置其他字段
-        file.size = file.file_size;
-        file.mime_type = file.file_type;
-        
-        files.push_back(file);
+    return visit_file_rows(stmt, visit);
+}
+
+size_t Database::listSharedFiles(int limit, const FileCursor& after, const FileRowVisitor& visit) {
+    Statement stmt = read_statement(kSharedFilesAfterSql);
+    if (!stmt) {
+        return 0;
     }
     
-    sqlite3_finalize(stmt);
-    return files;
+    sqlite3_bind_text(stmt, 1, after.key.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, after.id);
+    sqlite3_bind_int(stmt, 3, limit);
+    
+    return visit_file_rows(stmt, visit);
 }
 
 // 切换文件分享状态
@@ -259,15 +771,13 @@ bool Database::toggleFileShare(int file_id, bool is_shared) {
         sql = "UPDATE files SET is_shared = 0, shared_at = NULL WHERE id = ?";
     }
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    Statement stmt = write_statement(sql);
+    if (!stmt) {
         return false;
     }
     
     sqlite3_bind_int(stmt, 1, file_id);
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
     return success;
 }
@@ -276,16 +786,14 @@ bool Database::toggleFileShare(int file_id, bool is_shared) {
 bool Database::updateUserStorage(int user_id, long storage_change) {
     std::string sql = "UPDATE users SET storage_used = storage_used + ? WHERE id = ?";
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    Statement stmt = write_statement(sql);
+    if (!stmt) {
         return false;
     }
     
     sqlite3_bind_int64(stmt, 1, storage_change);
     sqlite3_bind_int(stmt, 2, user_id);
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
     return success;
 }
@@ -294,9 +802,8 @@ bool Database::updateUserStorage(int user_id, long storage_change) {
 std::pair<long, long> Database::getUserStorageInfo(int user_id) {
     std::string sql = "SELECT storage_used, storage_quota FROM users WHERE id = ?";
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    Statement stmt = read_statement(sql);
+    if (!stmt) {
         return {0, 0};
     }
     
@@ -307,27 +814,117 @@ std::pair<long, long> Database::getUserStorageInfo(int user_id) {
         result.first = sqlite3_column_int64(stmt, 0);  // storage_used
         result.second = sqlite3_column_int64(stmt, 1); // storage_quota
     }
-    
-    sqlite3_finalize(stmt);
     return result;
 }
 
+Database::UploadStatus Database::commitUpload(const std::string& filename, const std::string& filepath,
+                                              const std::string& file_type, long file_size, int uploader_id,
+                                              const std::string& category, const std::string& content_hash,
+                                              const std::function<bool()>& store_content, int& file_id, long& available) {
+    file_id = 0;
+    available = 0;
+    
+    Transaction txn(this);
+    if (!txn.active()) {
+        return UploadStatus::Failed;
+    }
+    
+    // 配额检查与占用合为一条条件更新，没有返回行说明配额不足（或用户不存在）
+    {
+        StatementCache::Handle stmt = txn.statement(
+            "UPDATE users SET storage_used = storage_used + ?1 "
+            "WHERE id = ?2 AND storage_used + ?1 <= storage_quota RETURNING storage_used");
+        if (!stmt) {
+            return UploadStatus::Failed;
+        }
+        sqlite3_bind_int64(stmt, 1, file_size);
+        sqlite3_bind_int(stmt, 2, uploader_id);
+        int rc = sqlite3_step(stmt);
+        if (rc == SQLITE_DONE) {
+            StatementCache::Handle query = txn.statement("SELECT storage_quota - storage_used FROM users WHERE id = ?");
+            if (query) {
+                sqlite3_bind_int(query, 1, uploader_id);
+                if (sqlite3_step(query) == SQLITE_ROW) {
+                    available = sqlite3_column_int64(query, 0);
+                }
+            }
+            return UploadStatus::QuotaExceeded;
+        }
+        if (rc != SQLITE_ROW) {
+            return UploadStatus::Failed;
+        }
+    }
+    
+    {
+        StatementCache::Handle stmt = txn.statement(
+            "INSERT INTO files (filename, filepath, file_type, file_size, uploader_id, category, is_public, content_hash) "
+            "VALUES (?, ?, ?, ?, ?, ?, 0, ?) RETURNING id");
+        if (!stmt) {
+            return UploadStatus::Failed;
+        }
+        sqlite3_bind_text(stmt, 1, filename.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, filepath.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, file_type.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 4, file_size);
+        sqlite3_bind_int(stmt, 5, uploader_id);
+        sqlite3_bind_text(stmt, 6, category.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 7, content_hash.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) != SQLITE_ROW) {
+            return UploadStatus::Failed;
+        }
+        file_id = sqlite3_column_int(stmt, 0);
+    }
+    
+    // 相同内容已存在时只增加引用计数；引用计数为1说明内容是本次新增的
+    bool new_content = false;
+    {
+        StatementCache::Handle stmt = txn.statement(
+            "INSERT INTO blobs (hash, size, refcount) VALUES (?, ?, 1) "
+            "ON CONFLICT (hash) DO UPDATE SET refcount = refcount + 1 RETURNING refcount");
+        if (!stmt) {
+            file_id = 0;
+            return UploadStatus::Failed;
+        }
+        sqlite3_bind_text(stmt, 1, content_hash.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, file_size);
+        if (sqlite3_step(stmt) != SQLITE_ROW) {
+            file_id = 0;
+            return UploadStatus::Failed;
+        }
+        new_content = sqlite3_column_int64(stmt, 0) == 1;
+    }
+    
+    // 内容在最后一条语句之后、提交之前落到对象目录，仍在写锁内，与删除时的引用计数检查互斥。
+    // 提交失败时本次新增的内容没有任何记录引用，立即删除，不留下孤儿对象
+    if (!store_content()) {
+        file_id = 0;
+        return UploadStatus::Failed;
+    }
+    if (!txn.commit()) {
+        if (new_content && std::remove(filepath.c_str()) != 0) {
+            std::cerr << "删除未提交的上传内容失败: " << filepath << std::endl;
+        }
+        file_id = 0;
+        return UploadStatus::Failed;
+    }
+    return UploadStatus::Committed;
+}
+
 bool Database::createDefaultAdmin() {
     // 检查是否已存在admin用户
-    sqlite3_stmt* stmt;
     std::string sql = "SELECT COUNT(*) FROM users WHERE username = 'admin'";
     
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-        return false;
-    }
-    
     bool adminExists = false;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        adminExists = sqlite3_column_int(stmt, 0) > 0;
+    {
+        Statement stmt = read_statement(sql);
+        if (!stmt) {
+            return false;
+        }
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            adminExists = sqlite3_column_int(stmt, 0) > 0;
+        }
     }
     
-    sqlite3_finalize(stmt);
-    
     if (!adminExists) {
         return createUser("admin", "admin123", "admin");
     }
@@ -336,12 +933,16 @@ bool Database::createDefaultAdmin() {
 }
 
 bool Database::createUser(const std::string& username, const std::string& password, const std::string& role) {
-    std::string hashedPassword = hashPassword(password);
+    std::string hashedPassword;
+    if (passwords_.hash(password, hashedPassword) != PasswordHasher::Result::Match) {
+        std::cerr << "密码哈希失败: " << username << std::endl;
+        return false;
+    }
     
-    sqlite3_stmt* stmt;
     std::string sql = "INSERT INTO users (username, password_hash, role) VALUES (?, ?, ?)";
     
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    Statement stmt = write_statement(sql);
+    if (!stmt) {
         return false;
     }
     
@@ -350,47 +951,74 @@ bool Database::createUser(const std::string& username, const std::string& passwo
     sqlite3_bind_text(stmt, 3, role.c_str(), -1, SQLITE_STATIC);
     
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
     return success;
 }
 
 User* Database::authenticateUser(const std::string& username, const std::string& password) {
-    sqlite3_stmt* stmt;
-    std::string sql = "SELECT id, username, password_hash, role, created_at, active, storage_quota, storage_used FROM users WHERE username = ? AND active = 1";
-    
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    if (checkPassword(username, password) != PasswordCheck::Valid) {
         return nullptr;
     }
-    
-    sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
-    
-    User* user = nullptr;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        std::string storedHash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        
-        if (verifyPassword(password, storedHash)) {
-            user = new User();
-            user->id = sqlite3_column_int(stmt, 0);
-            user->username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-            user->password_hash = storedHash;
-            user->role = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-            user->created_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-            user->active = sqlite3_column_int(stmt, 5) != 0;
-            user->storage_quota = sqlite3_column_int64(stmt, 6);
-            user->storage_used = sqlite3_column_int64(stmt, 7);
+    return getUserByUsername(username);
+}
+
+Database::PasswordCheck Database::checkPassword(const std::string& username, const std::string& password) {
+    std::string stored_hash;
+    {
+        // KDF耗时几十毫秒，先取出哈希并归还读连接再计算
+        Statement stmt = read_statement("SELECT password_hash FROM users WHERE username = ? AND active = 1");
+        if (!stmt) {
+            return PasswordCheck::Invalid;
+        }
+        sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0)) {
+            stored_hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
         }
     }
+    if (stored_hash.empty()) {
+        // 用户不存在或已停用：同样付出一次KDF的代价再拒绝，避免按耗时枚举用户名
+        return passwords_.verify_dummy(password) == PasswordHasher::Result::Busy ? PasswordCheck::Busy
+                                                                                 : PasswordCheck::Invalid;
+    }
     
-    sqlite3_finalize(stmt);
-    return user;
+    switch (passwords_.verify(password, stored_hash)) {
+        case PasswordHasher::Result::Match:
+            return PasswordCheck::Valid;
+        case PasswordHasher::Result::MatchNeedsRehash:
+            rehashPassword(username, password, stored_hash);
+            return PasswordCheck::Valid;
+        case PasswordHasher::Result::Busy:
+            return PasswordCheck::Busy;
+        default:
+            return PasswordCheck::Invalid;
+    }
+}
+
+void Database::rehashPassword(const std::string& username, const std::string& password,
+                              const std::string& expected_hash) {
+    // 升级失败不影响本次登录，下次登录再试
+    std::string new_hash;
+    if (passwords_.hash(password, new_hash) != PasswordHasher::Result::Match) {
+        return;
+    }
+    
+    Statement stmt = write_statement("UPDATE users SET password_hash = ? WHERE username = ? AND password_hash = ?");
+    if (!stmt) {
+        return;
+    }
+    sqlite3_bind_text(stmt, 1, new_hash.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, username.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, expected_hash.c_str(), -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        std::cerr << "密码哈希升级失败: " << username << std::endl;
+    }
 }
 
 User* Database::getUserById(int user_id) {
-    sqlite3_stmt* stmt;
     std::string sql = "SELECT id, username, password_hash, role, created_at, active, storage_quota, storage_used FROM users WHERE id = ?";
     
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    Statement stmt = read_statement(sql);
+    if (!stmt) {
         return nullptr;
     }
     
@@ -408,16 +1036,14 @@ User* Database::getUserById(int user_id) {
         user->storage_quota = sqlite3_column_int64(stmt, 6);
         user->storage_used = sqlite3_column_int64(stmt, 7);
     }
-    
-    sqlite3_finalize(stmt);
     return user;
 }
 
 User* Database::getUserByUsername(const std::string& username) {
-    sqlite3_stmt* stmt;
     std::string sql = "SELECT id, username, password_hash, role, created_at, active FROM users WHERE username = ?";
     
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    Statement stmt = read_statement(sql);
+    if (!stmt) {
         return nullptr;
     }
     
@@ -433,18 +1059,16 @@ User* Database::getUserByUsername(const std::string& username) {
         user->created_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
         user->active = sqlite3_column_int(stmt, 5) != 0;
     }
-    
-    sqlite3_finalize(stmt);
     return user;
 }
 
 std::vector<FileInfo> Database::getPublicFiles(int limit, int offset) {
     std::vector<FileInfo> files;
     
-    sqlite3_stmt* stmt;
     std::string sql = "SELECT id, filename, filepath, file_type, file_size, upload_time, uploader_id, category, download_count, is_public FROM files WHERE is_public = 1 ORDER BY upload_time DESC LIMIT ? OFFSET ?";
     
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    Statement stmt = read_statement(sql);
+    if (!stmt) {
         return files;
     }
     
@@ -466,16 +1090,14 @@ std::vector<FileInfo> Database::getPublicFiles(int limit, int offset) {
         
         files.push_back(file);
     }
-    
-    sqlite3_finalize(stmt);
     return files;
 }
 
 bool Database::createSession(const std::string& session_id, int user_id, int expires_hours) {
-    sqlite3_stmt* stmt;
     std::string sql = "INSERT INTO sessions (session_id, user_id, expires_at) VALUES (?, ?, datetime('now', '+' || ? || ' hours'))";
     
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    Statement stmt = write_statement(sql);
+    if (!stmt) {
         return false;
     }
     
@@ -484,16 +1106,15 @@ bool Database::createSession(const std::string& session_id, int user_id, int exp
     sqlite3_bind_int(stmt, 3, expires_hours);
     
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
     return success;
 }
 
 Session* Database::validateSession(const std::string& session_id) {
-    sqlite3_stmt* stmt;
     std::string sql = "SELECT session_id, user_id, created_at, expires_at FROM sessions WHERE session_id = ? AND expires_at > datetime('now')";
     
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    Statement stmt = read_statement(sql);
+    if (!stmt) {
         return nullptr;
     }
     
@@ -507,47 +1128,26 @@ Session* Database::validateSession(const std::string& session_id) {
         session->created_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
         session->expires_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
     }
-    
-    sqlite3_finalize(stmt);
     return session;
 }
 
 bool Database::deleteSession(const std::string& session_id) {
-    sqlite3_stmt* stmt;
     std::string sql = "DELETE FROM sessions WHERE session_id = ?";
     
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    Statement stmt = write_statement(sql);
+    if (!stmt) {
         return false;
     }
     
     sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_STATIC);
     
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
+    // 先删库再删缓存，见SessionCache::put_if_unchanged
+    sessions_.erase(session_id);
     return success;
 }
 
-std::string Database::hashPassword(const std::string& password) {
-    // 简单的SHA256哈希，实际项目中应该使用更安全的方法如bcrypt
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256_CTX sha256;
-    SHA256_Init(&sha256);
-    SHA256_Update(&sha256, password.c_str(), password.length());
-    SHA256_Final(hash, &sha256);
-    
-    std::stringstream ss;
-    for(int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
-    }
-    
-    return ss.str();
-}
-
-bool Database::verifyPassword(const std::string& password, const std::string& hash) {
-    return hashPassword(password) == hash;
-}
-
 std::string Database::generateSessionId() {
     std::random_device rd;
     std::mt19937 gen(rd());
@@ -561,18 +1161,16 @@ std::string Database::generateSessionId() {
 }
 
 void Database::cleanupExpiredSessions() {
-    const char* sql = "DELETE FROM sessions WHERE expires_at <= datetime('now')";
-    sqlite3_exec(db_, sql, nullptr, nullptr, nullptr);
+    // 由会话缓存的后台清理线程定期调用，内存中的过期项已先行清理
+    execute("DELETE FROM sessions WHERE expires_at <= datetime('now')");
 }
 
 int Database::addFileRecord(const std::string& filename, const std::string& filepath,
                           const std::string& category, long size, 
                           const std::string& mime_type, int uploader_id) {
     const char* sql = "INSERT INTO files (filename, filepath, category, size, mime_type, uploader_id) VALUES (?, ?, ?, ?, ?, ?)";
-    sqlite3_stmt* stmt;
-    
-    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    Statement stmt = write_statement(sql);
+    if (!stmt) {
         return -1;
     }
     
@@ -583,8 +1181,7 @@ int Database::addFileRecord(const std::string& filename, const std::string& file
     sqlite3_bind_text(stmt, 5, mime_type.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_int(stmt, 6, uploader_id);
     
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    int rc = sqlite3_step(stmt);
     
     if (rc != SQLITE_DONE) {
         return -1;
@@ -594,57 +1191,78 @@ int Database::addFileRecord(const std::string& filename, const std::string& file
 }
 
 std::vector<FileInfo> Database::getFiles(int limit, int offset, const std::string& category) {
-    std::string sql = "SELECT id, filename, filepath, category, file_size, file_type, uploader_id, upload_time FROM files";
+    std::vector<FileInfo> files;
+    listFiles(limit, offset, category, [&files](const FileRow& row) { files.push_back(to_file_info(row)); });
+    return files;
+}
+
+std::vector<FileInfo> Database::getFiles(int limit, const FileCursor& after, const std::string& category) {
+    std::vector<FileInfo> files;
+    listFiles(limit, after, category, [&files](const FileRow& row) { files.push_back(to_file_info(row)); });
+    return files;
+}
+
+size_t Database::listFiles(int limit, int offset, const std::string& category, const FileRowVisitor& visit) {
+    Statement stmt = read_statement(category.empty() ? kFilesSql : kFilesByCategorySql);
+    if (!stmt) {
+        return 0;
+    }
     
+    int param_index = 1;
     if (!category.empty()) {
-        sql += " WHERE category = ?";
+        sqlite3_bind_text(stmt, param_index++, category.c_str(), -1, SQLITE_STATIC);
     }
+    sqlite3_bind_int(stmt, param_index++, limit);
+    sqlite3_bind_int(stmt, param_index, offset);
     
-    sql += " ORDER BY upload_time DESC LIMIT ? OFFSET ?";
-    
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        return {};
+    return visit_file_rows(stmt, visit);
+}
+
+size_t Database::listFiles(int limit, const FileCursor& after, const std::string& category, const FileRowVisitor& visit) {
+    Statement stmt = read_statement(category.empty() ? kFilesAfterSql : kFilesByCategoryAfterSql);
+    if (!stmt) {
+        return 0;
     }
     
     int param_index = 1;
     if (!category.empty()) {
         sqlite3_bind_text(stmt, param_index++, category.c_str(), -1, SQLITE_STATIC);
     }
-    sqlite3_bind_int(stmt, param_index++, limit);
-    sqlite3_bind_int(stmt, param_index, offset);
+    sqlite3_bind_text(stmt, param_index++, after.key.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, param_index++, after.id);
+    sqlite3_bind_int(stmt, param_index, limit);
     
-    std::vector<FileInfo> files;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        FileInfo file;
-        file.id = sqlite3_column_int(stmt, 0);
-        file.filename = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        file.filepath = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        file.category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        file.size = sqlite3_column_int64(stmt, 4);                    // file_size
-        file.mime_type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));  // file_type
-        file.uploader_id = sqlite3_column_int(stmt, 6);
-        file.upload_time = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7)); // upload_time
-        
-        // 设置其他字段的默认值
-        file.uploader = "User " + std::to_string(file.uploader_id);
-        file.download_count = 0;
-        file.is_public = true;
-        
-        files.push_back(file);
+    return visit_file_rows(stmt, visit);
+}
+
+std::string Database::encodeCursor(const FileCursor& cursor) {
+    return base64url_encode(cursor.key + "\n" + std::to_string(cursor.id));
+}
+
+bool Database::decodeCursor(const std::string& token, FileCursor& cursor) {
+    std::string raw;
+    if (token.empty() || token.size() > 256 || !base64url_decode(token, raw)) {
+        return false;
     }
-    
-    sqlite3_finalize(stmt);
-    return files;
+    size_t sep = raw.rfind('\n');
+    if (sep == std::string::npos || sep + 1 >= raw.size()) {
+        return false;
+    }
+    char* end = nullptr;
+    long id = strtol(raw.c_str() + sep + 1, &end, 10);
+    if (*end != '\0' || id <= 0 || id > INT32_MAX) {
+        return false;
+    }
+    cursor.key = raw.substr(0, sep);
+    cursor.id = static_cast<int>(id);
+    return true;
 }
 
 FileInfo* Database::getFileById(int file_id) {
-    const char* sql = "SELECT id, filename, filepath, category, file_size, file_type, uploader_id, upload_time FROM files WHERE id = ?";
-    sqlite3_stmt* stmt;
-    
-    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    const char* sql = "SELECT id, filename, filepath, category, file_size, file_type, uploader_id, upload_time, is_shared "
+                      "FROM files WHERE id = ?";
+    Statement stmt = read_statement(sql);
+    if (!stmt) {
         return nullptr;
     }
     
@@ -657,22 +1275,19 @@ FileInfo* Database::getFileById(int file_id) {
         file->filename = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
         file->filepath = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
         file->category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        file->size = sqlite3_column_int64(stmt, 4);                    // file_size
-        file->mime_type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));  // file_type
+        file->file_size = sqlite3_column_int64(stmt, 4);
+        file->file_type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
         file->uploader_id = sqlite3_column_int(stmt, 6);
-        file->upload_time = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7)); // upload_time
+        file->upload_time = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
+        file->is_shared = sqlite3_column_int(stmt, 8) != 0;
     }
-    
-    sqlite3_finalize(stmt);
     return file;
 }
 
 FileInfo Database::getFileByName(const std::string& filename) {
-    const char* sql = "SELECT id, filename, filepath, category, size, mime_type, uploader_id, uploaded_at FROM files WHERE filename = ?";
-    sqlite3_stmt* stmt;
-    
-    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    const char* sql = "SELECT id, filename, filepath, category, file_size, file_type, uploader_id, upload_time FROM files WHERE filename = ?";
+    Statement stmt = read_statement(sql);
+    if (!stmt) {
         return FileInfo();
     }
     
@@ -684,26 +1299,17 @@ FileInfo Database::getFileByName(const std::string& filename) {
         file.filename = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
         file.filepath = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
         file.category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        file.size = sqlite3_column_int64(stmt, 4);
-        file.mime_type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+        file.file_size = sqlite3_column_int64(stmt, 4);
+        file.file_type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
         file.uploader_id = sqlite3_column_int(stmt, 6);
-        file.uploaded_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
+        file.upload_time = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
     }
-    
-    sqlite3_finalize(stmt);
     return file;
 }
 
 int Database::getTotalFileCount(const std::string& category) {
-    std::string sql = "SELECT COUNT(*) FROM files";
-    
-    if (!category.empty()) {
-        sql += " WHERE category = ?";
-    }
-    
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    Statement stmt = read_statement(category.empty() ? kFileCountSql : kFileCountByCategorySql);
+    if (!stmt) {
         return 0;
     }
     
@@ -715,17 +1321,13 @@ int Database::getTotalFileCount(const std::string& category) {
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         count = sqlite3_column_int(stmt, 0);
     }
-    
-    sqlite3_finalize(stmt);
     return count;
 }
 
 int Database::getUserCount() {
     const char* sql = "SELECT COUNT(*) FROM users";
-    sqlite3_stmt* stmt;
-    
-    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    Statement stmt = read_statement(sql);
+    if (!stmt) {
         return 0;
     }
     
@@ -733,8 +1335,6 @@ int Database::getUserCount() {
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         count = sqlite3_column_int(stmt, 0);
     }
-    
-    sqlite3_finalize(stmt);
     return count;
 }
 
@@ -744,10 +1344,8 @@ int Database::getFileCount() {
 
 long Database::getTotalFileSize() {
     const char* sql = "SELECT SUM(size) FROM files";
-    sqlite3_stmt* stmt;
-    
-    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    Statement stmt = read_statement(sql);
+    if (!stmt) {
         return 0;
     }
     
@@ -755,25 +1353,32 @@ long Database::getTotalFileSize() {
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         total_size = sqlite3_column_int64(stmt, 0);
     }
-    
-    sqlite3_finalize(stmt);
     return total_size;
 }
 
 // 为兼容性添加缺失的方法
 Session Database::get_session(const std::string& session_id) {
-    const char* sql = "SELECT s.session_id, s.user_id, s.created_at, s.expires_at, u.username, u.role "
-                     "FROM sessions s JOIN users u ON s.user_id = u.id "
-                     "WHERE s.session_id = ? AND s.expires_at > datetime('now')";
-    sqlite3_stmt* stmt;
+    Session session;
+    CachedSession cached;
+    if (sessions_.get(session_id, cached)) {
+        session.session_id = session_id;
+        session.user_id = cached.user_id;
+        session.username = cached.username;
+        session.role = cached.role;
+        session.created_at = cached.created_at;
+        session.expires_at = cached.expires_at;
+        return session;
+    }
     
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return Session();
+    // 缓存未命中（如服务重启前创建的会话），查库后放入缓存
+    uint64_t epoch = sessions_.epoch(session_id);
+    Statement stmt = read_statement(kSessionSql);
+    if (!stmt) {
+        return session;
     }
     
     sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_STATIC);
     
-    Session session;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         session.session_id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
         session.user_id = sqlite3_column_int(stmt, 1);
@@ -781,9 +1386,15 @@ Session Database::get_session(const std::string& session_id) {
         session.expires_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
         session.username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
         session.role = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+        
+        cached.user_id = session.user_id;
+        cached.username = session.username;
+        cached.role = session.role;
+        cached.created_at = session.created_at;
+        cached.expires_at = session.expires_at;
+        cached.expires = SessionCache::parse_timestamp(session.expires_at);
+        sessions_.put_if_unchanged(session_id, cached, epoch);
     }
-    
-    sqlite3_finalize(stmt);
     return session;
 }
 
@@ -806,58 +1417,99 @@ User Database::get_user(const std::string& username) {
     return User();
 }
 
-bool Database::create_session(const std::string& session_id, const std::string& username, const std::string& role) {
+bool Database::create_session(const std::string& session_id, const std::string& username) {
     // 首先获取用户ID
     User* user = getUserByUsername(username);
     if (!user) {
         return false;
     }
     
-    int user_id = user->id;
+    CachedSession cached;
+    cached.user_id = user->id;
+    cached.username = user->username;
+    cached.role = user->role;
     delete user;
     
-    // 使用正确的表结构插入会话
-    const char* sql = "INSERT INTO sessions (session_id, user_id, expires_at) VALUES (?, ?, datetime('now', '+24 hours'))";
-    sqlite3_stmt* stmt;
-    
-    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        return false;
+    // 使用正确的表结构插入会话，时间由数据库生成后取回，与表中保持一致
+    const char* sql = "INSERT INTO sessions (session_id, user_id, expires_at) VALUES (?, ?, datetime('now', '+24 hours')) "
+                      "RETURNING created_at, expires_at";
+    {
+        Statement stmt = write_statement(sql);
+        if (!stmt) {
+            return false;
+        }
+        
+        sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, cached.user_id);
+        
+        if (sqlite3_step(stmt) != SQLITE_ROW) {
+            return false;
+        }
+        cached.created_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        cached.expires_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            return false;
+        }
     }
     
-    sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 2, user_id);
-    
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    
-        return rc == SQLITE_DONE;
+    cached.expires = SessionCache::parse_timestamp(cached.expires_at);
+    sessions_.put(session_id, cached);
+    return true;
 }
 
 bool Database::incrementDownloadCount(int file_id) {
-    const char* sql = "UPDATE files SET download_count = download_count + 1 WHERE id = ?";
-    sqlite3_stmt* stmt;
+    downloads_.add(file_id);
+    return true;
+}
+
+bool Database::flushDownloadCounts() {
+    std::vector<std::pair<int, uint64_t>> counts = downloads_.take();
+    if (counts.empty()) {
+        return true;
+    }
+    
+    // 一个周期内的全部增量共用一次事务和一次提交
+    uint64_t total = 0;
+    bool ok;
+    {
+        Transaction txn(this);
+        ok = txn.active();
+        if (ok) {
+            StatementCache::Handle stmt = txn.statement("UPDATE files SET download_count = download_count + ? WHERE id = ?");
+            ok = stmt != nullptr;
+            for (size_t i = 0; ok && i < counts.size(); ++i) {
+                sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(counts[i].second));
+                sqlite3_bind_int(stmt, 2, counts[i].first);
+                ok = sqlite3_step(stmt) == SQLITE_DONE;
+                sqlite3_reset(stmt);
+                total += counts[i].second;
+            }
+        }
+        ok = ok && txn.commit();
+    }
     
-    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    if (!ok) {
+        downloads_.restore(counts);
+        std::cerr << "下载次数写入失败，下个周期重试" << std::endl;
         return false;
     }
-    
-    sqlite3_bind_int(stmt, 1, file_id);
-    
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    
-    return rc == SQLITE_DONE;
+    downloads_flushed_ += total;
+    return true;
+}
+
+uint64_t Database::pendingDownloadCount() const {
+    return downloads_.pending();
+}
+
+uint64_t Database::flushedDownloadCount() const {
+    return downloads_flushed_.load();
 }
 
 std::vector<User> Database::getAllUsers() {
     std::vector<User> users;
     const char* sql = "SELECT id, username, password_hash, role, created_at, active FROM users ORDER BY id";
-    sqlite3_stmt* stmt;
-    
-    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    Statement stmt = read_statement(sql);
+    if (!stmt) {
         return users;
     }
     
@@ -871,43 +1523,155 @@ std::vector<User> Database::getAllUsers() {
         user.active = sqlite3_column_int(stmt, 5) != 0;
         users.push_back(user);
     }
-    
-    sqlite3_finalize(stmt);
     return users;
 }
 
 bool Database::deleteUser(int user_id) {
     const char* sql = "DELETE FROM users WHERE id = ?";
-    sqlite3_stmt* stmt;
-    
-    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    Statement stmt = write_statement(sql);
+    if (!stmt) {
         return false;
     }
     
     sqlite3_bind_int(stmt, 1, user_id);
     
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    int rc = sqlite3_step(stmt);
     
+    sessions_.erase_user(user_id);
     return rc == SQLITE_DONE;
 }
 
-bool Database::deleteFile(int file_id) {
-    const char* sql = "DELETE FROM files WHERE id = ?";
-    sqlite3_stmt* stmt;
+bool Database::deleteFile(int file_id, const std::function<void(const std::string& filepath)>& remove_content) {
+    Transaction txn(this);
+    if (!txn.active()) {
+        return false;
+    }
     
-    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    std::string filepath;
+    std::string content_hash;
+    {
+        StatementCache::Handle stmt = txn.statement(
+            "DELETE FROM files WHERE id = ? RETURNING filepath, file_size, uploader_id, content_hash");
+        if (!stmt) {
+            return false;
+        }
+        sqlite3_bind_int(stmt, 1, file_id);
+        if (sqlite3_step(stmt) != SQLITE_ROW) {
+            return false;
+        }
+        filepath = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        long file_size = sqlite3_column_int64(stmt, 1);
+        int uploader_id = sqlite3_column_int(stmt, 2);
+        if (sqlite3_column_type(stmt, 3) != SQLITE_NULL) {
+            content_hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        }
+        sqlite3_reset(stmt);
+        
+        StatementCache::Handle usage = txn.statement(
+            "UPDATE users SET storage_used = MAX(storage_used - ?, 0) WHERE id = ?");
+        if (!usage) {
+            return false;
+        }
+        sqlite3_bind_int64(usage, 1, file_size);
+        sqlite3_bind_int(usage, 2, uploader_id);
+        if (sqlite3_step(usage) != SQLITE_DONE) {
+            return false;
+        }
+    }
+    
+    // 去重之前上传的文件独占自己的路径，直接删除；共享内容等最后一个引用删除后才删除
+    bool orphaned = content_hash.empty();
+    if (!orphaned) {
+        StatementCache::Handle stmt = txn.statement(
+            "UPDATE blobs SET refcount = refcount - 1 WHERE hash = ? RETURNING refcount");
+        if (!stmt) {
+            return false;
+        }
+        sqlite3_bind_text(stmt, 1, content_hash.c_str(), -1, SQLITE_STATIC);
+        orphaned = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int64(stmt, 0) <= 0;
+        sqlite3_reset(stmt);
+        
+        if (orphaned) {
+            StatementCache::Handle remove = txn.statement("DELETE FROM blobs WHERE hash = ?");
+            if (!remove) {
+                return false;
+            }
+            sqlite3_bind_text(remove, 1, content_hash.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(remove) != SQLITE_DONE) {
+                return false;
+            }
+        }
+    }
+    
+    if (!txn.commit()) {
+        return false;
+    }
+    // 提交后写锁仍由txn持有，此时删除内容不会与同一内容的上传交错
+    if (orphaned) {
+        remove_content(filepath);
+    }
+    return true;
+}
+
+bool Database::getStorageUsage(long& logical, long& physical) {
+    Statement stmt = read_statement(
+        "SELECT (SELECT COALESCE(SUM(storage_used), 0) FROM users), "
+        "(SELECT COALESCE(SUM(size), 0) FROM blobs) + "
+        "(SELECT COALESCE(SUM(file_size), 0) FROM files WHERE content_hash IS NULL)");
+    if (!stmt || sqlite3_step(stmt) != SQLITE_ROW) {
         return false;
     }
+    logical = sqlite3_column_int64(stmt, 0);
+    physical = sqlite3_column_int64(stmt, 1);
+    return true;
+}
+
+std::vector<FileInfo> Database::searchFiles(const std::string& keyword, int viewer_id, int limit, int offset) {
+    std::vector<std::string> words = split_search_words(keyword);
+    if (words.empty()) {
+        return {};
+    }
     
-    sqlite3_bind_int(stmt, 1, file_id);
+    if (trigram_searchable(words)) {
+        std::string match = build_match_query(words);
+        Statement stmt = read_statement(kSearchSql);
+        if (!stmt) {
+            return {};
+        }
+        sqlite3_bind_text(stmt, 1, match.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, viewer_id);
+        sqlite3_bind_int(stmt, 3, limit);
+        sqlite3_bind_int(stmt, 4, offset);
+        return read_file_rows(stmt);
+    }
     
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    // 按词数拼出的SQL最多kMaxSearchWords种，同样进入语句缓存
+    std::string sql = kSearchLikeSql;
+    std::vector<std::string> patterns;
+    for (const std::string& word : words) {
+        sql += kSearchLikeWordSql;
+        patterns.push_back(build_like_pattern(word));
+    }
+    sql += kSearchLikeOrderSql;
     
-    return rc == SQLITE_DONE;
+    Statement stmt = read_statement(sql);
+    if (!stmt) {
+        return {};
+    }
+    int index = 1;
+    sqlite3_bind_int(stmt, index++, viewer_id);
+    sqlite3_bind_int(stmt, index++, kMaxSearchScanRows);
+    for (const std::string& pattern : patterns) {
+        sqlite3_bind_text(stmt, index++, pattern.c_str(), -1, SQLITE_STATIC);
+    }
+    sqlite3_bind_int(stmt, index++, limit);
+    sqlite3_bind_int(stmt, index++, offset);
+    return read_file_rows(stmt);
+}
+
+bool Database::searchNeedsScan(const std::string& keyword) {
+    std::vector<std::string> words = split_search_words(keyword);
+    return !words.empty() && !trigram_searchable(words);
 }
 
 bool Database::create_user(const std::string& username, const std::string& password, const std::string& role) {
@@ -921,38 +1685,15 @@ int Database::getTotalFileCount() {
 
 
 bool Database::verify_password(const std::string& username, const std::string& password) {
-    // 获取用户的密码哈希
-    sqlite3_stmt* stmt;
-    std::string sql = "SELECT password_hash FROM users WHERE username = ? AND active = 1";
-    
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-        return false;
-    }
-    
-    sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
-    
-    bool result = false;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        const char* stored_hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        if (stored_hash) {
-            // 简单的密码验证：比较哈希值
-            std::string input_hash = hashPassword(password);
-            result = (input_hash == std::string(stored_hash));
-        }
-    }
-    
-    sqlite3_finalize(stmt);
-    return result;
+    return checkPassword(username, password) == PasswordCheck::Valid;
 }
 
 bool Database::addFile(const std::string& filename, const std::string& filepath, 
                        const std::string& file_type, long file_size, int uploader_id, 
                        const std::string& category, bool is_public) {
     const char* sql = "INSERT INTO files (filename, filepath, file_type, file_size, uploader_id, category, is_public) VALUES (?, ?, ?, ?, ?, ?, ?)";
-    sqlite3_stmt* stmt;
-    
-    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    Statement stmt = write_statement(sql);
+    if (!stmt) {
         return false;
     }
     
@@ -964,35 +1705,13 @@ bool Database::addFile(const std::string& filename, const std::string& filepath,
     sqlite3_bind_text(stmt, 6, category.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_int(stmt, 7, is_public ? 1 : 0);
     
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    int rc = sqlite3_step(stmt);
     
     return rc == SQLITE_DONE;
 }
 
 std::string Database::get_session_user(const std::string& session_id) {
-    const char* sql = "SELECT u.username FROM sessions s "
-                     "JOIN users u ON s.user_id = u.id "
-                     "WHERE s.session_id = ? AND s.expires_at > datetime('now')";
-    sqlite3_stmt* stmt;
-    
-    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        return "";
-    }
-    
-    sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_STATIC);
-    
-    std::string username;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        const char* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        if (name) {
-            username = name;
-        }
-    }
-    
-    sqlite3_finalize(stmt);
-    return username;
+    return get_session(session_id).username;
 }
 
 // 管理员获取所有文件（包含完整信息）
@@ -1002,44 +1721,10 @@ std::vector<FileInfo> Database::getAllFilesForAdmin() {
                      "LEFT JOIN users u ON f.uploader_id = u.id "
                      "ORDER BY f.upload_time DESC";
     
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    Statement stmt = read_statement(sql);
+    if (!stmt) {
         return {};
     }
     
-    std::vector<FileInfo> files;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        FileInfo file;
-        file.id = sqlite3_column_int(stmt, 0);
-        file.filename = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        file.filepath = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        file.file_type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        file.file_size = sqlite3_column_int64(stmt, 4);
-        file.uploader_id = sqlite3_column_int(stmt, 5);
-        file.upload_time = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-        file.category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-        file.download_count = sqlite3_column_int(stmt, 8);
-        file.is_public = sqlite3_column_int(stmt, 9) != 0;
-        file.is_shared = sqlite3_column_int(stmt, 10) != 0;
-        
-        // 处理可能为NULL的字段
-        const char* shared_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 11));
-        file.shared_at = shared_at ? shared_at : "";
-        
-        const char* description = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 12));
-        file.description = description ? description : "";
-        
-        const char* username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 13));
-        file.uploader = username ? username : ("User" + std::to_string(file.uploader_id));
-        
-        // 设置其他字段以确保兼容性
-        file.size = file.file_size;
-        file.mime_type = file.file_type;
-        
-        files.push_back(file);
-    }
-    
-    sqlite3_finalize(stmt);
-    return files;
+    return read_file_rows(stmt);
 } 
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "download_counter.h"
+
+DownloadCounter::DownloadCounter() : pending_(0), stopping_(false) {
+}
+
+DownloadCounter::~DownloadCounter() {
+    stop_flusher();
+}
+
+DownloadCounter::Shard& DownloadCounter::shard_for(int file_id) {
+    return shards_[static_cast<unsigned int>(file_id) % kShardCount];
+}
+
+void DownloadCounter::add(int file_id) {
+    Shard& shard = shard_for(file_id);
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.counts.find(file_id);
+        if (it != shard.counts.end()) {
+            it->second.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    // 该文件本周期第一次下载，加写锁插入计数器
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    shard.counts.try_emplace(file_id, 0).first->second.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<std::pair<int, uint64_t>> DownloadCounter::take() {
+    std::vector<std::pair<int, uint64_t>> result;
+    uint64_t total = 0;
+    for (Shard& shard : shards_) {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        for (auto it = shard.counts.begin(); it != shard.counts.end();) {
+            uint64_t count = it->second.exchange(0, std::memory_order_relaxed);
+            if (count == 0) {
+                it = shard.counts.erase(it);
+                continue;
+            }
+            result.emplace_back(it->first, count);
+            total += count;
+            ++it;
+        }
+    }
+    pending_.fetch_sub(total, std::memory_order_relaxed);
+    return result;
+}
+
+void DownloadCounter::restore(const std::vector<std::pair<int, uint64_t>>& counts) {
+    for (const auto& item : counts) {
+        Shard& shard = shard_for(item.first);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.counts.try_emplace(item.first, 0).first->second.fetch_add(item.second, std::memory_order_relaxed);
+        pending_.fetch_add(item.second, std::memory_order_relaxed);
+    }
+}
+
+void DownloadCounter::start_flusher(std::chrono::seconds interval, std::function<void()> on_flush) {
+    stop_flusher();
+    {
+        std::lock_guard<std::mutex> lock(flusher_mutex_);
+        stopping_ = false;
+    }
+    flusher_ = std::thread([this, interval, on_flush]() {
+        std::unique_lock<std::mutex> lock(flusher_mutex_);
+        while (!flusher_cond_.wait_for(lock, interval, [this]() { return stopping_; })) {
+            lock.unlock();
+            on_flush();
+            lock.lock();
+        }
+    });
+}
+
+void DownloadCounter::stop_flusher() {
+    {
+        std::lock_guard<std::mutex> lock(flusher_mutex_);
+        stopping_ = true;
+    }
+    flusher_cond_.notify_all();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+}
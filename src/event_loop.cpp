@@ -0,0 +1,586 @@
+#include "event_loop.h"
+#include "server.h"
+#include "http_parser.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+
+const int kMaxEvents = 256;
+const size_t kMaxHeaderSize = 64 * 1024;    // 请求头上限
+const size_t kReadChunk = 16 * 1024;
+const size_t kMaxBufferedBody = 16 * 1024 * 1024;  // 非流式请求体上限，超过返回413
+
+const size_t kMaxPipelineBuffer = 1024 * 1024;  // 请求处理或响应发送期间最多预读的流水线数据
+const int kSweepIntervalMs = 1000;               // 空闲连接检查周期
+const size_t kSendfileChunk = 4 * 1024 * 1024;   // 单次sendfile的最大字节数
+
+const char* kBadRequestResponse =
+    "HTTP/1.1 400 Bad Request\r\nContent-Length: 11\r\nConnection: close\r\n\r\nBad Request";
+const char* kPayloadTooLargeResponse =
+    "HTTP/1.1 413 Payload Too Large\r\nContent-Length: 17\r\nConnection: close\r\n\r\nPayload Too Large";
+
+} // namespace
+
+FileHandle::~FileHandle() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+EventLoop::EventLoop(HttpServer* server, int listen_fd)
+    : server_(server), listen_fd_(listen_fd), epoll_fd_(-1), wake_fd_(-1),
+      running_(false), connection_count_(0), next_conn_id_(1) {
+}
+
+EventLoop::~EventLoop() {
+    for (auto& entry : connections_) {
+        close(entry.first);
+    }
+    connections_.clear();
+
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+    }
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+    }
+}
+
+bool EventLoop::init() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        std::cerr << "创建epoll失败: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        std::cerr << "创建eventfd失败: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = listen_fd_;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev) == -1) {
+        std::cerr << "注册监听套接字失败: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = wake_fd_;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev) == -1) {
+        std::cerr << "注册eventfd失败: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    running_ = true;
+    return true;
+}
+
+void EventLoop::run() {
+    struct epoll_event events[kMaxEvents];
+
+    auto last_sweep = std::chrono::steady_clock::now();
+
+    while (running_) {
+        int n = epoll_wait(epoll_fd_, events, kMaxEvents, kSweepIntervalMs);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "epoll_wait失败: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            uint32_t mask = events[i].events;
+
+            if (fd == listen_fd_) {
+                handle_accept();
+                continue;
+            }
+
+            if (fd == wake_fd_) {
+                uint64_t value;
+                while (read(wake_fd_, &value, sizeof(value)) > 0) {
+                }
+                drain_completions();
+                continue;
+            }
+
+            auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            Connection& conn = *it->second;
+
+            if (mask & (EPOLLERR | EPOLLHUP)) {
+                close_connection(fd);
+                continue;
+            }
+
+            if (mask & EPOLLIN) {
+                handle_read(conn);
+                // handle_read可能已经关闭连接
+                if (connections_.find(fd) == connections_.end()) {
+                    continue;
+                }
+            }
+
+            if (mask & EPOLLOUT) {
+                handle_write(conn);
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_sweep >= std::chrono::milliseconds(kSweepIntervalMs)) {
+            sweep_idle(now);
+            last_sweep = now;
+        }
+    }
+}
+
+void EventLoop::stop() {
+    running_ = false;
+    if (wake_fd_ >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void EventLoop::post_response(int fd, uint64_t conn_id, std::vector<OutputChunk> output) {
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex_);
+        completions_.push_back(Completion{fd, conn_id, std::move(output)});
+    }
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+    (void)ignored;
+}
+
+void EventLoop::handle_accept() {
+    // 边缘触发：必须一直accept到EAGAIN
+    while (true) {
+        int client_fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK && running_) {
+                std::cerr << "接受连接失败: " << strerror(errno) << std::endl;
+            }
+            return;
+        }
+
+        int opt = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = client_fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client_fd, &ev) == -1) {
+            close(client_fd);
+            continue;
+        }
+
+        connections_[client_fd] = std::make_unique<Connection>(client_fd, next_conn_id_++);
+        connection_count_++;
+    }
+}
+
+void EventLoop::handle_read(Connection& conn) {
+    char buffer[kReadChunk];
+    conn.read_paused = false;
+    conn.last_active = std::chrono::steady_clock::now();
+
+    while (true) {
+        // 请求处理期间和响应发送期间只预读有限的流水线数据，剩余部分留在内核缓冲区，
+        // 响应写完后由handle_write继续读取；否则不读响应的客户端可以让读缓冲无限增长
+        if ((conn.processing || !conn.output.empty()) && conn.read_buffer.size() >= kMaxPipelineBuffer) {
+            conn.read_paused = true;
+            break;
+        }
+
+        ssize_t n = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            conn.read_buffer.append(buffer, n);
+            // 空闲连接上边读边处理，使上传请求体及时交给解析器落盘，读缓冲不随请求体增长
+            if (!conn.processing && conn.output.empty()) {
+                int fd = conn.fd;
+                try_dispatch(conn);
+                if (connections_.find(fd) == connections_.end()) {
+                    return;
+                }
+            }
+            continue;
+        }
+        if (n == 0) {
+            conn.peer_closed = true;
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            conn.peer_closed = true;
+        }
+        break;
+    }
+
+    if (conn.processing || !conn.output.empty()) {
+        return;
+    }
+
+    int fd = conn.fd;
+    try_dispatch(conn);
+    // try_dispatch写回错误响应时可能已经关闭连接
+    if (connections_.find(fd) == connections_.end()) {
+        return;
+    }
+
+    // 对端已关闭且没有待处理的请求时直接回收
+    if (conn.peer_closed && !conn.processing && conn.output.empty()) {
+        close_connection(fd);
+    }
+}
+
+void EventLoop::try_dispatch(Connection& conn) {
+    if (conn.receiving_body) {
+        receive_body(conn);
+        return;
+    }
+
+    if (conn.head_length == 0) {
+        ParsedRequest req;
+        HttpParser::Result result = HttpParser::parse_head(conn.read_buffer.data(), conn.read_buffer.size(),
+                                                           req, kMaxHeaderSize);
+        if (result == HttpParser::Result::Incomplete) {
+            return;
+        }
+        if (result == HttpParser::Result::Error) {
+            send_error(conn, kBadRequestResponse);
+            return;
+        }
+        conn.request_keep_alive = req.keep_alive;
+
+        bool has_body = req.chunked || req.content_length > 0;
+
+        // 上传路由的multipart请求体和chunked请求体需要边接收边处理
+        std::string boundary;
+        bool upload = has_body && server_->is_upload_route(req.method, req.path) &&
+                      MultipartParser::extract_boundary(std::string(req.header("Content-Type")), boundary);
+        if (!upload && !req.chunked && req.content_length > kMaxBufferedBody) {
+            send_error(conn, kPayloadTooLargeResponse);
+            return;
+        }
+
+        // 100 Continue只在请求确定会被接受时发送，不让客户端发出随后就被拒绝的请求体
+        if (has_body && req.header("Expect") == "100-continue") {
+            if (server_->route_saturated(req.method, req.path)) {
+                send_error(conn, server_->overload_response());
+                return;
+            }
+            send_continue(conn);
+        }
+
+        if (upload || req.chunked) {
+            begin_body(conn, req, upload ? &boundary : nullptr);
+            return;
+        }
+        conn.head_length = req.head_length;
+        conn.content_length = req.content_length;
+    }
+
+    size_t request_size = conn.head_length + conn.content_length;
+    if (conn.read_buffer.size() < request_size) {
+        return;  // 请求体尚未接收完整
+    }
+
+    std::string raw_request = conn.read_buffer.substr(0, request_size);
+    conn.read_buffer.erase(0, request_size);
+    conn.head_length = 0;
+    conn.content_length = 0;
+    start_request(conn, std::move(raw_request), {});
+}
+
+void EventLoop::begin_body(Connection& conn, const ParsedRequest& req, const std::string* boundary) {
+    // 路由名额已满时在接收请求体之前就拒绝，避免白白写盘
+    if (boundary != nullptr && server_->route_saturated(req.method, req.path)) {
+        send_error(conn, server_->overload_response());
+        return;
+    }
+
+    conn.receiving_body = true;
+    conn.body_remaining = req.content_length;
+    if (req.chunked) {
+        conn.chunked = std::make_unique<ChunkedDecoder>();
+    }
+    if (boundary != nullptr) {
+        conn.upload = std::make_unique<MultipartParser>(*boundary, server_->upload_temp_dir_);
+    }
+    // req中的视图指向read_buffer，移走请求头之后不能再使用
+    conn.request_head = conn.read_buffer.substr(0, req.head_length);
+    conn.read_buffer.erase(0, req.head_length);
+    receive_body(conn);
+}
+
+void EventLoop::receive_body(Connection& conn) {
+    bool complete;
+    if (conn.chunked) {
+        std::string decoded;
+        size_t consumed = 0;
+        if (!conn.chunked->feed(conn.read_buffer.data(), conn.read_buffer.size(), decoded, consumed)) {
+            fail_body(conn, kBadRequestResponse);
+            return;
+        }
+        conn.read_buffer.erase(0, consumed);
+
+        if (conn.upload) {
+            if (!decoded.empty() && !conn.upload->feed(decoded.data(), decoded.size())) {
+                fail_body(conn, kBadRequestResponse);
+                return;
+            }
+        } else {
+            if (conn.chunked_body.size() + decoded.size() > kMaxBufferedBody) {
+                fail_body(conn, kPayloadTooLargeResponse);
+                return;
+            }
+            conn.chunked_body += decoded;
+        }
+        complete = conn.chunked->done();
+    } else {
+        size_t n = std::min(conn.body_remaining, conn.read_buffer.size());
+        if (n > 0) {
+            if (!conn.upload->feed(conn.read_buffer.data(), n)) {
+                fail_body(conn, kBadRequestResponse);
+                return;
+            }
+            conn.read_buffer.erase(0, n);
+            conn.body_remaining -= n;
+        }
+        complete = conn.body_remaining == 0;
+    }
+    if (!complete) {
+        return;
+    }
+
+    std::vector<MultipartPart> parts;
+    if (conn.upload) {
+        if (!conn.upload->finished()) {
+            fail_body(conn, kBadRequestResponse);
+            return;
+        }
+        parts = conn.upload->take_parts();
+    }
+
+    // chunked请求体解码后接在请求头之后，工作线程按普通请求解析
+    std::string raw_request;
+    raw_request.swap(conn.request_head);
+    raw_request += conn.chunked_body;
+    reset_body(conn);
+    start_request(conn, std::move(raw_request), std::move(parts));
+}
+
+void EventLoop::reset_body(Connection& conn) {
+    conn.receiving_body = false;
+    conn.body_remaining = 0;
+    conn.chunked.reset();
+    conn.chunked_body.clear();
+    conn.upload.reset();  // 析构时删除未被取走的临时文件
+    conn.request_head.clear();
+}
+
+void EventLoop::fail_body(Connection& conn, std::string response) {
+    reset_body(conn);
+    send_error(conn, std::move(response));
+}
+
+void EventLoop::send_continue(Connection& conn) {
+    // 临时响应很短，套接字刚可读时发送缓冲区必然有空间；发送失败时客户端超时后也会继续发送请求体
+    static const char kContinue[] = "HTTP/1.1 100 Continue\r\n\r\n";
+    ssize_t ignored = send(conn.fd, kContinue, sizeof(kContinue) - 1, MSG_NOSIGNAL);
+    (void)ignored;
+}
+
+void EventLoop::start_request(Connection& conn, std::string raw_request, std::vector<MultipartPart> parts) {
+    conn.requests_served++;
+    bool keep_alive = conn.request_keep_alive &&
+                      conn.requests_served < server_->max_keep_alive_requests_ &&
+                      server_->running_;
+
+    conn.processing = true;
+    conn.close_after_write = !keep_alive;
+    if (!server_->dispatch(this, conn.fd, conn.id, std::move(raw_request), keep_alive, std::move(parts))) {
+        // 工作线程池已满，直接在事件循环中返回503并断开连接
+        conn.processing = false;
+        send_error(conn, server_->overload_response());
+    }
+}
+
+void EventLoop::send_error(Connection& conn, std::string response) {
+    conn.output.clear();
+    conn.output.emplace_back(std::move(response));
+    conn.output_offset = 0;
+    conn.last_progress = std::chrono::steady_clock::now();
+    conn.close_after_write = true;
+    handle_write(conn);
+}
+
+void EventLoop::handle_write(Connection& conn) {
+    if (conn.output.empty()) {
+        return;
+    }
+
+    while (!conn.output.empty()) {
+        OutputChunk& chunk = conn.output.front();
+        ssize_t n;
+
+        if (chunk.file) {
+            // 文件区间由内核直接从页缓存发送
+            if (chunk.length == 0) {
+                conn.output.pop_front();
+                continue;
+            }
+            n = sendfile(conn.fd, chunk.file->fd, &chunk.offset, std::min(chunk.length, kSendfileChunk));
+            if (n > 0) {
+                chunk.length -= n;
+                conn.last_progress = std::chrono::steady_clock::now();
+                continue;
+            }
+            if (n == 0) {
+                // 文件在发送过程中被截断，已声明的Content-Length无法满足，只能断开
+                close_connection(conn.fd);
+                return;
+            }
+        } else {
+            const char* data = chunk.data.data();
+            size_t size = chunk.data.size();
+            if (chunk.mapping) {
+                data = chunk.mapping->data() + chunk.offset;
+                size = chunk.length;
+            } else if (chunk.shared) {
+                data = chunk.shared->data() + chunk.offset;
+                size = chunk.length;
+            }
+            if (conn.output_offset >= size) {
+                conn.output.pop_front();
+                conn.output_offset = 0;
+                continue;
+            }
+            n = send(conn.fd, data + conn.output_offset, size - conn.output_offset, MSG_NOSIGNAL);
+            if (n > 0) {
+                conn.output_offset += n;
+                conn.last_progress = std::chrono::steady_clock::now();
+                continue;
+            }
+        }
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;  // 等待下一次EPOLLOUT
+        }
+        close_connection(conn.fd);
+        return;
+    }
+
+    conn.last_active = std::chrono::steady_clock::now();
+
+    if (conn.close_after_write) {
+        close_connection(conn.fd);
+        return;
+    }
+
+    // 继续处理同一连接上已到达的流水线请求
+    if (conn.read_paused) {
+        handle_read(conn);
+    } else {
+        handle_read_buffered(conn);
+    }
+}
+
+void EventLoop::handle_read_buffered(Connection& conn) {
+    int fd = conn.fd;
+    try_dispatch(conn);
+    if (connections_.find(fd) == connections_.end()) {
+        return;
+    }
+    if (conn.peer_closed && !conn.processing && conn.output.empty()) {
+        close_connection(fd);
+    }
+}
+
+void EventLoop::sweep_idle(std::chrono::steady_clock::time_point now) {
+    auto timeout = std::chrono::seconds(server_->keep_alive_timeout_);
+    auto send_timeout = std::chrono::seconds(server_->send_timeout_);
+    std::vector<int> expired;
+    for (const auto& entry : connections_) {
+        const Connection& conn = *entry.second;
+        if (conn.processing) {
+            continue;
+        }
+        // 空闲连接按保活超时回收；有待发送响应但客户端不再接收的连接按发送停滞超时回收，
+        // 否则请求大文件后不读取的客户端会一直占住连接、文件描述符和映射
+        bool idle = conn.output.empty() && now - conn.last_active > timeout;
+        bool stalled = !conn.output.empty() && now - conn.last_progress > send_timeout;
+        if (idle || stalled) {
+            expired.push_back(entry.first);
+        }
+    }
+    for (int fd : expired) {
+        close_connection(fd);
+    }
+}
+
+void EventLoop::drain_completions() {
+    std::vector<Completion> ready;
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex_);
+        ready.swap(completions_);
+    }
+
+    for (auto& completion : ready) {
+        auto it = connections_.find(completion.fd);
+        if (it == connections_.end() || it->second->id != completion.conn_id) {
+            continue;  // 连接已在处理期间关闭
+        }
+        Connection& conn = *it->second;
+        conn.processing = false;
+        conn.output.assign(std::make_move_iterator(completion.output.begin()),
+                           std::make_move_iterator(completion.output.end()));
+        conn.output_offset = 0;
+        conn.last_progress = std::chrono::steady_clock::now();
+        handle_write(conn);
+    }
+}
+
+void EventLoop::close_connection(int fd) {
+    auto it = connections_.find(fd);
+    if (it == connections_.end()) {
+        return;
+    }
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections_.erase(it);
+    connection_count_--;
+}
+
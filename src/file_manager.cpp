@@ -4,6 +4,11 @@
 #include <iostream>
 #include <algorithm>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <cstdio>
+#include <cerrno>
 #include <regex>
 #include <random>
 #include <iomanip>
@@ -11,8 +16,17 @@
 
 namespace fs = std::filesystem;
 
+namespace {
+
+const size_t kMappingBudget = 128 * 1024 * 1024;    // 映射缓存默认总预算
+const size_t kMappingMaxEntry = 8 * 1024 * 1024;    // 超过该大小的文件不进入映射缓存
+const size_t kLineIndexEntries = 64;                // 缓存行索引的文件数
+
+} // namespace
+
 FileManager::FileManager(const std::string& base_path) 
-    : base_path(base_path), max_file_size(50 * 1024 * 1024) {
+    : base_path(base_path), max_file_size(0), sync_policy_(SyncPolicy::None),
+      mapped_files_(kMappingBudget, kMappingMaxEntry), line_indexes_(kLineIndexEntries) {
     initialize_mime_types();
     initialize_allowed_types();
 }
@@ -31,56 +45,79 @@ bool FileManager::initialize() {
     return true;
 }
 
-bool FileManager::save_file(const std::string& filename, const std::string& content, const std::string& uploader) {
+bool FileManager::save_file(const std::string& filename, const std::string& content) {
     if (!is_allowed_type(filename) || !is_size_valid(content.size())) {
         return false;
     }
     
-    std::string safe_filename = sanitize_filename(filename);
-    std::string mime_type = get_mime_type(safe_filename);
-    std::string category = get_file_category(mime_type);
-    std::string category_path = get_category_path(category);
-    
-    // 确保目录存在
-    std::filesystem::create_directories(category_path);
-    
-    std::string full_path = category_path + "/" + safe_filename;
-    
-    // 检查文件是否已存在，如果存在则重命名
-    int counter = 1;
-    std::string final_path = full_path;
-    while (std::filesystem::exists(final_path)) {
-        size_t dot_pos = safe_filename.find_last_of('.');
-        std::string name = safe_filename.substr(0, dot_pos);
-        std::string ext = safe_filename.substr(dot_pos);
-        final_path = category_path + "/" + name + "_" + std::to_string(counter) + ext;
-        counter++;
-    }
-    
-    std::ofstream file(final_path, std::ios::binary);
-    if (!file.is_open()) {
+    // 先写临时文件再按内容哈希改名到对象目录：文件名由内容决定，不需要探测重名，
+    // 读者也不会看到写了一半的文件
+    std::string temp_path = base_path + "/.uploads/save_XXXXXX";
+    std::vector<char> tmpl(temp_path.begin(), temp_path.end());
+    tmpl.push_back('\0');
+    int fd = mkstemp(tmpl.data());
+    if (fd < 0) {
         return false;
     }
+    temp_path = tmpl.data();
+    
+    const char* data = content.data();
+    size_t remaining = content.size();
+    while (remaining > 0) {
+        ssize_t n = write(fd, data, remaining);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        data += n;
+        remaining -= n;
+    }
+    bool ok = close(fd) == 0 && remaining == 0;
+    
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int hash_len = 0;
+    ok = ok && EVP_Digest(content.data(), content.size(), hash, &hash_len, EVP_sha256(), nullptr) == 1;
+    std::ostringstream sha256;
+    for (unsigned int i = 0; i < hash_len; ++i) {
+        sha256 << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
+    }
     
-    file.write(content.c_str(), content.size());
-    file.close();
-    
-    return true;
+    ok = ok && sync_before_commit(temp_path) && store_blob(temp_path, sha256.str()) && sync_after_commit();
+    if (!ok) {
+        unlink(temp_path.c_str());
+    }
+    return ok;
 }
 
 std::string FileManager::read_file(const std::string& filepath) {
-    if (!is_safe_path(filepath) || !file_exists(filepath)) {
+    if (!is_safe_path(filepath)) {
         return "";
     }
     
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file.is_open()) {
+    std::shared_ptr<const MappedFile> mapped = map_file(filepath);
+    if (!mapped) {
         return "";
     }
-    
-    std::ostringstream content;
-    content << file.rdbuf();
-    return content.str();
+    return std::string(mapped->view());
+}
+
+std::shared_ptr<const MappedFile> FileManager::map_file(const std::string& filepath) {
+    return mapped_files_.get(filepath);
+}
+
+void FileManager::forget_mapping(const std::string& filepath) {
+    mapped_files_.invalidate(filepath);
+    line_indexes_.invalidate(filepath);
+}
+
+std::shared_ptr<const LineIndex> FileManager::line_index(const std::string& filepath) {
+    return line_indexes_.get(filepath, [this](const std::string& path) { return map_file(path); });
+}
+
+std::shared_ptr<const LineIndex> FileManager::cached_line_index(const std::string& filepath) {
+    return line_indexes_.peek(filepath);
 }
 
 bool FileManager::file_exists(const std::string& filepath) {
@@ -149,16 +186,16 @@ bool FileManager::is_allowed_type(const std::string& filename) {
 }
 
 bool FileManager::is_size_valid(size_t size) {
-    return size <= max_file_size;
+    // 0表示不限制，上传大小只受用户存储配额约束
+    return max_file_size <= 0 || size <= static_cast<size_t>(max_file_size);
 }
 
 bool FileManager::create_directories() {
     try {
+        // 新文件都存放在objects下的两级散列目录中；分类目录只剩下旧版本上传的文件，不再创建
         std::filesystem::create_directories(base_path);
-        std::filesystem::create_directories(base_path + "/videos");
-        std::filesystem::create_directories(base_path + "/images");
-        std::filesystem::create_directories(base_path + "/documents");
-        std::filesystem::create_directories(base_path + "/others");
+        std::filesystem::create_directories(base_path + "/objects");
+        std::filesystem::create_directories(base_path + "/.uploads");
         return true;
     } catch (const std::exception& e) {
         std::cerr << "创建目录失败: " << e.what() << std::endl;
@@ -170,6 +207,79 @@ std::string FileManager::get_category_path(const std::string& category) {
     return base_path + "/" + category;
 }
 
+std::string FileManager::blob_path(const std::string& sha256) const {
+    // 两级256路分散目录，单个目录中的文件数保持在较小规模
+    return base_path + "/objects/" + sha256.substr(0, 2) + "/" + sha256.substr(2, 2) + "/" + sha256;
+}
+
+bool FileManager::store_blob(const std::string& temp_path, const std::string& sha256) {
+    std::string path = blob_path(sha256);
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+        // 已有相同内容，上传的副本不再需要
+        unlink(temp_path.c_str());
+        return true;
+    }
+    
+    std::error_code ec;
+    std::filesystem::create_directories(fs::path(path).parent_path(), ec);
+    if (ec) {
+        std::cerr << "创建对象目录失败: " << ec.message() << std::endl;
+        return false;
+    }
+    // 临时文件与对象目录位于同一文件系统，改名即可，无需复制内容
+    if (rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "保存文件内容失败: " << path << std::endl;
+        return false;
+    }
+    
+    // 改名只修改目录项，目录本身也要同步，掉电后新文件才不会消失
+    if (sync_policy_ == SyncPolicy::PerFile) {
+        std::string dir = fs::path(path).parent_path().string();
+        int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        bool synced = dir_fd >= 0 && fsync(dir_fd) == 0;
+        if (dir_fd >= 0) {
+            close(dir_fd);
+        }
+        if (!synced) {
+            std::cerr << "同步对象目录失败: " << dir << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FileManager::sync_before_commit(const std::string& temp_path) {
+    if (sync_policy_ != SyncPolicy::PerFile) {
+        return true;
+    }
+    int fd = open(temp_path.c_str(), O_RDONLY | O_CLOEXEC);
+    bool synced = fd >= 0 && fdatasync(fd) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!synced) {
+        std::cerr << "文件落盘失败: " << temp_path << std::endl;
+    }
+    return synced;
+}
+
+bool FileManager::sync_after_commit() {
+    if (sync_policy_ != SyncPolicy::Batched) {
+        return true;
+    }
+    return sync_batcher_.wait();
+}
+
+void FileManager::setSyncPolicy(SyncPolicy policy, std::chrono::milliseconds batch_window) {
+    sync_batcher_.stop();
+    if (policy == SyncPolicy::Batched && !sync_batcher_.start(base_path, batch_window)) {
+        std::cerr << "组提交线程启动失败，改为逐个文件同步" << std::endl;
+        policy = SyncPolicy::PerFile;
+    }
+    sync_policy_ = policy;
+}
+
 void FileManager::initialize_mime_types() {
     // 视频类型
     mime_types["mp4"] = "video/mp4";
@@ -207,6 +317,26 @@ void FileManager::initialize_mime_types() {
     mime_types["flac"] = "audio/flac";
 }
 
+std::set<std::string> FileManager::get_compressed_mime_types() const {
+    // wav、bmp、文本和旧版Office文档压缩效果好，不在此列
+    static const char* compressed_exts[] = {
+        "mp4", "avi", "mkv", "mov", "wmv", "flv",
+        "jpg", "jpeg", "png", "gif", "webp",
+        "pdf", "docx", "xlsx",
+        "zip", "rar", "7z",
+        "mp3", "flac"
+    };
+    
+    std::set<std::string> result;
+    for (const char* ext : compressed_exts) {
+        auto it = mime_types.find(ext);
+        if (it != mime_types.end()) {
+            result.insert(it->second);
+        }
+    }
+    return result;
+}
+
 void FileManager::initialize_allowed_types() {
     allowed_types = {
         // 视频
@@ -297,14 +427,11 @@ std::string FileManager::read_text_file(const std::string& filepath) {
         return "";
     }
     
-    std::ifstream file(full_path);
-    if (!file.is_open()) {
+    std::shared_ptr<const MappedFile> mapped = map_file(full_path);
+    if (!mapped) {
         return "";
     }
-    
-    std::ostringstream oss;
-    oss << file.rdbuf();
-    return oss.str();
+    return std::string(mapped->view());
 }
 
 std::string FileManager::format_file_size(long size) {
@@ -323,13 +450,19 @@ std::string FileManager::format_file_size(long size) {
 }
 
 std::vector<std::string> FileManager::list_files(const std::string& directory) {
-    // 简单实现，实际项目中可能需要更复杂的目录遍历
+    // 只列出目录下的普通文件名，不递归；目录不存在或无法读取时返回空列表
     std::vector<std::string> files;
+    std::error_code ec;
+    for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->is_regular_file(ec)) {
+            files.push_back(it->path().filename().string());
+        }
+    }
     return files;
 }
 
 bool FileManager::create_directory(const std::string& path) {
-    struct stat st = {0};
+    struct stat st{};
     
     if (stat(path.c_str(), &st) == -1) {
         return mkdir(path.c_str(), 0755) == 0;
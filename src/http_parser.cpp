@@ -0,0 +1,420 @@
+#include "http_parser.h"
+#include <cstring>
+#include <strings.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTP_PARSER_X86 1
+#endif
+
+namespace {
+
+const size_t kNotFound = static_cast<size_t>(-1);
+const size_t kMaxChunkLine = 4096;
+const size_t kMaxChunkSize = static_cast<size_t>(1) << 40;
+
+// 控制字符（制表符除外）：行结束符CR/LF也在其中，请求头中的其他控制字符都是非法的
+inline bool is_ctl(unsigned char c) {
+    return (c < 0x20 && c != '\t') || c == 0x7f;
+}
+
+size_t find_ctl_scalar(const char* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        if (is_ctl(static_cast<unsigned char>(data[i]))) {
+            return i;
+        }
+    }
+    return kNotFound;
+}
+
+#ifdef HTTP_PARSER_X86
+
+__attribute__((target("avx2")))
+size_t find_ctl_avx2(const char* data, size_t len) {
+    const __m256i limit = _mm256_set1_epi8(0x1f);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        // min(v, 0x1f) == v 即 v <= 0x1f（无符号比较）
+        __m256i low = _mm256_cmpeq_epi8(_mm256_min_epu8(v, limit), v);
+        low = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab), low);
+        __m256i ctl = _mm256_or_si256(low, _mm256_cmpeq_epi8(v, del));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(ctl));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    size_t rest = find_ctl_scalar(data + i, len - i);
+    return rest == kNotFound ? kNotFound : i + rest;
+}
+
+__attribute__((target("sse4.2")))
+size_t find_ctl_sse42(const char* data, size_t len) {
+    // 字节区间：0x00-0x08、0x0a-0x1f、0x7f
+    static const char ranges[16] = "\x00\x08\x0a\x1f\x7f\x7f";
+    const __m128i ranges_vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ranges));
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int index = _mm_cmpestri(ranges_vec, 6, v, 16,
+                                 _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+        if (index != 16) {
+            return i + index;
+        }
+    }
+    size_t rest = find_ctl_scalar(data + i, len - i);
+    return rest == kNotFound ? kNotFound : i + rest;
+}
+
+#endif
+
+using FindCtlFn = size_t (*)(const char*, size_t);
+
+struct ScanImpl {
+    FindCtlFn find_ctl;
+    const char* name;
+};
+
+// 启动时按CPU能力选择一次
+const ScanImpl& scan_impl() {
+    static const ScanImpl impl = []() -> ScanImpl {
+#ifdef HTTP_PARSER_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return {find_ctl_avx2, "avx2"};
+        }
+        if (__builtin_cpu_supports("sse4.2")) {
+            return {find_ctl_sse42, "sse4.2"};
+        }
+#endif
+        return {find_ctl_scalar, "scalar"};
+    }();
+    return impl;
+}
+
+// 查找从pos开始的行结束位置（指向CR），遇到非法控制字符或裸LF时返回错误
+HttpParser::Result find_line_end(const char* data, size_t len, size_t pos, size_t& line_end) {
+    size_t offset = scan_impl().find_ctl(data + pos, len - pos);
+    if (offset == kNotFound) {
+        return HttpParser::Result::Incomplete;
+    }
+    line_end = pos + offset;
+    if (data[line_end] != '\r') {
+        return HttpParser::Result::Error;
+    }
+    if (line_end + 1 >= len) {
+        return HttpParser::Result::Incomplete;
+    }
+    return data[line_end + 1] == '\n' ? HttpParser::Result::Complete : HttpParser::Result::Error;
+}
+
+// RFC 7230 token字符
+inline bool is_token_char(unsigned char c) {
+    static const bool table[256] = {
+        // 0x00-0x1f
+        0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,
+        //  ! " # $ % & ' ( ) * + , - . /
+        0,1,0,1,1,1,1,1, 0,0,1,1,0,1,1,0,
+        // 0-9 : ; < = > ?
+        1,1,1,1,1,1,1,1, 1,1,0,0,0,0,0,0,
+        // @ A-O
+        0,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,
+        // P-Z [ \ ] ^ _
+        1,1,1,1,1,1,1,1, 1,1,1,0,0,0,1,1,
+        // ` a-o
+        1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,
+        // p-z { | } ~ DEL
+        1,1,1,1,1,1,1,1, 1,1,1,0,1,0,1,0,
+    };
+    return table[c];
+}
+
+inline bool equals_ignore_case(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+inline std::string_view trim_ows(std::string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+// 逗号分隔的列表中是否含有指定token（不区分大小写）
+bool list_contains(std::string_view list, std::string_view token) {
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view item = trim_ows(list.substr(0, comma));
+        if (equals_ignore_case(item, token)) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        list.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+bool parse_decimal(std::string_view value, size_t& result) {
+    if (value.empty() || value.size() > 18) {
+        return false;
+    }
+    result = 0;
+    for (char c : value) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        result = result * 10 + static_cast<size_t>(c - '0');
+    }
+    return true;
+}
+
+bool parse_request_line(std::string_view line, ParsedRequest& req) {
+    size_t method_end = 0;
+    while (method_end < line.size() && is_token_char(static_cast<unsigned char>(line[method_end]))) {
+        ++method_end;
+    }
+    if (method_end == 0 || method_end >= line.size() || line[method_end] != ' ') {
+        return false;
+    }
+    req.method = line.substr(0, method_end);
+
+    size_t target_end = line.find(' ', method_end + 1);
+    if (target_end == std::string_view::npos || target_end == method_end + 1) {
+        return false;
+    }
+    req.target = line.substr(method_end + 1, target_end - method_end - 1);
+    req.version = line.substr(target_end + 1);
+    if (req.version.size() != 8 || req.version.compare(0, 7, "HTTP/1.") != 0 ||
+        (req.version[7] != '0' && req.version[7] != '1')) {
+        return false;
+    }
+
+    size_t query_pos = req.target.find('?');
+    if (query_pos == std::string_view::npos) {
+        req.path = req.target;
+        req.query = std::string_view();
+    } else {
+        req.path = req.target.substr(0, query_pos);
+        req.query = req.target.substr(query_pos + 1);
+    }
+    return true;
+}
+
+} // namespace
+
+std::string_view ParsedRequest::header(std::string_view name) const {
+    for (size_t i = 0; i < header_count; ++i) {
+        if (equals_ignore_case(headers[i].name, name)) {
+            return headers[i].value;
+        }
+    }
+    return std::string_view();
+}
+
+bool ParsedRequest::has_header(std::string_view name) const {
+    for (size_t i = 0; i < header_count; ++i) {
+        if (equals_ignore_case(headers[i].name, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* HttpParser::simd_level() {
+    return scan_impl().name;
+}
+
+HttpParser::Result HttpParser::parse_head(const char* data, size_t len, ParsedRequest& req,
+                                          size_t max_head_length) {
+    req.header_count = 0;
+    req.has_content_length = false;
+    req.content_length = 0;
+    req.chunked = false;
+
+    size_t scan_len = len < max_head_length ? len : max_head_length;
+    size_t pos = 0;
+
+    // 容忍请求之间多余的空行（RFC 7230 3.5）
+    while (pos + 1 < scan_len && data[pos] == '\r' && data[pos + 1] == '\n') {
+        pos += 2;
+    }
+
+    size_t line_end;
+    Result result = find_line_end(data, scan_len, pos, line_end);
+    if (result != Result::Complete) {
+        return result == Result::Incomplete && len >= max_head_length ? Result::Error : result;
+    }
+    if (!parse_request_line(std::string_view(data + pos, line_end - pos), req)) {
+        return Result::Error;
+    }
+    pos = line_end + 2;
+
+    bool close = false;
+    bool keep_alive = false;
+
+    while (true) {
+        result = find_line_end(data, scan_len, pos, line_end);
+        if (result != Result::Complete) {
+            return result == Result::Incomplete && len >= max_head_length ? Result::Error : result;
+        }
+        if (line_end == pos) {
+            pos += 2;  // 空行，请求头结束
+            break;
+        }
+
+        // 字段名：token字符直到冒号，不允许前导空白（obs-fold）或冒号前空白
+        size_t name_end = pos;
+        while (name_end < line_end && is_token_char(static_cast<unsigned char>(data[name_end]))) {
+            ++name_end;
+        }
+        if (name_end == pos || name_end >= line_end || data[name_end] != ':') {
+            return Result::Error;
+        }
+        if (req.header_count >= ParsedRequest::kMaxHeaders) {
+            return Result::Error;
+        }
+
+        HeaderField& field = req.headers[req.header_count++];
+        field.name = std::string_view(data + pos, name_end - pos);
+        field.value = trim_ows(std::string_view(data + name_end + 1, line_end - name_end - 1));
+
+        // 解析影响消息边界和连接管理的字段
+        if (equals_ignore_case(field.name, "Content-Length")) {
+            size_t length;
+            if (!parse_decimal(field.value, length) ||
+                (req.has_content_length && length != req.content_length)) {
+                return Result::Error;
+            }
+            req.content_length = length;
+            req.has_content_length = true;
+        } else if (equals_ignore_case(field.name, "Transfer-Encoding")) {
+            // 只支持chunked作为唯一的传输编码
+            if (!equals_ignore_case(trim_ows(field.value), "chunked") || req.chunked) {
+                return Result::Error;
+            }
+            req.chunked = true;
+        } else if (equals_ignore_case(field.name, "Connection")) {
+            close = close || list_contains(field.value, "close");
+            keep_alive = keep_alive || list_contains(field.value, "keep-alive");
+        }
+
+        pos = line_end + 2;
+    }
+
+    // 同时带Content-Length和chunked的请求可用于请求走私，直接拒绝
+    if (req.chunked && req.has_content_length) {
+        return Result::Error;
+    }
+
+    bool http11 = req.version[7] == '1';
+    req.keep_alive = !close && (http11 || keep_alive);
+    req.head_length = pos;
+    return Result::Complete;
+}
+
+bool ChunkedDecoder::feed(const char* data, size_t len, std::string& out, size_t& consumed) {
+    size_t pos = 0;
+    while (pos < len && state_ != State::Done) {
+        char c = data[pos];
+        switch (state_) {
+            case State::Size: {
+                int digit;
+                if (c >= '0' && c <= '9') {
+                    digit = c - '0';
+                } else if (c >= 'a' && c <= 'f') {
+                    digit = c - 'a' + 10;
+                } else if (c >= 'A' && c <= 'F') {
+                    digit = c - 'A' + 10;
+                } else if (size_seen_ && (c == ';' || c == ' ' || c == '\t')) {
+                    state_ = State::Extension;
+                    ++pos;
+                    break;
+                } else if (size_seen_ && c == '\r') {
+                    state_ = State::SizeLF;
+                    ++pos;
+                    break;
+                } else {
+                    return false;
+                }
+                chunk_remaining_ = chunk_remaining_ * 16 + static_cast<size_t>(digit);
+                if (chunk_remaining_ > kMaxChunkSize) {
+                    return false;
+                }
+                size_seen_ = true;
+                ++pos;
+                break;
+            }
+
+            case State::Extension:
+                if (c == '\r') {
+                    state_ = State::SizeLF;
+                } else if (++line_length_ > kMaxChunkLine) {
+                    return false;
+                }
+                ++pos;
+                break;
+
+            case State::SizeLF:
+                if (c != '\n') {
+                    return false;
+                }
+                ++pos;
+                line_length_ = 0;
+                state_ = chunk_remaining_ == 0 ? State::Trailer : State::Data;
+                break;
+
+            case State::Data: {
+                size_t n = len - pos < chunk_remaining_ ? len - pos : chunk_remaining_;
+                out.append(data + pos, n);
+                pos += n;
+                chunk_remaining_ -= n;
+                if (chunk_remaining_ == 0) {
+                    state_ = State::DataCR;
+                }
+                break;
+            }
+
+            case State::DataCR:
+                if (c != '\r') {
+                    return false;
+                }
+                state_ = State::DataLF;
+                ++pos;
+                break;
+
+            case State::DataLF:
+                if (c != '\n') {
+                    return false;
+                }
+                state_ = State::Size;
+                size_seen_ = false;
+                ++pos;
+                break;
+
+            case State::Trailer:
+                // trailer字段直接丢弃，遇到空行结束
+                if (c == '\n') {
+                    if (line_length_ == 0) {
+                        state_ = State::Done;
+                    }
+                    line_length_ = 0;
+                } else if (c != '\r' && ++line_length_ > kMaxChunkLine) {
+                    return false;
+                }
+                ++pos;
+                break;
+
+            case State::Done:
+                break;
+        }
+    }
+    consumed = pos;
+    return true;
+}
@@ -3,6 +3,37 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <charconv>
+
+namespace {
+
+void append_number(std::string& out, long long value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr - buf);
+}
+
+// FileInfo的字段视图，使serialize_file与流式列表共用append_file
+FileRow file_row_view(const FileInfo& file) {
+    FileRow row;
+    row.id = file.id;
+    row.uploader_id = file.uploader_id;
+    row.download_count = file.download_count;
+    row.is_public = file.is_public;
+    row.is_shared = file.is_shared;
+    row.file_size = file.file_size;
+    row.filename = file.filename;
+    row.filepath = file.filepath;
+    row.file_type = file.file_type;
+    row.uploader = file.uploader;
+    row.upload_time = file.upload_time;
+    row.category = file.category;
+    row.shared_at = file.shared_at;
+    row.description = file.description;
+    return row;
+}
+
+} // namespace
 
 // JsonValue 实现
 JsonValue::JsonValue() : type(JsonType::Null) {}
@@ -124,6 +155,12 @@ std::string JsonHelper::data_response(const std::string& data, const std::string
     return "{\"success\":true,\"message\":\"" + escape_json_string(message) + "\",\"data\":" + data + "}";
 }
 
+std::string JsonHelper::cursor_response(const std::string& data, const std::string& message, const std::string& next_cursor) {
+    std::string cursor_json = next_cursor.empty() ? "null" : "\"" + escape_json_string(next_cursor) + "\"";
+    return "{\"success\":true,\"message\":\"" + escape_json_string(message) + "\",\"data\":" + data +
+           ",\"next_cursor\":" + cursor_json + "}";
+}
+
 std::string JsonHelper::serialize_user(const User& user) {
     std::ostringstream oss;
     oss << "{\"id\":" << user.id
@@ -135,21 +172,42 @@ std::string JsonHelper::serialize_user(const User& user) {
 }
 
 std::string JsonHelper::serialize_file(const FileInfo& file) {
-    std::ostringstream oss;
-    oss << "{\"id\":" << file.id
-        << ",\"filename\":\"" << escape_json_string(file.filename) << "\""
-        << ",\"filepath\":\"" << escape_json_string(file.filepath) << "\""
-        << ",\"mime_type\":\"" << escape_json_string(file.mime_type) << "\""
-        << ",\"size\":" << file.size
-        << ",\"uploader\":\"" << escape_json_string(file.uploader) << "\""
-        << ",\"upload_time\":\"" << escape_json_string(file.upload_time) << "\""
-        << ",\"category\":\"" << escape_json_string(file.category) << "\""
-        << ",\"download_count\":" << file.download_count
-        << ",\"is_public\":" << (file.is_public ? "true" : "false")
-        << ",\"is_shared\":" << (file.is_shared ? "true" : "false")
-        << ",\"shared_at\":\"" << escape_json_string(file.shared_at) << "\""
-        << ",\"description\":\"" << escape_json_string(file.description) << "\"}";
-    return oss.str();
+    std::string out;
+    append_file(out, file_row_view(file));
+    return out;
+}
+
+void JsonHelper::append_file(std::string& out, const FileRow& row) {
+    out += "{\"id\":";
+    append_number(out, row.id);
+    out += ",\"filename\":\"";
+    append_escaped(out, row.filename);
+    out += "\",\"filepath\":\"";
+    append_escaped(out, row.filepath);
+    out += "\",\"mime_type\":\"";
+    append_escaped(out, row.file_type);
+    out += "\",\"size\":";
+    append_number(out, row.file_size);
+    out += ",\"uploader\":\"";
+    if (row.uploader.empty()) {
+        out += "User ";
+        append_number(out, row.uploader_id);
+    } else {
+        append_escaped(out, row.uploader);
+    }
+    out += "\",\"upload_time\":\"";
+    append_escaped(out, row.upload_time);
+    out += "\",\"category\":\"";
+    append_escaped(out, row.category);
+    out += "\",\"download_count\":";
+    append_number(out, row.download_count);
+    out += row.is_public ? ",\"is_public\":true" : ",\"is_public\":false";
+    out += row.is_shared ? ",\"is_shared\":true" : ",\"is_shared\":false";
+    out += ",\"shared_at\":\"";
+    append_escaped(out, row.shared_at);
+    out += "\",\"description\":\"";
+    append_escaped(out, row.description);
+    out += "\"}";
 }
 
 std::string JsonHelper::serialize_session(const Session& session) {
@@ -173,23 +231,30 @@ std::string JsonHelper::serialize_users(const std::vector<User>& users) {
 }
 
 std::string JsonHelper::serialize_files(const std::vector<FileInfo>& files) {
-    std::ostringstream oss;
-    oss << "[";
+    std::string out = "[";
     for (size_t i = 0; i < files.size(); ++i) {
-        if (i > 0) oss << ",";
-        oss << serialize_file(files[i]);
+        if (i > 0) out += ',';
+        append_file(out, file_row_view(files[i]));
     }
-    oss << "]";
-    return oss.str();
+    out += ']';
+    return out;
 }
 
-std::string JsonHelper::paginated_response(const std::string& data, int total, int page, int limit) {
+std::string JsonHelper::paginated_response(const std::string& data, int total, int page, int limit,
+                                           const std::string& next_cursor) {
     std::ostringstream oss;
     oss << "{\"success\":true,\"data\":" << data
         << ",\"pagination\":{\"total\":" << total
         << ",\"page\":" << page
         << ",\"limit\":" << limit
-        << ",\"pages\":" << ((total + limit - 1) / limit) << "}}";
+        << ",\"pages\":" << ((total + limit - 1) / limit)
+        << ",\"next_cursor\":";
+    if (next_cursor.empty()) {
+        oss << "null";
+    } else {
+        oss << "\"" << escape_json_string(next_cursor) << "\"";
+    }
+    oss << "}}";
     return oss.str();
 }
 
@@ -219,34 +284,39 @@ std::string JsonHelper::serialize_processes(const std::vector<std::map<std::stri
 
 std::string JsonHelper::escape_json_string(const std::string& str) {
     std::string result;
-    for (size_t i = 0; i < str.length(); ++i) {
+    result.reserve(str.size());
+    append_escaped(result, str);
+    return result;
+}
+
+void JsonHelper::append_escaped(std::string& out, std::string_view str) {
+    // 不需要转义的连续字符整段追加
+    size_t run = 0;
+    for (size_t i = 0; i < str.size(); ++i) {
         unsigned char c = static_cast<unsigned char>(str[i]);
-        
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.append(str.data() + run, i - run);
+        run = i + 1;
         switch (c) {
-            case '"': result += "\\\""; break;
-            case '\\': result += "\\\\"; break;
-            case '\b': result += "\\b"; break;
-            case '\f': result += "\\f"; break;
-            case '\n': result += "\\n"; break;
-            case '\r': result += "\\r"; break;
-            case '\t': result += "\\t"; break;
-            default:
-                if (c < 0x20) {
-                    // 转义控制字符
-                    std::ostringstream oss;
-                    oss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<unsigned int>(c);
-                    result += oss.str();
-                } else if (c >= 0x80) {
-                    // UTF-8多字节字符，直接保留
-                    result += c;
-                } else {
-                    // 普通ASCII字符
-                    result += c;
-                }
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default: {
+                static const char hex[] = "0123456789abcdef";
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xF];
                 break;
+            }
         }
     }
-    return result;
+    out.append(str.data() + run, str.size() - run);
 }
 
 std::map<std::string, std::string> JsonHelper::parse_form_data(const std::string& data) {
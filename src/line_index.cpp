@@ -0,0 +1,314 @@
+#include "line_index.h"
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LINE_INDEX_X86 1
+#endif
+
+namespace {
+
+const size_t kCountOnly = static_cast<size_t>(-1);
+
+// 换行符扫描：统计data[0, len)中的换行符，每数到第need个时记录其后一个字节的偏移作为行首，
+// 之后need重置为kStride；need为kCountOnly时只计数
+using ScanFn = size_t (*)(const char* data, size_t len, size_t& need, std::vector<uint64_t>& checkpoints);
+
+size_t scan_scalar_from(const char* data, size_t start, size_t len, size_t& need,
+                        std::vector<uint64_t>& checkpoints) {
+    size_t count = 0;
+    const char* p = data + start;
+    const char* end = data + len;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (nl == nullptr) {
+            break;
+        }
+        ++count;
+        p = nl + 1;
+        if (need != kCountOnly && --need == 0) {
+            checkpoints.push_back(p - data);
+            need = LineIndex::kStride;
+        }
+    }
+    return count;
+}
+
+size_t scan_scalar(const char* data, size_t len, size_t& need, std::vector<uint64_t>& checkpoints) {
+    return scan_scalar_from(data, 0, len, need, checkpoints);
+}
+
+#ifdef LINE_INDEX_X86
+
+// 处理一个64字节块的换行符位掩码：块内不会数到下一个记录点时只做一次popcount，否则逐位定位
+__attribute__((always_inline)) inline
+void take_mask(uint64_t mask, size_t base, size_t& count, size_t& need, std::vector<uint64_t>& checkpoints) {
+    size_t n = __builtin_popcountll(mask);
+    count += n;
+    if (n < need) {
+        if (need != kCountOnly) {
+            need -= n;
+        }
+        return;
+    }
+    while (mask != 0) {
+        size_t bit = __builtin_ctzll(mask);
+        mask &= mask - 1;
+        if (--need == 0) {
+            checkpoints.push_back(base + bit + 1);
+            need = LineIndex::kStride;
+        }
+    }
+}
+
+__attribute__((target("avx2,popcnt")))
+size_t scan_avx2(const char* data, size_t len, size_t& need, std::vector<uint64_t>& checkpoints) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+        uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, newline))) |
+            static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, newline)))) << 32;
+        if (mask != 0) {
+            take_mask(mask, i, count, need, checkpoints);
+        }
+    }
+    return count + scan_scalar_from(data, i, len, need, checkpoints);
+}
+
+#ifdef __SSE2__
+// SSE2是x86-64的基本指令集，不需要运行时检测
+size_t scan_sse2(const char* data, size_t len, size_t& need, std::vector<uint64_t>& checkpoints) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        uint64_t mask = 0;
+        for (int part = 0; part < 4; ++part) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + part * 16));
+            uint64_t bits = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+            mask |= bits << (part * 16);
+        }
+        if (mask != 0) {
+            take_mask(mask, i, count, need, checkpoints);
+        }
+    }
+    return count + scan_scalar_from(data, i, len, need, checkpoints);
+}
+#endif
+
+#endif
+
+struct ScanImpl {
+    ScanFn scan;
+    const char* name;
+};
+
+// 启动时按CPU能力选择一次
+const ScanImpl& scan_impl() {
+    static const ScanImpl impl = []() -> ScanImpl {
+#ifdef LINE_INDEX_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+            return {scan_avx2, "avx2"};
+        }
+#ifdef __SSE2__
+        return {scan_sse2, "sse2"};
+#endif
+#endif
+        return {scan_scalar, "scalar"};
+    }();
+    return impl;
+}
+
+inline bool is_continuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// pos向前退到UTF-8字符的起始字节；回退超过3字节仍是后续字节说明不是合法UTF-8，保持原位置
+size_t utf8_floor(const char* data, size_t size, size_t pos) {
+    if (pos >= size) {
+        return size;
+    }
+    size_t p = pos;
+    for (int i = 0; i < 3 && p > 0 && is_continuation(data[p]); ++i) {
+        --p;
+    }
+    return is_continuation(data[p]) ? pos : p;
+}
+
+// pos向后进到UTF-8字符的起始字节
+size_t utf8_ceil(const char* data, size_t size, size_t pos) {
+    size_t p = pos;
+    for (int i = 0; i < 3 && p < size && is_continuation(data[p]); ++i) {
+        ++p;
+    }
+    return p < size && is_continuation(data[p]) ? pos : p;
+}
+
+} // namespace
+
+std::shared_ptr<const LineIndex> LineIndex::build(std::shared_ptr<const MappedFile> file) {
+    std::shared_ptr<LineIndex> index(new LineIndex());
+    const char* data = file->data();
+    size_t size = file->size();
+
+    index->checkpoints_.push_back(0);
+    size_t need = kStride;
+    size_t newlines = size > 0 ? scan_impl().scan(data, size, need, index->checkpoints_) : 0;
+    index->line_count_ = newlines + (size > 0 && data[size - 1] != '\n' ? 1 : 0);
+    index->checkpoints_.shrink_to_fit();
+    index->file_ = std::move(file);
+    return index;
+}
+
+size_t LineIndex::line_offset(size_t line) const {
+    if (line >= line_count_) {
+        return file_->size();
+    }
+    const char* data = file_->data();
+    size_t size = file_->size();
+    size_t pos = checkpoints_[line / kStride];
+    for (size_t skip = line % kStride; skip > 0; --skip) {
+        // line小于行数，之前的每一行都以换行符结尾
+        const char* nl = static_cast<const char*>(memchr(data + pos, '\n', size - pos));
+        pos = nl - data + 1;
+    }
+    return pos;
+}
+
+TextPage LineIndex::page_by_lines(size_t first_line, size_t max_lines, size_t max_bytes) const {
+    TextPage page;
+    page.first_line = std::min(first_line, line_count_);
+    page.begin = line_offset(page.first_line);
+    size_t last_line = page.first_line + std::min(max_lines, line_count_ - page.first_line);
+    size_t end = line_offset(last_line);
+
+    page.whole_lines = true;
+    if (end - page.begin <= max_bytes) {
+        page.end = end;
+        page.next_line = last_line;
+        return page;
+    }
+
+    // 超出字节上限：在上限之前的最后一个换行符处结束
+    const char* data = file_->data();
+    const void* nl = memrchr(data + page.begin, '\n', max_bytes);
+    if (nl != nullptr) {
+        page.end = static_cast<const char*>(nl) - data + 1;
+        page.next_line = page.first_line + count_newlines(data + page.begin, page.end - page.begin);
+        return page;
+    }
+
+    // 单独一行就超过上限，截断在字符边界，后续部分按字节偏移继续读取
+    page.whole_lines = false;
+    page.end = std::max(utf8_floor(data, file_->size(), page.begin + max_bytes), page.begin + 1);
+    page.next_line = page.first_line;
+    return page;
+}
+
+TextPage LineIndex::page_by_bytes(const MappedFile& file, size_t offset, size_t max_bytes) {
+    const char* data = file.data();
+    size_t size = file.size();
+    TextPage page;
+    page.begin = utf8_ceil(data, size, std::min(offset, size));
+    size_t limit = std::min(size, page.begin + max_bytes);
+    page.end = utf8_floor(data, size, limit);
+    if (page.end <= page.begin) {
+        page.end = limit;   // 上限小于一个字符时至少前进，避免客户端原地翻页
+    }
+    return page;
+}
+
+size_t LineIndex::count_newlines(const char* data, size_t len) {
+    size_t need = kCountOnly;
+    std::vector<uint64_t> unused;
+    return scan_impl().scan(data, len, need, unused);
+}
+
+const char* LineIndex::simd_level() {
+    return scan_impl().name;
+}
+
+LineIndexCache::LineIndexCache(size_t max_entries) : max_entries_(max_entries) {
+}
+
+std::shared_ptr<const LineIndex> LineIndexCache::get(const std::string& path, const Mapper& mapper) {
+    std::promise<std::shared_ptr<const LineIndex>> promise;
+    IndexFuture future;
+    bool hit = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(path);
+        if (it != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            future = it->second->index;
+            hit = true;
+        } else {
+            // 先放入未完成的条目，同一文件的并发请求等待这一次构建
+            future = promise.get_future().share();
+            lru_.push_front(Entry{path, future});
+            index_[path] = lru_.begin();
+            while (lru_.size() > max_entries_ && lru_.size() > 1) {
+                index_.erase(lru_.back().path);
+                lru_.pop_back();
+            }
+        }
+    }
+    if (hit) {
+        return future.get();    // 可能仍在构建中，在锁外等待
+    }
+
+    std::shared_ptr<const LineIndex> built;
+    try {
+        std::shared_ptr<const MappedFile> file = mapper(path);
+        if (file) {
+            built = LineIndex::build(std::move(file));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "建立行索引失败: " << path << " " << e.what() << std::endl;
+    }
+    promise.set_value(built);
+
+    if (!built) {
+        // 不缓存失败结果；条目若已被替换成新的构建则保留
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(path);
+        if (it != index_.end() && it->second->index.wait_for(std::chrono::seconds(0)) == std::future_status::ready &&
+            it->second->index.get() == nullptr) {
+            lru_.erase(it->second);
+            index_.erase(it);
+        }
+    }
+    return built;
+}
+
+std::shared_ptr<const LineIndex> LineIndexCache::peek(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(path);
+    if (it == index_.end() || it->second->index.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->index.get();
+}
+
+void LineIndexCache::invalidate(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(path);
+    if (it == index_.end()) {
+        return;
+    }
+    lru_.erase(it->second);
+    index_.erase(it);
+}
+
+size_t LineIndexCache::entries() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.size();
+}
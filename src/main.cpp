@@ -14,19 +14,29 @@
 #include "file_manager.h"
 #include "json_helper.h"
 #include "system_monitor.h"
+#include "resumable_upload.h"
 
 // 全局变量
 HttpServer* g_server = nullptr;
 Database* g_database = nullptr;
 FileManager* g_file_manager = nullptr;
+ResumableUploads* g_uploads = nullptr;
+volatile sig_atomic_t g_stop_requested = 0;
+// 短词搜索退化为扫描files表，与/api/search的路由名额分开，单独限制同时进行的扫描数
+RouteLimit g_search_scans(4);
+
+// 不超过该大小的文件从映射缓存下载，更大的文件走sendfile
+const long kMappedDownloadMax = 1024 * 1024;
+// 文本预览：默认每页行数与字节数，以及客户端可请求的上限
+const size_t kPreviewDefaultLines = 500;
+const size_t kPreviewMaxLines = 10000;
+const size_t kPreviewDefaultBytes = 64 * 1024;
+const size_t kPreviewMaxBytes = 1024 * 1024;
 
 // 信号处理函数
+// 只设置标志，由主线程停止服务器并释放资源（数据库关闭时会写入缓冲中的下载次数）
 void signal_handler(int signal) {
-    std::cout << "\n收到信号 " << signal << "，正在关闭服务器..." << std::endl;
-    if (g_server) {
-        g_server->stop();
-    }
-    exit(0);
+    g_stop_requested = signal;
 }
 
 // 生成随机session ID
@@ -80,13 +90,12 @@ int get_user_id_from_session(const std::map<std::string, std::string>& params) {
         return -1;
     }
     
+    // 会话缓存中已有用户ID，不必再查用户表
     Session session = g_database->get_session(session_id);
     if (session.username.empty()) {
         return -1;
     }
-    
-    User user = g_database->get_user(session.username);
-    return user.id;
+    return session.user_id;
 }
 
 // 从请求中获取用户ID（同时支持headers和params）
@@ -106,22 +115,75 @@ int get_user_id_from_request(const HttpRequest& request) {
         return -1;
     }
     
+    // 会话缓存中已有用户ID，不必再查用户表
     Session session = g_database->get_session(session_id);
     if (session.username.empty()) {
         return -1;
     }
-    
-    User user = g_database->get_user(session.username);
-    return user.id;
+    return session.user_id;
+}
+
+// 文件读取权限，与列表接口一致：已分享的文件所有人可读，未分享的只有上传者本人和管理员可读
+bool can_read_file(const HttpRequest& request, const FileInfo& file) {
+    if (file.is_shared) {
+        return true;
+    }
+    auto cookie_it = request.headers.find("cookie");
+    if (cookie_it == request.headers.end()) {
+        return false;
+    }
+    std::string session_id = get_session_from_cookies(cookie_it->second);
+    if (session_id.empty()) {
+        return false;
+    }
+    Session session = g_database->get_session(session_id);
+    if (session.username.empty()) {
+        return false;
+    }
+    return session.user_id == file.uploader_id || session.role == "admin";
 }
 
+// 读取列表接口的cursor参数；参数存在但无法解析时返回false
+bool parse_cursor_param(const std::map<std::string, std::string>& params, FileCursor& cursor, bool& has_cursor) {
+    auto it = params.find("cursor");
+    has_cursor = it != params.end() && !it->second.empty();
+    return !has_cursor || Database::decodeCursor(it->second, cursor);
+}
+
+// 流式文件列表：作为列表查询的回调，把每行直接写进JSON数组，同时记下最后一行用于生成下一页游标
+struct FileListJson {
+    std::string data;
+    FileCursor last;
+    size_t count;
+    bool by_shared_time;
+    
+    explicit FileListJson(bool by_shared_time) : data("["), count(0), by_shared_time(by_shared_time) {}
+    
+    void operator()(const FileRow& row) {
+        if (count++ > 0) {
+            data += ',';
+        }
+        JsonHelper::append_file(data, row);
+        last.key.assign(by_shared_time ? row.shared_at : row.upload_time);
+        last.id = row.id;
+    }
+    
+    // 结束数组；本页已满时返回下一页游标，否则说明已到末尾，返回空串
+    std::string finish(int limit) {
+        data += ']';
+        if (count == 0 || static_cast<int>(count) < limit) {
+            return "";
+        }
+        return Database::encodeCursor(last);
+    }
+};
+
 // 前向声明
-std::string handle_login(const std::string& body, const std::map<std::string, std::string>& params);
 std::string handle_register(const std::string& body, const std::map<std::string, std::string>& params);
 std::string handle_logout(const std::string& body, const std::map<std::string, std::string>& params);
 std::string handle_user_profile(const std::string& body, const std::map<std::string, std::string>& params);
 std::string handle_get_files(const std::string& body, const std::map<std::string, std::string>& params);
-std::string handle_upload(const std::string& body, const std::map<std::string, std::string>& params);
+std::string handle_upload(const std::vector<MultipartPart>& parts, const std::map<std::string, std::string>& params);
 std::string handle_system_status(const std::string& body, const std::map<std::string, std::string>& params);
 std::string handle_processes(const std::string& body, const std::map<std::string, std::string>& params);
 std::string handle_get_users(const std::string& body, const std::map<std::string, std::string>& params);
@@ -132,6 +194,7 @@ std::string handle_kill_process(const std::string& body, const std::map<std::str
 // 新的个人文件管理API
 std::string handle_my_files(const std::string& body, const std::map<std::string, std::string>& params);
 std::string handle_shared_files(const std::string& body, const std::map<std::string, std::string>& params);
+std::string handle_search(const std::string& body, const std::map<std::string, std::string>& params);
 std::string handle_toggle_share(const std::string& body, const std::map<std::string, std::string>& params);
 std::string handle_user_storage(const std::string& body, const std::map<std::string, std::string>& params);
 std::string handle_admin_files(const std::string& body, const std::map<std::string, std::string>& params);
@@ -173,13 +236,18 @@ void handle_login_route(const HttpRequest& request, HttpResponse& response) {
     }
     
     try {
-        bool password_valid = g_database->verify_password(username, password);
+        Database::PasswordCheck check = g_database->checkPassword(username, password);
         
-        if (password_valid) {
-            User user = g_database->get_user(username);
+        if (check == Database::PasswordCheck::Busy) {
+            // 同时登录的请求过多，密码哈希线程池已排满
+            response.status_code = 503;
+            response.body = JsonHelper::error_response("Too many login attempts, please retry later");
+            response.headers["Content-Type"] = "application/json";
+            response.headers["Retry-After"] = "1";
+        } else if (check == Database::PasswordCheck::Valid) {
             std::string session_id = generate_session_id();
             
-            if (g_database->create_session(session_id, username, user.role)) {
+            if (g_database->create_session(session_id, username)) {
                 response.body = JsonHelper::success_response("Login successful");
                 response.headers["Content-Type"] = "application/json";
                 response.headers["Set-Cookie"] = "session_id=" + session_id + "; Path=/; Max-Age=86400";
@@ -239,7 +307,8 @@ void handle_upload_route(const HttpRequest& request, HttpResponse& response) {
         combined_params[header.first] = header.second;
     }
     
-    std::string result = handle_upload(request.body, combined_params);
+    // 请求体已由服务器流式解析，文件内容位于临时文件中
+    std::string result = handle_upload(request.parts, combined_params);
     response.body = result;
     response.headers["Content-Type"] = "application/json";
 }
@@ -256,37 +325,6 @@ void handle_processes_route(const HttpRequest& request, HttpResponse& response)
     response.headers["Content-Type"] = "application/json";
 }
 
-// 用户登录
-std::string handle_login(const std::string& body, const std::map<std::string, std::string>& params) {
-    try {
-        auto form_data = JsonHelper::parse_form_data(body);
-        std::string username = form_data["username"];
-        std::string password = form_data["password"];
-        
-        if (username.empty() || password.empty()) {
-            return JsonHelper::error_response("Username and password are required");
-        }
-        
-        // 调试：检查密码验证
-        bool password_valid = g_database->verify_password(username, password);
-        if (password_valid) {
-            User user = g_database->get_user(username);
-            std::string session_id = generate_session_id();
-            
-            if (g_database->create_session(session_id, username, user.role)) {
-                return JsonHelper::success_response("Login successful");
-            } else {
-                return JsonHelper::error_response("Session creation failed");
-            }
-        }
-        
-        return JsonHelper::error_response("Invalid username or password");
-        
-    } catch (const std::exception& e) {
-        return JsonHelper::error_response("Internal server error");
-    }
-}
-
 // 用户注册
 std::string handle_register(const std::string& body, const std::map<std::string, std::string>& params) {
     auto form_data = JsonHelper::parse_form_data(body);
@@ -386,91 +424,22 @@ std::string handle_get_files(const std::string& body, const std::map<std::string
         category = it->second;
     }
     
-    std::vector<FileInfo> files = g_database->get_files(page, limit, category);
-    int total = g_database->get_total_files(category);
-    
-    std::string files_json = JsonHelper::serialize_files(files);
-    return JsonHelper::paginated_response(files_json, total, page, limit);
-}
-
-// 改进的multipart/form-data解析
-struct MultipartField {
-    std::string content;
-    std::string filename;
-    std::string content_type;
-};
-
-std::map<std::string, MultipartField> parse_multipart_fields_enhanced(const std::string& body, const std::string& boundary) {
-    std::map<std::string, MultipartField> fields;
-    
-    size_t pos = 0;
-    while (pos < body.length()) {
-        size_t boundary_pos = body.find("--" + boundary, pos);
-        if (boundary_pos == std::string::npos) break;
-        
-        size_t content_start = body.find("\r\n\r\n", boundary_pos);
-        if (content_start == std::string::npos) break;
-        
-        std::string headers = body.substr(boundary_pos, content_start - boundary_pos);
-        content_start += 4; // 跳过"\r\n\r\n"
-        
-        size_t content_end = body.find("\r\n--" + boundary, content_start);
-        if (content_end == std::string::npos) content_end = body.length();
-        
-        std::string content = body.substr(content_start, content_end - content_start);
-        
-        // 解析字段名
-        size_t name_pos = headers.find("name=\"");
-        if (name_pos != std::string::npos) {
-            name_pos += 6;
-            size_t name_end = headers.find("\"", name_pos);
-            if (name_end != std::string::npos) {
-                std::string field_name = headers.substr(name_pos, name_end - name_pos);
-                
-                MultipartField field;
-                field.content = content;
-                
-                // 解析文件名 (如果存在)
-                size_t filename_pos = headers.find("filename=\"");
-                if (filename_pos != std::string::npos) {
-                    filename_pos += 10;
-                    size_t filename_end = headers.find("\"", filename_pos);
-                    if (filename_end != std::string::npos) {
-                        field.filename = headers.substr(filename_pos, filename_end - filename_pos);
-                    }
-                }
-                
-                // 解析Content-Type (如果存在)
-                size_t content_type_pos = headers.find("Content-Type: ");
-                if (content_type_pos != std::string::npos) {
-                    content_type_pos += 14;
-                    size_t content_type_end = headers.find("\r\n", content_type_pos);
-                    if (content_type_end == std::string::npos) {
-                        content_type_end = headers.length();
-                    }
-                    field.content_type = headers.substr(content_type_pos, content_type_end - content_type_pos);
-                }
-                
-                fields[field_name] = field;
-            }
-        }
-        
-        pos = content_end;
+    // 带cursor时按游标翻页，不再扫描跳过前面的行；page参数保留兼容
+    FileCursor cursor;
+    bool has_cursor;
+    if (!parse_cursor_param(params, cursor, has_cursor)) {
+        return JsonHelper::error_response("Invalid cursor");
     }
-    
-    return fields;
-}
-
-// 保持向后兼容的简化版本
-std::map<std::string, std::string> parse_multipart_fields(const std::string& body, const std::string& boundary) {
-    auto enhanced_fields = parse_multipart_fields_enhanced(body, boundary);
-    std::map<std::string, std::string> simple_fields;
-    
-    for (const auto& field : enhanced_fields) {
-        simple_fields[field.first] = field.second.content;
+    FileListJson files(false);
+    if (has_cursor) {
+        g_database->listFiles(limit, cursor, category, std::ref(files));
+    } else {
+        g_database->listFiles(limit, (page - 1) * limit, category, std::ref(files));
     }
+    int total = g_database->get_total_files(category);
     
-    return simple_fields;
+    std::string next = files.finish(limit);
+    return JsonHelper::paginated_response(files.data, total, page, limit, next);
 }
 
 // 获取文件扩展名
@@ -536,7 +505,7 @@ std::string get_mime_type(const std::string& filename) {
 }
 
 // 文件上传
-std::string handle_upload(const std::string& body, const std::map<std::string, std::string>& params) {
+std::string handle_upload(const std::vector<MultipartPart>& parts, const std::map<std::string, std::string>& params) {
     try {
         // 验证用户登录
         int user_id = get_user_id_from_session(params);
@@ -544,104 +513,62 @@ std::string handle_upload(const std::string& body, const std::map<std::string, s
             return JsonHelper::error_response("Authentication required");
         }
         
-        // 从Content-Type中提取boundary (检查多种格式)
-        auto content_type_it = params.find("Content-Type");
-        if (content_type_it == params.end()) {
-            content_type_it = params.find("content-type");
-        }
-        if (content_type_it == params.end()) {
-            // 调试：打印所有headers
-            std::string debug_headers = "Headers: ";
-            for (const auto& p : params) {
-                debug_headers += p.first + "=" + p.second + "; ";
+        const MultipartPart* file_part = nullptr;
+        std::string category = "others";
+        for (const auto& part : parts) {
+            if (part.name == "file" && part.is_file()) {
+                file_part = &part;
+            } else if (part.name == "category" && !part.value.empty()) {
+                category = part.value;
             }
-            return JsonHelper::error_response("Missing Content-Type header. " + debug_headers);
-        }
-        
-        std::string content_type = content_type_it->second;
-        size_t boundary_pos = content_type.find("boundary=");
-        if (boundary_pos == std::string::npos) {
-            return JsonHelper::error_response("Missing boundary in Content-Type");
         }
         
-        std::string boundary = content_type.substr(boundary_pos + 9);
-        
-        // 解析multipart数据 (使用增强版本)
-        auto enhanced_fields = parse_multipart_fields_enhanced(body, boundary);
-        
-        auto file_it = enhanced_fields.find("file");
-        auto category_it = enhanced_fields.find("category");
-        
-        if (file_it == enhanced_fields.end()) {
+        if (file_part == nullptr) {
             return JsonHelper::error_response("No file provided");
         }
         
-        std::string category = "others";
-        if (category_it != enhanced_fields.end()) {
-            category = category_it->second.content;
-        }
-        
-        // 获取原始文件名和扩展名
-        std::string original_filename = file_it->second.filename;
-        if (original_filename.empty()) {
-            original_filename = "unnamed_file";
-        }
-        
-        // 生成唯一的文件名，保持原扩展名
-        std::string file_extension = get_file_extension(original_filename);
-        if (file_extension.empty()) {
-            file_extension = ".bin"; // 默认扩展名
+        // 检查文件大小（文件尚在临时目录中，未通过时由服务器清理）；配额在写库时原子检查
+        long file_size = static_cast<long>(file_part->size);
+        if (!g_file_manager->is_size_valid(file_part->size)) {
+            return JsonHelper::error_response("File too large");
         }
         
-        std::string filename = "uploaded_" + std::to_string(time(nullptr)) + file_extension;
-        std::string filepath = "shared/" + category + "/" + filename;
-        
-        // 确保目录存在
-        std::string dir_path = "shared/" + category;
-        mkdir(dir_path.c_str(), 0755);
-        
-        // 保存文件
-        std::ofstream file(filepath, std::ios::binary);
-        if (!file.is_open()) {
-            return JsonHelper::error_response("Failed to save file");
-        }
+        // 获取原始文件名
+        std::string original_filename = file_part->filename;
         
-        file.write(file_it->second.content.c_str(), file_it->second.content.length());
-        file.close();
-        
-        // 检查文件大小和用户配额
-        long file_size = file_it->second.content.length();
-        auto storage_info = g_database->getUserStorageInfo(user_id);
-        long used = storage_info.first;
-        long quota = storage_info.second;
-        
-        if (used + file_size > quota) {
-            // 删除已保存的文件
-            std::remove(filepath.c_str());
-            return JsonHelper::error_response("Storage quota exceeded. Available: " + 
-                std::to_string((quota - used) / 1024 / 1024) + "MB");
-        }
+        // 内容按上传时计算的SHA-256存放，相同内容的文件共用一份
+        std::string filepath = g_file_manager->blob_path(file_part->sha256);
         
         // 获取正确的MIME类型
         std::string mime_type = get_mime_type(original_filename);
-        if (!file_it->second.content_type.empty()) {
-            mime_type = file_it->second.content_type; // 如果浏览器提供了MIME类型，优先使用
+        if (!file_part->content_type.empty()) {
+            mime_type = file_part->content_type; // 如果浏览器提供了MIME类型，优先使用
         }
         
-        // 添加到数据库，使用原始文件名和正确的MIME类型
-        bool success = g_database->addFile(original_filename, filepath, mime_type, 
-                                          file_size, user_id, category, false); // 默认不分享
+        // 按落盘策略先同步内容，再写库
+        if (!g_file_manager->sync_before_commit(file_part->temp_path)) {
+            return JsonHelper::error_response("Failed to save file");
+        }
         
-        if (success) {
-            // 更新用户存储使用量
-            g_database->updateUserStorage(user_id, file_size);
+        // 占用配额、添加文件记录（默认不分享）、更新存储使用量在同一个事务中完成
+        int file_id = 0;
+        long available = 0;
+        Database::UploadStatus status = g_database->commitUpload(
+            original_filename, filepath, mime_type, file_size, user_id, category, file_part->sha256,
+            [file_part]() { return g_file_manager->store_blob(file_part->temp_path, file_part->sha256); },
+            file_id, available);
+        if (status == Database::UploadStatus::Committed) {
+            g_file_manager->sync_after_commit();
             return JsonHelper::success_response("File uploaded successfully");
-        } else {
-            // 删除已保存的文件
-            std::remove(filepath.c_str());
-            return JsonHelper::error_response("Failed to save file info to database");
         }
         
+        // 未提交时临时文件仍在原处，由服务器在请求结束后清理
+        if (status == Database::UploadStatus::QuotaExceeded) {
+            return JsonHelper::error_response("Storage quota exceeded. Available: " + 
+                std::to_string(available / 1024 / 1024) + "MB");
+        }
+        return JsonHelper::error_response("Failed to save file info to database");
+        
     } catch (const std::exception& e) {
         return JsonHelper::error_response("Upload failed: Internal error");
     }
@@ -651,6 +578,22 @@ std::string handle_upload(const std::string& body, const std::map<std::string, s
 std::string handle_system_status(const std::string& body, const std::map<std::string, std::string>& params) {
     // 检查管理员权限（简化处理）
     auto status = SystemMonitor::get_system_status();
+    // 下载次数写回缓冲：pending为崩溃时可能丢失的计数
+    status["download_counts_pending"] = std::to_string(g_database->pendingDownloadCount());
+    status["download_counts_flushed"] = std::to_string(g_database->flushedDownloadCount());
+    // 存储占用：logical为各用户计入配额的大小，physical为去重后实际占用的磁盘空间
+    long logical = 0;
+    long physical = 0;
+    if (g_database->getStorageUsage(logical, physical)) {
+        status["storage_logical_bytes"] = std::to_string(logical);
+        status["storage_physical_bytes"] = std::to_string(physical);
+    }
+    // 文件映射缓存：命中的预览和小文件下载不产生系统调用
+    const MappedFileCache& mappings = g_file_manager->mapping_cache();
+    status["mapping_cache_bytes"] = std::to_string(mappings.bytes());
+    status["mapping_cache_entries"] = std::to_string(mappings.entries());
+    status["mapping_cache_hits"] = std::to_string(mappings.hits());
+    status["mapping_cache_misses"] = std::to_string(mappings.misses());
     std::string status_json = JsonHelper::serialize_system_status(status);
     return JsonHelper::data_response(status_json, "System status retrieved");
 }
@@ -672,44 +615,137 @@ void handle_download_route(const HttpRequest& request, HttpResponse& response) {
         return;
     }
     
-    int file_id = std::stoi(it->second);
-    FileInfo* file = g_database->getFileById(file_id);
+    int file_id = std::atoi(it->second.c_str());
+    FileInfo* file = file_id > 0 ? g_database->getFileById(file_id) : nullptr;
     
-    if (!file) {
+    // 无权读取的文件与不存在的文件返回相同的404，不暴露ID是否存在
+    if (!file || !can_read_file(request, *file)) {
+        response.status_code = 404;
         response.body = JsonHelper::error_response("File not found");
         response.headers["Content-Type"] = "application/json";
         delete file;
         return;
     }
     
-    // 检查文件是否存在
-    std::ifstream filestream(file->filepath, std::ios::binary);
-    if (!filestream.is_open()) {
-        response.body = JsonHelper::error_response("File not accessible");
+    // 小文件从映射缓存直接发送，热点文件命中时不需要open/stat；
+    // 大文件由服务器用sendfile直接发送，不占用映射预算
+    std::shared_ptr<const MappedFile> mapped;
+    if (file->file_size <= kMappedDownloadMax) {
+        mapped = g_file_manager->map_file(file->filepath);
+    }
+    if (mapped) {
+        response.set_mapped_body(mapped);
+    } else {
+        struct stat st;
+        if (stat(file->filepath.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            response.body = JsonHelper::error_response("File not accessible");
+            response.headers["Content-Type"] = "application/json";
+            delete file;
+            return;
+        }
+        response.set_file_body(file->filepath);
+    }
+    response.headers["Content-Type"] = file->file_type.empty() ? "application/octet-stream" : file->file_type;
+    response.headers["Content-Disposition"] = "attachment; filename=\"" + file->filename + "\"";
+    
+    // 更新下载次数；视频拖动和断点续传会产生大量Range请求，只统计从头开始的请求
+    auto range_it = request.headers.find("range");
+    if (range_it == request.headers.end() || range_it->second.find("bytes=0-") == 0) {
+        g_database->incrementDownloadCount(file_id);
+    }
+    
+    delete file;
+}
+
+// 解析非负整数查询参数，参数不存在时保持默认值；格式错误返回false
+bool parse_count_param(const std::map<std::string, std::string>& params, const char* name, size_t& value) {
+    auto it = params.find(name);
+    if (it == params.end()) {
+        return true;
+    }
+    const std::string& text = it->second;
+    if (text.empty() || text.size() > 18 || !std::all_of(text.begin(), text.end(), ::isdigit)) {
+        return false;
+    }
+    value = std::stoull(text);
+    return true;
+}
+
+// 文本文件分页预览，页内容从映射中直接发送，不复制也不做JSON转义：
+//   line/lines   按行分页，依赖文件的行索引（首次预览时建立并缓存）
+//   offset       按字节偏移分页，不按行定位，用于超长的单行；不会为此建立行索引
+//   length       每页字节数上限，两种方式都适用；页的两端都对齐到UTF-8字符边界
+void handle_preview_route(const HttpRequest& request, HttpResponse& response) {
+    auto it = request.params.find("id");
+    int file_id = it == request.params.end() ? 0 : std::atoi(it->second.c_str());
+    FileInfo* file = file_id > 0 ? g_database->getFileById(file_id) : nullptr;
+    if (!file || !can_read_file(request, *file)) {
+        response.status_code = 404;
+        response.body = JsonHelper::error_response("File not found");
         response.headers["Content-Type"] = "application/json";
         delete file;
         return;
     }
     
-    // 读取文件内容
-    filestream.seekg(0, std::ios::end);
-    size_t file_size = filestream.tellg();
-    filestream.seekg(0, std::ios::beg);
-    
-    std::string file_content(file_size, '\0');
-    filestream.read(&file_content[0], file_size);
-    filestream.close();
-    
-    // 设置响应头
-    response.body = file_content;
-    response.headers["Content-Type"] = file->mime_type.empty() ? "application/octet-stream" : file->mime_type;
-    response.headers["Content-Disposition"] = "attachment; filename=\"" + file->filename + "\"";
-    response.headers["Content-Length"] = std::to_string(file_size);
+    if (!g_file_manager->is_text_file(file->filename)) {
+        response.status_code = 415;
+        response.body = JsonHelper::error_response("Preview is only available for text files");
+        response.headers["Content-Type"] = "application/json";
+        delete file;
+        return;
+    }
+    std::string filepath = file->filepath;
+    delete file;
     
-    // 更新下载次数
-    g_database->incrementDownloadCount(file_id);
+    size_t first_line = 0;
+    size_t lines = kPreviewDefaultLines;
+    size_t offset = 0;
+    size_t length = kPreviewDefaultBytes;
+    bool by_offset = request.params.count("offset") > 0;
+    if (!parse_count_param(request.params, "line", first_line) || !parse_count_param(request.params, "lines", lines) ||
+        !parse_count_param(request.params, "offset", offset) || !parse_count_param(request.params, "length", length)) {
+        response.status_code = 400;
+        response.body = JsonHelper::error_response("Invalid preview range");
+        response.headers["Content-Type"] = "application/json";
+        return;
+    }
+    lines = std::max<size_t>(1, std::min(lines, kPreviewMaxLines));
+    length = std::max<size_t>(4, std::min(length, kPreviewMaxBytes));  // 至少容纳一个UTF-8字符
     
-    delete file;
+    // 有行索引时使用它持有的映射，翻页不必重新映射整个文件，响应期间由shared_ptr保持。
+    // 按偏移分页不需要索引：未缓存时直接映射文件，不为此扫描全文的换行符
+    std::shared_ptr<const MappedFile> mapped;
+    std::shared_ptr<const LineIndex> index = by_offset ? g_file_manager->cached_line_index(filepath)
+                                                       : g_file_manager->line_index(filepath);
+    if (index) {
+        mapped = std::shared_ptr<const MappedFile>(index, &index->file());
+    } else if (by_offset) {
+        mapped = g_file_manager->map_file(filepath);
+    }
+    if (!mapped) {
+        response.body = JsonHelper::error_response("File not accessible");
+        response.headers["Content-Type"] = "application/json";
+        return;
+    }
+    TextPage page = by_offset ? LineIndex::page_by_bytes(*mapped, offset, length)
+                              : index->page_by_lines(first_line, lines, length);
+    mapped->prefetch(page.begin, page.end - page.begin);    // 只预读本页
+    
+    response.set_mapped_body(mapped, page.begin, static_cast<long>(page.end - page.begin));
+    response.headers["Content-Type"] = "text/plain; charset=utf-8";
+    response.headers["X-File-Size"] = std::to_string(mapped->size());
+    response.headers["X-Preview-Offset"] = std::to_string(page.begin);
+    response.headers["X-Next-Offset"] = std::to_string(page.end);
+    response.headers["X-Preview-Truncated"] = page.end < mapped->size() ? "true" : "false";
+    if (index) {
+        response.headers["X-Total-Lines"] = std::to_string(index->line_count());
+    }
+    if (!by_offset) {
+        response.headers["X-Line-Start"] = std::to_string(page.first_line);
+        if (page.whole_lines) {
+            response.headers["X-Next-Line"] = std::to_string(page.next_line);
+        }
+    }
 }
 
 // 管理员功能 - 获取用户列表
@@ -752,15 +788,16 @@ std::string handle_delete_file(const std::string& body, const std::map<std::stri
     if (!file) {
         return JsonHelper::error_response("File not found");
     }
-    
-    // 删除物理文件
-    if (std::remove(file->filepath.c_str()) != 0) {
-        // 文件删除失败，但继续删除数据库记录
-    }
-    
-    bool success = g_database->deleteFile(file_id);
     delete file;
     
+    // 内容可能被其他文件记录共用，是否删除磁盘上的内容由数据库按引用计数决定
+    bool success = g_database->deleteFile(file_id, [](const std::string& filepath) {
+        g_file_manager->forget_mapping(filepath);
+        if (std::remove(filepath.c_str()) != 0) {
+            std::cerr << "删除文件内容失败: " << filepath << std::endl;
+        }
+    });
+    
     if (success) {
         return JsonHelper::success_response("File deleted successfully");
     } else {
@@ -811,11 +848,21 @@ std::string handle_my_files(const std::string& body, const std::map<std::string,
         limit = std::stoi(it->second);
     }
     
-    std::vector<FileInfo> files = g_database->getUserFiles(user_id, limit, (page - 1) * limit);
-    std::string files_json = JsonHelper::serialize_files(files);
+    FileCursor cursor;
+    bool has_cursor;
+    if (!parse_cursor_param(params, cursor, has_cursor)) {
+        return JsonHelper::error_response("Invalid cursor");
+    }
+    FileListJson files(false);
+    if (has_cursor) {
+        g_database->listUserFiles(user_id, limit, cursor, std::ref(files));
+    } else {
+        g_database->listUserFiles(user_id, limit, (page - 1) * limit, std::ref(files));
+    }
     
     // 获取总数（简化版本，这里没有分页总数计算）
-    return JsonHelper::data_response(files_json, "My files retrieved successfully");
+    std::string next = files.finish(limit);
+    return JsonHelper::cursor_response(files.data, "My files retrieved successfully", next);
 }
 
 
@@ -834,10 +881,48 @@ std::string handle_shared_files(const std::string& body, const std::map<std::str
         limit = std::stoi(it->second);
     }
     
-    std::vector<FileInfo> files = g_database->getSharedFiles(limit, (page - 1) * limit);
+    FileCursor cursor;
+    bool has_cursor;
+    if (!parse_cursor_param(params, cursor, has_cursor)) {
+        return JsonHelper::error_response("Invalid cursor");
+    }
+    FileListJson files(true);
+    if (has_cursor) {
+        g_database->listSharedFiles(limit, cursor, std::ref(files));
+    } else {
+        g_database->listSharedFiles(limit, (page - 1) * limit, std::ref(files));
+    }
+    
+    std::string next = files.finish(limit);
+    return JsonHelper::cursor_response(files.data, "Shared files retrieved successfully", next);
+}
+
+// 搜索文件：未登录时只搜分享的文件，登录后同时搜本人的文件
+std::string handle_search(const std::string& body, const std::map<std::string, std::string>& params) {
+    auto it = params.find("q");
+    if (it == params.end() || it->second.find_first_not_of(" \t") == std::string::npos) {
+        return JsonHelper::error_response("Missing search keyword");
+    }
+    std::string keyword = it->second;
+    
+    int page = 1;
+    int limit = 20;
+    
+    it = params.find("page");
+    if (it != params.end()) {
+        page = std::max(1, std::stoi(it->second));
+    }
+    
+    it = params.find("limit");
+    if (it != params.end()) {
+        limit = std::min(100, std::max(1, std::stoi(it->second)));
+    }
+    
+    int user_id = get_user_id_from_session(params);
+    std::vector<FileInfo> files = g_database->searchFiles(keyword, user_id, limit, (page - 1) * limit);
     std::string files_json = JsonHelper::serialize_files(files);
     
-    return JsonHelper::data_response(files_json, "Shared files retrieved successfully");
+    return JsonHelper::data_response(files_json, "Search results retrieved successfully");
 }
 
 // 切换文件分享状态
@@ -946,6 +1031,40 @@ void handle_shared_files_route(const HttpRequest& request, HttpResponse& respons
     response.headers["Content-Type"] = "application/json";
 }
 
+void handle_search_route(const HttpRequest& request, HttpResponse& response) {
+    auto keyword = request.params.find("q");
+    bool scan = keyword != request.params.end() && Database::searchNeedsScan(keyword->second);
+    if (scan && g_search_scans.inflight.fetch_add(1) >= g_search_scans.max_inflight) {
+        g_search_scans.inflight.fetch_sub(1);
+        response.status_code = 503;
+        response.body = JsonHelper::error_response("Too many short-word searches, please retry later");
+        response.headers["Content-Type"] = "application/json";
+        response.headers["Retry-After"] = "1";
+        return;
+    }
+    
+    // 将headers和params合并
+    std::map<std::string, std::string> combined_params = request.params;
+    for (const auto& header : request.headers) {
+        combined_params[header.first] = header.second;
+    }
+    
+    std::string result;
+    try {
+        result = handle_search(request.body, combined_params);
+    } catch (...) {
+        if (scan) {
+            g_search_scans.inflight.fetch_sub(1);
+        }
+        throw;
+    }
+    if (scan) {
+        g_search_scans.inflight.fetch_sub(1);
+    }
+    response.body = result;
+    response.headers["Content-Type"] = "application/json";
+}
+
 void handle_toggle_share_route(const HttpRequest& request, HttpResponse& response) {
     // 将headers和params合并
     std::map<std::string, std::string> combined_params = request.params;
@@ -982,6 +1101,214 @@ void handle_admin_files_route(const HttpRequest& request, HttpResponse& response
     response.headers["Content-Type"] = "application/json";
 }
 
+// ===== 断点续传上传 =====
+// POST /api/uploads 创建会话 → PATCH /api/uploads/:id 分块上传（可并行、可重传）
+// → GET /api/uploads/:id 查询进度 → POST /api/uploads/:id/finish 提交；DELETE 放弃上传
+
+// 把续传会话的状态码转换为HTTP响应
+void set_upload_error(HttpResponse& response, ResumableUploads::Status status) {
+    static const struct { ResumableUploads::Status status; int code; const char* message; } errors[] = {
+        {ResumableUploads::Status::NotFound, 404, "Upload not found"},
+        {ResumableUploads::Status::BadRequest, 400, "Invalid chunk offset, length or checksum header"},
+        {ResumableUploads::Status::Conflict, 409, "Chunk is being written by another request"},
+        {ResumableUploads::Status::ChecksumMismatch, 460, "Chunk checksum mismatch"},
+        {ResumableUploads::Status::Incomplete, 409, "Upload is incomplete"},
+        {ResumableUploads::Status::TooMany, 503, "Too many unfinished uploads"},
+        {ResumableUploads::Status::Failed, 500, "Failed to write upload"},
+    };
+    response.status_code = 500;
+    response.body = JsonHelper::error_response("Upload failed", 500);
+    for (const auto& error : errors) {
+        if (error.status == status) {
+            response.status_code = error.code;
+            response.body = JsonHelper::error_response(error.message, error.code);
+            break;
+        }
+    }
+    response.headers["Content-Type"] = "application/json";
+}
+
+std::string upload_progress_json(ResumableUpload& upload) {
+    UploadProgress progress;
+    g_uploads->progress(upload, progress);
+    std::string json = "{\"upload_id\":\"" + upload.id + "\"" +
+                       ",\"size\":" + std::to_string(progress.size) +
+                       ",\"chunk_size\":" + std::to_string(progress.chunk_size) +
+                       ",\"chunk_count\":" + std::to_string(upload.chunks.size()) +
+                       ",\"received\":" + std::to_string(progress.received_bytes) +
+                       ",\"offset\":" + std::to_string(progress.offset) +
+                       ",\"missing\":[";
+    for (size_t i = 0; i < progress.missing.size(); ++i) {
+        json += (i > 0 ? "," : "") + std::to_string(progress.missing[i]);
+    }
+    return json + "]}";
+}
+
+// 取出当前用户的续传会话，不存在时写好错误响应并返回nullptr
+std::shared_ptr<ResumableUpload> find_upload(const HttpRequest& request, HttpResponse& response) {
+    response.headers["Content-Type"] = "application/json";
+    int user_id = get_user_id_from_request(request);
+    if (user_id == -1) {
+        response.status_code = 401;
+        response.body = JsonHelper::error_response("Authentication required", 401);
+        return nullptr;
+    }
+    auto it = request.params.find("id");
+    std::shared_ptr<ResumableUpload> upload =
+        it == request.params.end() ? nullptr : g_uploads->find(it->second, user_id);
+    if (!upload) {
+        set_upload_error(response, ResumableUploads::Status::NotFound);
+    }
+    return upload;
+}
+
+void handle_upload_create_route(const HttpRequest& request, HttpResponse& response) {
+    response.headers["Content-Type"] = "application/json";
+    int user_id = get_user_id_from_request(request);
+    if (user_id == -1) {
+        response.status_code = 401;
+        response.body = JsonHelper::error_response("Authentication required", 401);
+        return;
+    }
+    
+    auto form_data = JsonHelper::parse_form_data(request.body);
+    std::string filename = form_data["filename"];
+    std::string category = form_data["category"].empty() ? "others" : form_data["category"];
+    std::string file_type = form_data["type"].empty() ? get_mime_type(filename) : form_data["type"];
+    long size = atol(form_data["size"].c_str());
+    size_t chunk_size = strtoul(form_data["chunk_size"].c_str(), nullptr, 10);
+    if (filename.empty() || size <= 0) {
+        response.body = JsonHelper::error_response("filename and size are required");
+        return;
+    }
+    if (!g_file_manager->is_size_valid(size)) {
+        response.body = JsonHelper::error_response("File too large");
+        return;
+    }
+    
+    // 提前检查配额，避免传完才发现超出；未完成的会话已预分配的空间一并计入，
+    // 否则同一用户可以开多个会话预占数倍于剩余配额的磁盘。真正的占用在提交时原子完成
+    auto storage = g_database->getUserStorageInfo(user_id);
+    long available = storage.second - storage.first;
+    std::shared_ptr<ResumableUpload> upload;
+    ResumableUploads::Status status = g_uploads->create(user_id, filename, file_type, category, size, chunk_size,
+                                                        available, upload);
+    if (status == ResumableUploads::Status::QuotaExceeded) {
+        long unreserved = std::max(0L, available - g_uploads->reserved_bytes(user_id));
+        response.body = JsonHelper::error_response("Storage quota exceeded. Available: " +
+            std::to_string(unreserved / 1024 / 1024) + "MB (including unfinished uploads)");
+        return;
+    }
+    if (status != ResumableUploads::Status::Ok) {
+        set_upload_error(response, status);
+        return;
+    }
+    response.headers["Location"] = "/api/uploads/" + upload->id;
+    response.body = JsonHelper::data_response(upload_progress_json(*upload), "Upload created");
+}
+
+void handle_upload_chunk_route(const HttpRequest& request, HttpResponse& response) {
+    std::shared_ptr<ResumableUpload> upload = find_upload(request, response);
+    if (!upload) {
+        return;
+    }
+    
+    // 块偏移与校验和放在请求头中（Upload-Offset / Upload-Checksum: sha256 <base64>），请求体为块内容
+    auto offset_it = request.headers.find("upload-offset");
+    auto checksum_it = request.headers.find("upload-checksum");
+    if (offset_it == request.headers.end() || checksum_it == request.headers.end()) {
+        set_upload_error(response, ResumableUploads::Status::BadRequest);
+        return;
+    }
+    
+    char* end = nullptr;
+    long offset = strtol(offset_it->second.c_str(), &end, 10);
+    if (end == offset_it->second.c_str() || *end != '\0') {
+        set_upload_error(response, ResumableUploads::Status::BadRequest);
+        return;
+    }
+    
+    ResumableUploads::Status status = g_uploads->write_chunk(*upload, offset, request.body, checksum_it->second);
+    if (status != ResumableUploads::Status::Ok) {
+        set_upload_error(response, status);
+        return;
+    }
+    UploadProgress progress;
+    g_uploads->progress(*upload, progress);
+    response.headers["Upload-Offset"] = std::to_string(progress.offset);
+    response.body = JsonHelper::data_response(
+        "{\"received\":" + std::to_string(progress.received_bytes) + ",\"offset\":" + std::to_string(progress.offset) + "}",
+        "Chunk stored");
+}
+
+void handle_upload_status_route(const HttpRequest& request, HttpResponse& response) {
+    std::shared_ptr<ResumableUpload> upload = find_upload(request, response);
+    if (!upload) {
+        return;
+    }
+    std::string json = upload_progress_json(*upload);
+    UploadProgress progress;
+    g_uploads->progress(*upload, progress);
+    response.headers["Upload-Offset"] = std::to_string(progress.offset);
+    response.headers["Upload-Length"] = std::to_string(progress.size);
+    response.headers["Cache-Control"] = "no-store";
+    response.body = JsonHelper::data_response(json, "Upload progress");
+}
+
+void handle_upload_finish_route(const HttpRequest& request, HttpResponse& response) {
+    std::shared_ptr<ResumableUpload> upload = find_upload(request, response);
+    if (!upload) {
+        return;
+    }
+    
+    std::string sha256;
+    ResumableUploads::Status status = g_uploads->finish(*upload, sha256);
+    if (status != ResumableUploads::Status::Ok) {
+        set_upload_error(response, status);
+        if (status == ResumableUploads::Status::Failed) {
+            g_uploads->remove(upload->id);
+        }
+        return;
+    }
+    
+    // 与普通上传相同：按内容哈希去重，配额占用、文件记录与内容落位在同一个事务中完成
+    int file_id = 0;
+    long available = 0;
+    std::string temp_path = upload->temp_path;
+    if (!g_file_manager->sync_before_commit(temp_path)) {
+        g_uploads->remove(upload->id);
+        set_upload_error(response, ResumableUploads::Status::Failed);
+        return;
+    }
+    Database::UploadStatus committed = g_database->commitUpload(
+        upload->filename, g_file_manager->blob_path(sha256), upload->file_type, upload->size,
+        upload->user_id, upload->category, sha256,
+        [&temp_path, &sha256]() { return g_file_manager->store_blob(temp_path, sha256); },
+        file_id, available);
+    g_uploads->remove(upload->id);
+    
+    if (committed == Database::UploadStatus::Committed) {
+        g_file_manager->sync_after_commit();
+        response.body = JsonHelper::data_response(
+            "{\"file_id\":" + std::to_string(file_id) + ",\"sha256\":\"" + sha256 + "\"}", "File uploaded successfully");
+    } else if (committed == Database::UploadStatus::QuotaExceeded) {
+        response.body = JsonHelper::error_response("Storage quota exceeded. Available: " +
+            std::to_string(available / 1024 / 1024) + "MB");
+    } else {
+        response.status_code = 500;
+        response.body = JsonHelper::error_response("Failed to save file info to database", 500);
+    }
+}
+
+void handle_upload_cancel_route(const HttpRequest& request, HttpResponse& response) {
+    std::shared_ptr<ResumableUpload> upload = find_upload(request, response);
+    if (!upload) {
+        return;
+    }
+    g_uploads->remove(upload->id);
+    response.body = JsonHelper::success_response("Upload cancelled");
+}
+
 int main() {
     std::cout << "启动 112小站 文件共享系统..." << std::endl;
     
@@ -996,9 +1323,6 @@ int main() {
         return 1;
     }
     
-    // 创建默认管理员账户
-    g_database->create_user("admin", "admin123", "admin");
-    
     // 初始化文件管理器
     g_file_manager = new FileManager("shared");
     if (!g_file_manager->create_directories()) {
@@ -1006,21 +1330,52 @@ int main() {
         return 1;
     }
     
+    // 上传内容与目录项在写库前落盘；刷盘很慢的磁盘上并发上传多时可改用SyncPolicy::Batched
+    g_file_manager->setSyncPolicy(FileManager::SyncPolicy::PerFile);
+    std::cout << "文本预览行索引扫描: " << LineIndex::simd_level() << std::endl;
+    
     // 启动HTTP服务器
     g_server = new HttpServer(80);
     
     // 设置静态文件目录
     g_server->setStaticRoot("static");
     
+    // 视频、图片、压缩包等已压缩格式不再做gzip/br
+    g_server->setIncompressibleTypes(g_file_manager->get_compressed_mime_types());
+    
+    // 限制上传与列表接口各自占用的工作线程池名额，一类请求过载时不拖垮其他接口
+    g_server->setRouteConcurrency("POST", "/api/upload", 16);
+    g_server->setRouteConcurrency("PATCH", "/api/uploads/:id", 32);
+    g_server->setRouteConcurrency("POST", "/api/uploads/:id/finish", 4);
+    g_server->setRouteConcurrency("POST", "/api/login", 32);
+    g_server->setRouteConcurrency("POST", "/api/register", 16);
+    g_server->setRouteConcurrency("GET", "/api/files", 64);
+    g_server->setRouteConcurrency("GET", "/api/my-files", 64);
+    g_server->setRouteConcurrency("GET", "/api/shared-files", 64);
+    g_server->setRouteConcurrency("GET", "/api/search", 32);
+    g_server->setRouteConcurrency("GET", "/api/admin/files", 32);
+    g_server->setRouteConcurrency("GET", "/api/files/:id/preview", 32);
+    
+    // 上传临时目录与shared位于同一文件系统，上传完成后直接改名到内容存储目录
+    g_server->setUploadTempDir("shared/.uploads");
+    g_uploads = new ResumableUploads("shared/.uploads");
+    
     // 注册API路由
     g_server->add_post_route("/api/login", handle_login_route);
     g_server->add_post_route("/api/register", handle_register_route);
     g_server->add_post_route("/api/logout", handle_logout_route);
     g_server->add_route("/api/user/profile", handle_user_profile_route);
-    g_server->add_post_route("/api/upload", handle_upload_route);
+    g_server->add_upload_route("/api/upload", handle_upload_route);
+    g_server->addRoute("POST", "/api/uploads", handle_upload_create_route);
+    g_server->addRoute("PATCH", "/api/uploads/:id", handle_upload_chunk_route);
+    g_server->addRoute("GET", "/api/uploads/:id", handle_upload_status_route);
+    g_server->addRoute("DELETE", "/api/uploads/:id", handle_upload_cancel_route);
+    g_server->addRoute("POST", "/api/uploads/:id/finish", handle_upload_finish_route);
     
     g_server->add_route("/api/files", handle_get_files_route);
     g_server->add_route("/api/download", handle_download_route);
+    g_server->add_route("/api/files/:id/content", handle_download_route);
+    g_server->add_route("/api/files/:id/preview", handle_preview_route);
     g_server->add_route("/api/system/status", handle_system_status_route);
     g_server->add_route("/api/system/processes", handle_processes_route);
     
@@ -1033,6 +1388,7 @@ int main() {
     // 新的个人文件管理API
     g_server->add_route("/api/my-files", handle_my_files_route);
     g_server->add_route("/api/shared-files", handle_shared_files_route);
+    g_server->add_route("/api/search", handle_search_route);
     g_server->add_post_route("/api/toggle-share", handle_toggle_share_route);
     g_server->add_route("/api/user/storage", handle_user_storage_route);
     g_server->add_route("/api/admin/files", handle_admin_files_route);
@@ -1049,11 +1405,17 @@ int main() {
     // 等待服务器运行
     std::cout << "按 Ctrl+C 停止服务器..." << std::endl;
     while (g_server->is_running()) {
+        if (g_stop_requested) {
+            std::cout << "\n收到信号 " << g_stop_requested << "，正在关闭服务器..." << std::endl;
+            g_server->stop();
+            break;
+        }
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
     
     // 清理资源
     delete g_server;
+    delete g_uploads;
     delete g_database;
     delete g_file_manager;
     
@@ -0,0 +1,134 @@
+#include "mapped_file.h"
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+// 不超过该大小的文件打开时整个预读；更大的文件（如几百MB的日志）只在访问时按区间预读
+const size_t kWholePrefetchMax = 8 * 1024 * 1024;
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return nullptr;
+    }
+
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    file->size_ = static_cast<size_t>(st.st_size);
+    file->mtime_ = st.st_mtim.tv_sec;
+    file->mtime_nsec_ = st.st_mtim.tv_nsec;
+    if (file->size_ > 0) {
+        void* addr = mmap(nullptr, file->size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            return nullptr;
+        }
+        // 预览和下载都是从头到尾读：加大预读窗口，小文件立即异步读入
+        madvise(addr, file->size_, MADV_SEQUENTIAL);
+        if (file->size_ <= kWholePrefetchMax) {
+            madvise(addr, file->size_, MADV_WILLNEED);
+        }
+        file->data_ = static_cast<const char*>(addr);
+    }
+    close(fd);  // 映射建立后不再需要文件描述符
+    return file;
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const {
+    if (data_ == nullptr || offset >= size_ || length == 0) {
+        return;
+    }
+    length = std::min(length, size_ - offset);
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t begin = offset & ~(page - 1);   // mmap返回的地址按页对齐
+    madvise(const_cast<char*>(data_) + begin, offset + length - begin, MADV_WILLNEED);
+}
+
+MappedFileCache::MappedFileCache(size_t budget_bytes, size_t max_entry_bytes)
+    : budget_(budget_bytes), max_entry_(max_entry_bytes), bytes_(0), hits_(0), misses_(0) {
+}
+
+std::shared_ptr<const MappedFile> MappedFileCache::get(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(path);
+        if (it != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return it->second->file;
+        }
+    }
+
+    // 打开和映射在锁外进行，同一文件并发未命中时各自映射，只有一个进入缓存
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    std::shared_ptr<const MappedFile> file = MappedFile::open(path);
+    if (!file) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file->size() > max_entry_ || file->size() > budget_) {
+        return file;
+    }
+    auto it = index_.find(path);
+    if (it != index_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return it->second->file;
+    }
+    lru_.push_front(Entry{path, file});
+    index_[path] = lru_.begin();
+    bytes_ += file->size();
+    evict_locked();
+    return file;
+}
+
+void MappedFileCache::invalidate(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(path);
+    if (it == index_.end()) {
+        return;
+    }
+    bytes_ -= it->second->file->size();
+    lru_.erase(it->second);
+    index_.erase(it);
+}
+
+void MappedFileCache::set_budget(size_t budget_bytes, size_t max_entry_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = budget_bytes;
+    max_entry_ = max_entry_bytes;
+    evict_locked();
+}
+
+size_t MappedFileCache::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+size_t MappedFileCache::entries() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.size();
+}
+
+void MappedFileCache::evict_locked() {
+    while (bytes_ > budget_ && !lru_.empty()) {
+        Entry& victim = lru_.back();
+        bytes_ -= victim.file->size();
+        index_.erase(victim.path);
+        lru_.pop_back();
+    }
+}
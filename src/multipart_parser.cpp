@@ -0,0 +1,327 @@
+#include "multipart_parser.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+namespace {
+
+const size_t kMaxPartHeaderSize = 16 * 1024;     // 单个分段头部上限
+const size_t kMaxFieldSize = 1024 * 1024;        // 普通字段值上限
+const size_t kMaxParts = 64;
+
+// 从头部参数中提取 key="value"
+std::string header_param(const std::string& header, const std::string& key) {
+    size_t pos = 0;
+    while ((pos = header.find(key + "=", pos)) != std::string::npos) {
+        // 确保匹配的是完整参数名（避免name匹配到filename）
+        if (pos > 0 && header[pos - 1] != ' ' && header[pos - 1] != ';' && header[pos - 1] != '\t') {
+            pos += key.size();
+            continue;
+        }
+        pos += key.size() + 1;
+        if (pos < header.size() && header[pos] == '"') {
+            size_t end = header.find('"', pos + 1);
+            if (end == std::string::npos) {
+                return "";
+            }
+            return header.substr(pos + 1, end - pos - 1);
+        }
+        size_t end = header.find(';', pos);
+        std::string value = header.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        value.erase(value.find_last_not_of(" \t") + 1);
+        return value;
+    }
+    return "";
+}
+
+} // namespace
+
+MultipartParser::MultipartParser(const std::string& boundary, const std::string& temp_dir)
+    : state_(State::Preamble), delimiter_("\r\n--" + boundary), temp_dir_(temp_dir), current_fd_(-1),
+      digest_(EVP_MD_CTX_new()) {
+    // BMH跳转表：模式串中最后一个字符之前出现过的字符按距末尾的距离跳转
+    for (size_t i = 0; i < 256; ++i) {
+        skip_[i] = delimiter_.size();
+    }
+    for (size_t i = 0; i + 1 < delimiter_.size(); ++i) {
+        skip_[static_cast<unsigned char>(delimiter_[i])] = delimiter_.size() - 1 - i;
+    }
+
+    // 第一个分界线前没有CRLF，补上后即可与后续分界线统一匹配
+    buffer_ = "\r\n";
+}
+
+MultipartParser::~MultipartParser() {
+    EVP_MD_CTX_free(digest_);
+    if (current_fd_ >= 0) {
+        close(current_fd_);
+    }
+    for (const auto& part : parts_) {
+        if (!part.temp_path.empty()) {
+            unlink(part.temp_path.c_str());
+        }
+    }
+}
+
+bool MultipartParser::extract_boundary(const std::string& content_type, std::string& boundary) {
+    if (strncasecmp(content_type.c_str(), "multipart/form-data", 19) != 0) {
+        return false;
+    }
+    boundary = header_param(content_type, "boundary");
+    return !boundary.empty() && boundary.size() <= 70;
+}
+
+size_t MultipartParser::find_delimiter() const {
+    const size_t m = delimiter_.size();
+    const size_t n = buffer_.size();
+    if (n < m) {
+        return std::string::npos;
+    }
+
+    const char* text = buffer_.data();
+    const char* pattern = delimiter_.data();
+    size_t pos = 0;
+    while (pos <= n - m) {
+        unsigned char last = static_cast<unsigned char>(text[pos + m - 1]);
+        if (last == static_cast<unsigned char>(pattern[m - 1]) &&
+            memcmp(text + pos, pattern, m - 1) == 0) {
+            return pos;
+        }
+        pos += skip_[last];
+    }
+    return std::string::npos;
+}
+
+bool MultipartParser::feed(const char* data, size_t len) {
+    if (state_ == State::Error) {
+        return false;
+    }
+    if (state_ == State::Done) {
+        return true;  // 忽略结尾之后的内容
+    }
+
+    buffer_.append(data, len);
+
+    while (true) {
+        switch (state_) {
+            case State::Preamble: {
+                size_t pos = find_delimiter();
+                if (pos == std::string::npos) {
+                    // 只保留可能构成分界线前缀的尾部
+                    if (buffer_.size() >= delimiter_.size()) {
+                        buffer_.erase(0, buffer_.size() - (delimiter_.size() - 1));
+                    }
+                    return true;
+                }
+                buffer_.erase(0, pos + delimiter_.size());
+                state_ = State::BoundaryLine;
+                break;
+            }
+
+            case State::BoundaryLine: {
+                // 分界线后允许少量空白，然后是CRLF或结束标记
+                size_t pos = 0;
+                while (pos < buffer_.size() && (buffer_[pos] == ' ' || buffer_[pos] == '\t')) {
+                    ++pos;
+                }
+                if (buffer_.size() - pos < 2) {
+                    if (pos > 256) {
+                        fail();
+                        return false;
+                    }
+                    return true;
+                }
+                if (buffer_.compare(pos, 2, "--") == 0) {
+                    buffer_.clear();
+                    state_ = State::Done;
+                    return true;
+                }
+                if (buffer_.compare(pos, 2, "\r\n") != 0) {
+                    fail();
+                    return false;
+                }
+                buffer_.erase(0, pos + 2);
+                state_ = State::Headers;
+                break;
+            }
+
+            case State::Headers: {
+                size_t header_end;
+                size_t skip;
+                if (buffer_.compare(0, 2, "\r\n") == 0) {
+                    header_end = 0;     // 没有任何头部
+                    skip = 2;
+                } else {
+                    header_end = buffer_.find("\r\n\r\n");
+                    skip = 4;
+                }
+                if (header_end == std::string::npos) {
+                    if (buffer_.size() > kMaxPartHeaderSize) {
+                        fail();
+                        return false;
+                    }
+                    return true;
+                }
+                if (!begin_part(buffer_.substr(0, header_end))) {
+                    fail();
+                    return false;
+                }
+                buffer_.erase(0, header_end + skip);
+                state_ = State::Body;
+                break;
+            }
+
+            case State::Body: {
+                size_t pos = find_delimiter();
+                if (pos == std::string::npos) {
+                    // 末尾可能是被截断的分界线，保留delimiter长度-1字节，其余直接写出
+                    if (buffer_.size() >= delimiter_.size()) {
+                        size_t safe = buffer_.size() - (delimiter_.size() - 1);
+                        if (!write_body(buffer_.data(), safe)) {
+                            fail();
+                            return false;
+                        }
+                        buffer_.erase(0, safe);
+                    }
+                    return true;
+                }
+                if (!write_body(buffer_.data(), pos) || !end_part()) {
+                    fail();
+                    return false;
+                }
+                buffer_.erase(0, pos + delimiter_.size());
+                state_ = State::BoundaryLine;
+                break;
+            }
+
+            case State::Done:
+                buffer_.clear();
+                return true;
+
+            case State::Error:
+                return false;
+        }
+    }
+}
+
+bool MultipartParser::begin_part(const std::string& headers) {
+    if (parts_.size() >= kMaxParts) {
+        return false;
+    }
+
+    MultipartPart part;
+    size_t line_start = 0;
+    while (line_start < headers.size()) {
+        size_t line_end = headers.find("\r\n", line_start);
+        if (line_end == std::string::npos) {
+            line_end = headers.size();
+        }
+        std::string line = headers.substr(line_start, line_end - line_start);
+        line_start = line_end + 2;
+
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string name = line.substr(0, colon);
+        std::string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+
+        if (strcasecmp(name.c_str(), "Content-Disposition") == 0) {
+            part.name = header_param(value, "name");
+            part.filename = header_param(value, "filename");
+        } else if (strcasecmp(name.c_str(), "Content-Type") == 0) {
+            part.content_type = value;
+        }
+    }
+
+    // 带文件名的字段落盘，其余字段留在内存
+    if (!part.filename.empty()) {
+        std::string path = temp_dir_ + "/upload_XXXXXX";
+        std::vector<char> tmpl(path.begin(), path.end());
+        tmpl.push_back('\0');
+        current_fd_ = mkstemp(tmpl.data());
+        if (current_fd_ < 0) {
+            return false;
+        }
+        if (digest_ == nullptr || EVP_DigestInit_ex(digest_, EVP_sha256(), nullptr) != 1) {
+            close(current_fd_);
+            current_fd_ = -1;
+            unlink(tmpl.data());
+            return false;
+        }
+        part.temp_path = tmpl.data();
+    }
+
+    parts_.push_back(std::move(part));
+    return true;
+}
+
+bool MultipartParser::write_body(const char* data, size_t len) {
+    if (len == 0) {
+        return true;
+    }
+
+    MultipartPart& part = parts_.back();
+    part.size += len;
+
+    if (current_fd_ < 0) {
+        if (part.value.size() + len > kMaxFieldSize) {
+            return false;
+        }
+        part.value.append(data, len);
+        return true;
+    }
+
+    if (EVP_DigestUpdate(digest_, data, len) != 1) {
+        return false;
+    }
+    while (len > 0) {
+        ssize_t n = write(current_fd_, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool MultipartParser::end_part() {
+    if (current_fd_ >= 0) {
+        int rc = close(current_fd_);
+        current_fd_ = -1;
+
+        unsigned char hash[EVP_MAX_MD_SIZE];
+        unsigned int hash_len = 0;
+        if (EVP_DigestFinal_ex(digest_, hash, &hash_len) != 1) {
+            return false;
+        }
+        static const char hex[] = "0123456789abcdef";
+        std::string& sha256 = parts_.back().sha256;
+        sha256.reserve(hash_len * 2);
+        for (unsigned int i = 0; i < hash_len; ++i) {
+            sha256 += hex[hash[i] >> 4];
+            sha256 += hex[hash[i] & 0xF];
+        }
+        return rc == 0;
+    }
+    return true;
+}
+
+void MultipartParser::fail() {
+    state_ = State::Error;
+    buffer_.clear();
+}
+
+std::vector<MultipartPart> MultipartParser::take_parts() {
+    std::vector<MultipartPart> parts;
+    parts.swap(parts_);
+    return parts;
+}
@@ -0,0 +1,164 @@
+#include "password_hasher.h"
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <future>
+#include <memory>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+
+// 当前参数：N=2^15、r=8、p=1，约32MB内存，单核约50~150ms
+const int kScryptLogN = 15;
+const int kScryptR = 8;
+const int kScryptP = 1;
+const size_t kSaltSize = 16;
+const size_t kHashSize = 32;
+const uint64_t kMaxMemory = 256ull * 1024 * 1024;   // 校验时接受的最大参数
+
+std::string to_hex(const unsigned char* data, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(len * 2);
+    for (size_t i = 0; i < len; ++i) {
+        out += hex[data[i] >> 4];
+        out += hex[data[i] & 0xF];
+    }
+    return out;
+}
+
+bool from_hex(const std::string& text, std::vector<unsigned char>& out) {
+    if (text.empty() || text.size() % 2 != 0) {
+        return false;
+    }
+    out.clear();
+    for (size_t i = 0; i < text.size(); i += 2) {
+        char* end = nullptr;
+        std::string byte = text.substr(i, 2);
+        long value = strtol(byte.c_str(), &end, 16);
+        if (*end != '\0') {
+            return false;
+        }
+        out.push_back(static_cast<unsigned char>(value));
+    }
+    return true;
+}
+
+bool scrypt(const std::string& password, const unsigned char* salt, size_t salt_len,
+            int log_n, int r, int p, unsigned char* out, size_t out_len) {
+    return EVP_PBE_scrypt(password.data(), password.size(), salt, salt_len,
+                          1ull << log_n, r, p, kMaxMemory, out, out_len) == 1;
+}
+
+// 旧版本的密码哈希：无盐SHA-256的十六进制
+std::string legacy_sha256(const std::string& password) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int len = 0;
+    EVP_Digest(password.data(), password.size(), digest, &len, EVP_sha256(), nullptr);
+    return to_hex(digest, len);
+}
+
+bool constant_time_equal(const std::string& a, const std::string& b) {
+    return a.size() == b.size() && CRYPTO_memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+// 在线程池中执行f并等待结果；排队已满时返回Busy
+template <typename F>
+PasswordHasher::Result run_in_pool(ThreadPool& pool, F f) {
+    auto promise = std::make_shared<std::promise<PasswordHasher::Result>>();
+    std::future<PasswordHasher::Result> result = promise->get_future();
+    if (!pool.submit([promise, f]() { promise->set_value(f()); })) {
+        return PasswordHasher::Result::Busy;
+    }
+    return result.get();
+}
+
+} // namespace
+
+PasswordHasher::PasswordHasher(size_t threads, size_t max_queue) : pool_(threads, max_queue) {
+    // 在KDF线程中提前生成占位哈希，第一次用户名不存在的登录不必多等一次哈希计算
+    pool_.submit([]() { dummy_hash(); });
+}
+
+const std::string& PasswordHasher::dummy_hash() {
+    // 首次调用时按当前参数生成一次，之后所有线程共用
+    static const std::string dummy = []() {
+        std::string encoded;
+        hash_now("dummy password for unknown users", encoded);
+        return encoded;
+    }();
+    return dummy;
+}
+
+PasswordHasher::Result PasswordHasher::hash(const std::string& password, std::string& encoded) {
+    std::string* output = &encoded;
+    return run_in_pool(pool_, [&password, output]() {
+        return hash_now(password, *output) ? Result::Match : Result::Mismatch;
+    });
+}
+
+PasswordHasher::Result PasswordHasher::verify(const std::string& password, const std::string& encoded) {
+    return run_in_pool(pool_, [&password, &encoded]() { return verify_now(password, encoded); });
+}
+
+PasswordHasher::Result PasswordHasher::verify_dummy(const std::string& password) {
+    Result result = verify(password, dummy_hash());
+    return result == Result::Busy ? Result::Busy : Result::Mismatch;
+}
+
+bool PasswordHasher::hash_now(const std::string& password, std::string& encoded) {
+    unsigned char salt[kSaltSize];
+    unsigned char hash[kHashSize];
+    if (RAND_bytes(salt, sizeof(salt)) != 1 ||
+        !scrypt(password, salt, sizeof(salt), kScryptLogN, kScryptR, kScryptP, hash, sizeof(hash))) {
+        return false;
+    }
+    encoded = "scrypt$" + std::to_string(kScryptLogN) + "$" + std::to_string(kScryptR) + "$" +
+              std::to_string(kScryptP) + "$" + to_hex(salt, sizeof(salt)) + "$" + to_hex(hash, sizeof(hash));
+    return true;
+}
+
+PasswordHasher::Result PasswordHasher::verify_now(const std::string& password, const std::string& encoded) {
+    if (encoded.compare(0, 7, "scrypt$") != 0) {
+        // 旧格式：64位十六进制的SHA-256
+        if (encoded.size() == 64 && constant_time_equal(legacy_sha256(password), encoded)) {
+            return Result::MatchNeedsRehash;
+        }
+        return Result::Mismatch;
+    }
+
+    // scrypt$logN$r$p$salt$hash
+    std::vector<std::string> fields;
+    size_t start = 7;
+    while (fields.size() < 5) {
+        size_t end = encoded.find('$', start);
+        fields.push_back(encoded.substr(start, end == std::string::npos ? std::string::npos : end - start));
+        if (end == std::string::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+    if (fields.size() != 5) {
+        return Result::Mismatch;
+    }
+
+    int log_n = atoi(fields[0].c_str());
+    int r = atoi(fields[1].c_str());
+    int p = atoi(fields[2].c_str());
+    std::vector<unsigned char> salt;
+    std::vector<unsigned char> expected;
+    if (log_n < 1 || log_n > 24 || r < 1 || p < 1 ||
+        !from_hex(fields[3], salt) || !from_hex(fields[4], expected)) {
+        return Result::Mismatch;
+    }
+
+    std::vector<unsigned char> actual(expected.size());
+    if (!scrypt(password, salt.data(), salt.size(), log_n, r, p, actual.data(), actual.size()) ||
+        CRYPTO_memcmp(actual.data(), expected.data(), expected.size()) != 0) {
+        return Result::Mismatch;
+    }
+
+    bool current = log_n == kScryptLogN && r == kScryptR && p == kScryptP;
+    return current ? Result::Match : Result::MatchNeedsRehash;
+}
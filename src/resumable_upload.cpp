@@ -0,0 +1,336 @@
+#include "resumable_upload.h"
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace {
+
+const size_t kReadBufferSize = 1024 * 1024;     // 完成时读回文件计算哈希的缓冲区
+
+std::string random_id() {
+    unsigned char bytes[16];
+    if (RAND_bytes(bytes, sizeof(bytes)) != 1) {
+        return "";
+    }
+    static const char hex[] = "0123456789abcdef";
+    std::string id;
+    for (unsigned char b : bytes) {
+        id += hex[b >> 4];
+        id += hex[b & 0xF];
+    }
+    return id;
+}
+
+// 解析 "sha256 <base64>"（tus校验和扩展的格式）
+bool parse_checksum(const std::string& header, unsigned char* digest, size_t digest_len) {
+    if (header.compare(0, 7, "sha256 ") != 0) {
+        return false;
+    }
+    std::string encoded = header.substr(7);
+    encoded.erase(0, encoded.find_first_not_of(' '));
+    encoded.erase(encoded.find_last_not_of(" \t\r") + 1);
+    if (encoded.empty() || encoded.size() % 4 != 0) {
+        return false;
+    }
+
+    // EVP_DecodeBlock不处理填充，解码长度按补齐的'='扣除
+    std::vector<unsigned char> decoded(encoded.size() / 4 * 3);
+    int len = EVP_DecodeBlock(decoded.data(), reinterpret_cast<const unsigned char*>(encoded.data()),
+                              static_cast<int>(encoded.size()));
+    if (len < 0) {
+        return false;
+    }
+    size_t padding = encoded.size() - (encoded.find_last_not_of('=') + 1);
+    if (static_cast<size_t>(len) - padding != digest_len) {
+        return false;
+    }
+    std::copy(decoded.begin(), decoded.begin() + digest_len, digest);
+    return true;
+}
+
+} // namespace
+
+ResumableUpload::~ResumableUpload() {
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!temp_path.empty()) {
+        unlink(temp_path.c_str());  // 完成的上传已改名到内容存储，这里返回ENOENT
+    }
+}
+
+ResumableUploads::ResumableUploads(const std::string& temp_dir) : temp_dir_(temp_dir) {
+}
+
+ResumableUploads::~ResumableUploads() {
+}
+
+ResumableUploads::Status ResumableUploads::create(int user_id, const std::string& filename,
+                                                  const std::string& file_type, const std::string& category,
+                                                  long size, size_t chunk_size, long available,
+                                                  std::shared_ptr<ResumableUpload>& upload) {
+    if (size <= 0) {
+        return Status::BadRequest;
+    }
+    if (chunk_size == 0) {
+        chunk_size = kDefaultChunkSize;
+    }
+    if (chunk_size < kMinChunkSize || chunk_size > kMaxChunkSize) {
+        return Status::BadRequest;
+    }
+
+    auto created = std::make_shared<ResumableUpload>();
+    created->id = random_id();
+    if (created->id.empty()) {
+        return Status::Failed;
+    }
+    time_t now = time(nullptr);
+    created->user_id = user_id;
+    created->filename = filename;
+    created->file_type = file_type;
+    created->category = category;
+    created->size = size;
+    created->chunk_size = chunk_size;
+    created->chunks.assign((size + chunk_size - 1) / chunk_size, Missing);
+    created->last_active = now;
+
+    // 检查数量和配额后立即插入，占住名额和预留空间；并发的创建请求在同一把锁下看到彼此，
+    // 不会一起越过上限。预分配失败时再删除
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sweep_locked(now);
+        size_t mine = std::count_if(uploads_.begin(), uploads_.end(), [user_id](const auto& item) {
+            return item.second->user_id == user_id;
+        });
+        if (uploads_.size() >= kMaxSessions || mine >= kMaxSessionsPerUser) {
+            return Status::TooMany;
+        }
+        if (reserved_bytes_locked(user_id) + size > available) {
+            return Status::QuotaExceeded;
+        }
+        uploads_[created->id] = created;
+    }
+
+    created->temp_path = temp_dir_ + "/resumable_" + created->id;
+    created->fd = open(created->temp_path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (created->fd < 0) {
+        created->temp_path.clear();
+        std::cerr << "创建续传临时文件失败: " << temp_dir_ << std::endl;
+        remove(created->id);
+        return Status::Failed;
+    }
+
+    // 一次预分配全部空间：磁盘不足在创建时就能发现，并行写入的各块也不会产生碎片
+    int rc = fallocate(created->fd, 0, 0, size);
+    if (rc != 0 && (errno == EOPNOTSUPP || errno == ENOSYS)) {
+        rc = ftruncate(created->fd, size);
+    }
+    if (rc != 0) {
+        std::cerr << "续传临时文件预分配失败: " << size << " 字节" << std::endl;
+        remove(created->id);
+        return Status::Failed;
+    }
+
+    upload = created;
+    return Status::Ok;
+}
+
+std::shared_ptr<ResumableUpload> ResumableUploads::find(const std::string& id, int user_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = uploads_.find(id);
+    if (it == uploads_.end() || it->second->user_id != user_id) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+ResumableUploads::Status ResumableUploads::write_chunk(ResumableUpload& upload, long offset,
+                                                       const std::string& data, const std::string& checksum) {
+    if (offset < 0 || offset >= upload.size || offset % upload.chunk_size != 0) {
+        return Status::BadRequest;
+    }
+    size_t index = offset / upload.chunk_size;
+    size_t expected = std::min<size_t>(upload.chunk_size, upload.size - offset);
+    if (data.size() != expected) {
+        return Status::BadRequest;
+    }
+
+    // 校验和在占用块之前检查，传坏的块不影响其他连接重传同一块
+    unsigned char claimed[32];
+    unsigned char actual[EVP_MAX_MD_SIZE];
+    unsigned int actual_len = 0;
+    if (!parse_checksum(checksum, claimed, sizeof(claimed))) {
+        return Status::BadRequest;
+    }
+    if (EVP_Digest(data.data(), data.size(), actual, &actual_len, EVP_sha256(), nullptr) != 1 ||
+        actual_len != sizeof(claimed) || CRYPTO_memcmp(actual, claimed, sizeof(claimed)) != 0) {
+        return Status::ChecksumMismatch;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(upload.mutex);
+        upload.last_active = time(nullptr);
+        if (upload.chunks[index] == Received) {
+            return Status::Ok;
+        }
+        if (upload.chunks[index] == Writing || upload.finishing) {
+            return Status::Conflict;
+        }
+        upload.chunks[index] = Writing;
+        ++upload.writing_chunks;
+    }
+
+    // 各块偏移互不重叠，多个连接可以同时pwrite同一个文件
+    const char* p = data.data();
+    size_t remaining = data.size();
+    off_t position = offset;
+    bool ok = true;
+    while (remaining > 0) {
+        ssize_t n = pwrite(upload.fd, p, remaining, position);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ok = false;
+            break;
+        }
+        p += n;
+        position += n;
+        remaining -= n;
+    }
+
+    std::lock_guard<std::mutex> lock(upload.mutex);
+    --upload.writing_chunks;
+    if (!ok) {
+        upload.chunks[index] = Missing;
+        std::cerr << "续传块写入失败: " << upload.id << " 块 " << index << std::endl;
+        return Status::Failed;
+    }
+    upload.chunks[index] = Received;
+    ++upload.received_chunks;
+    return Status::Ok;
+}
+
+void ResumableUploads::progress(ResumableUpload& upload, UploadProgress& progress) {
+    std::lock_guard<std::mutex> lock(upload.mutex);
+    progress.size = upload.size;
+    progress.chunk_size = upload.chunk_size;
+    progress.received_bytes = 0;
+    progress.offset = -1;
+    progress.missing.clear();
+    for (size_t i = 0; i < upload.chunks.size(); ++i) {
+        long start = static_cast<long>(i * upload.chunk_size);
+        if (upload.chunks[i] == Received) {
+            progress.received_bytes += std::min<long>(upload.chunk_size, upload.size - start);
+            continue;
+        }
+        if (progress.offset < 0) {
+            progress.offset = start;
+        }
+        if (progress.missing.size() < kMaxMissingListed) {
+            progress.missing.push_back(i);
+        }
+    }
+    if (progress.offset < 0) {
+        progress.offset = upload.size;
+    }
+}
+
+ResumableUploads::Status ResumableUploads::finish(ResumableUpload& upload, std::string& sha256) {
+    {
+        std::lock_guard<std::mutex> lock(upload.mutex);
+        if (upload.finishing || upload.writing_chunks > 0) {
+            return Status::Conflict;
+        }
+        if (upload.received_chunks != upload.chunks.size()) {
+            return Status::Incomplete;
+        }
+        upload.finishing = true;
+        upload.last_active = time(nullptr);
+    }
+
+    // 各块是乱序到达的，整个文件的哈希只能在全部写完后读回计算；刚写入的数据大多仍在页缓存中
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (ctx == nullptr || EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) != 1) {
+        EVP_MD_CTX_free(ctx);
+        return Status::Failed;
+    }
+    posix_fadvise(upload.fd, 0, upload.size, POSIX_FADV_SEQUENTIAL);
+    std::vector<char> buffer(kReadBufferSize);
+    off_t position = 0;
+    bool ok = true;
+    while (position < upload.size) {
+        ssize_t n = pread(upload.fd, buffer.data(), buffer.size(), position);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0 || EVP_DigestUpdate(ctx, buffer.data(), n) != 1) {
+            ok = false;
+            break;
+        }
+        position += n;
+    }
+
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int hash_len = 0;
+    ok = ok && EVP_DigestFinal_ex(ctx, hash, &hash_len) == 1;
+    EVP_MD_CTX_free(ctx);
+    if (!ok) {
+        std::cerr << "续传文件读回失败: " << upload.id << std::endl;
+        return Status::Failed;
+    }
+
+    static const char hex[] = "0123456789abcdef";
+    sha256.clear();
+    for (unsigned int i = 0; i < hash_len; ++i) {
+        sha256 += hex[hash[i] >> 4];
+        sha256 += hex[hash[i] & 0xF];
+    }
+    return Status::Ok;
+}
+
+void ResumableUploads::remove(const std::string& id) {
+    // 正在处理的请求仍持有会话时，临时文件等最后一个引用释放后再删除
+    std::lock_guard<std::mutex> lock(mutex_);
+    uploads_.erase(id);
+}
+
+size_t ResumableUploads::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return uploads_.size();
+}
+
+long ResumableUploads::reserved_bytes(int user_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return reserved_bytes_locked(user_id);
+}
+
+long ResumableUploads::reserved_bytes_locked(int user_id) const {
+    long reserved = 0;
+    for (const auto& item : uploads_) {
+        if (item.second->user_id == user_id) {
+            reserved += item.second->size;
+        }
+    }
+    return reserved;
+}
+
+void ResumableUploads::sweep_locked(time_t now) {
+    for (auto it = uploads_.begin(); it != uploads_.end();) {
+        time_t last_active;
+        {
+            std::lock_guard<std::mutex> lock(it->second->mutex);
+            last_active = it->second->last_active;
+        }
+        if (now - last_active > kIdleTimeout) {
+            it = uploads_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,225 @@
+#include "router.h"
+#include <iostream>
+
+namespace {
+
+// 取出下一段路径：segment为第一个'/'之前的部分，rest为其后剩余部分；没有剩余段时has_rest为false
+inline void split_segment(std::string_view path, std::string_view& segment, std::string_view& rest, bool& has_rest) {
+    size_t slash = path.find('/');
+    if (slash == std::string_view::npos) {
+        segment = path;
+        rest = std::string_view();
+        has_rest = false;
+    } else {
+        segment = path.substr(0, slash);
+        rest = path.substr(slash + 1);
+        has_rest = true;
+    }
+}
+
+} // namespace
+
+const RouteEntry* Router::Node::find_entry(HttpMethod method) const {
+    if (method == HttpMethod::Unknown) {
+        return nullptr;
+    }
+    const RouteEntry* found = &entries[static_cast<size_t>(method)];
+    if (!found->handler && method == HttpMethod::HEAD) {
+        // 没有单独注册HEAD时由GET处理器处理，响应体由服务器丢弃
+        found = &entries[static_cast<size_t>(HttpMethod::GET)];
+    }
+    return found->handler ? found : nullptr;
+}
+
+bool Router::Node::has_handler(HttpMethod method) const {
+    return find_entry(method) != nullptr;
+}
+
+bool Router::Node::has_any_handler() const {
+    for (size_t i = 0; i < kMethodCount; ++i) {
+        if (entries[i].handler) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Router::Router() : root_(std::make_unique<Node>()) {
+}
+
+Router::~Router() {
+}
+
+HttpMethod Router::parse_method(std::string_view method) {
+    switch (method.size()) {
+        case 3:
+            if (method == "GET") return HttpMethod::GET;
+            if (method == "PUT") return HttpMethod::PUT;
+            break;
+        case 4:
+            if (method == "POST") return HttpMethod::POST;
+            if (method == "HEAD") return HttpMethod::HEAD;
+            break;
+        case 5:
+            if (method == "PATCH") return HttpMethod::PATCH;
+            break;
+        case 6:
+            if (method == "DELETE") return HttpMethod::DELETE;
+            break;
+        case 7:
+            if (method == "OPTIONS") return HttpMethod::OPTIONS;
+            break;
+    }
+    return HttpMethod::Unknown;
+}
+
+const char* Router::method_name(HttpMethod method) {
+    switch (method) {
+        case HttpMethod::GET: return "GET";
+        case HttpMethod::HEAD: return "HEAD";
+        case HttpMethod::POST: return "POST";
+        case HttpMethod::PUT: return "PUT";
+        case HttpMethod::PATCH: return "PATCH";
+        case HttpMethod::DELETE: return "DELETE";
+        case HttpMethod::OPTIONS: return "OPTIONS";
+        default: return "";
+    }
+}
+
+RouteEntry& Router::entry(HttpMethod method, const std::string& pattern) {
+    Node* node = root_.get();
+    std::string_view rest(pattern);
+    if (!rest.empty() && rest.front() == '/') {
+        rest.remove_prefix(1);
+    }
+    
+    // 根路径"/"直接落在根节点上
+    bool has_rest = !rest.empty();
+    while (has_rest) {
+        std::string_view segment;
+        split_segment(rest, segment, rest, has_rest);
+        
+        if (!segment.empty() && segment.front() == ':') {
+            if (!node->param_child) {
+                node->param_child = std::make_unique<Node>();
+                node->param_name = std::string(segment.substr(1));
+            } else if (node->param_name != segment.substr(1)) {
+                std::cerr << "路由参数名冲突: " << pattern << std::endl;
+            }
+            node = node->param_child.get();
+        } else if (!segment.empty() && segment.front() == '*') {
+            if (!node->wildcard_child) {
+                node->wildcard_child = std::make_unique<Node>();
+                node->wildcard_name = std::string(segment.substr(1));
+            }
+            node = node->wildcard_child.get();
+            break;  // 通配段之后的模式没有意义
+        } else {
+            Node* next = nullptr;
+            for (auto& child : node->children) {
+                if (child->segment == segment) {
+                    next = child.get();
+                    break;
+                }
+            }
+            if (next == nullptr) {
+                node->children.push_back(std::make_unique<Node>());
+                next = node->children.back().get();
+                next->segment = std::string(segment);
+            }
+            node = next;
+        }
+    }
+    
+    return node->entries[static_cast<size_t>(method == HttpMethod::Unknown ? HttpMethod::GET : method)];
+}
+
+const Router::Node* Router::match_node(const Node* node, std::string_view rest, HttpMethod method,
+                                       bool any_method, RouteParams& params) const {
+    auto accepts = [&](const Node* candidate) {
+        return any_method ? candidate->has_any_handler() : candidate->has_handler(method);
+    };
+    
+    std::string_view segment;
+    std::string_view remaining;
+    bool has_rest;
+    split_segment(rest, segment, remaining, has_rest);
+    
+    for (const auto& child : node->children) {
+        if (child->segment == segment) {
+            const Node* found = has_rest ? match_node(child.get(), remaining, method, any_method, params)
+                                         : (accepts(child.get()) ? child.get() : nullptr);
+            if (found != nullptr) {
+                return found;
+            }
+            break;
+        }
+    }
+    
+    if (node->param_child && !segment.empty() && params.count < RouteParams::kMaxParams) {
+        params.items[params.count++] = {node->param_name, segment};
+        const Node* child = node->param_child.get();
+        const Node* found = has_rest ? match_node(child, remaining, method, any_method, params)
+                                     : (accepts(child) ? child : nullptr);
+        if (found != nullptr) {
+            return found;
+        }
+        params.count--;
+    }
+    
+    if (node->wildcard_child && accepts(node->wildcard_child.get()) && params.count < RouteParams::kMaxParams) {
+        params.items[params.count++] = {node->wildcard_name, rest};
+        return node->wildcard_child.get();
+    }
+    
+    return nullptr;
+}
+
+Router::Result Router::match(HttpMethod method, std::string_view path, const RouteEntry*& entry,
+                             RouteParams& params, std::string* allow) const {
+    entry = nullptr;
+    params.count = 0;
+    if (path.empty() || path.front() != '/') {
+        return Result::NotFound;
+    }
+    path.remove_prefix(1);
+    
+    const Node* node;
+    if (path.empty()) {
+        node = root_->has_handler(method) ? root_.get() : nullptr;
+    } else {
+        node = match_node(root_.get(), path, method, false, params);
+    }
+    if (node != nullptr) {
+        entry = node->find_entry(method);
+        return Result::Found;
+    }
+    
+    // 换用任意方法再匹配一次，区分405和404
+    params.count = 0;
+    if (path.empty()) {
+        node = root_->has_any_handler() ? root_.get() : nullptr;
+    } else {
+        node = match_node(root_.get(), path, method, true, params);
+    }
+    params.count = 0;
+    if (node == nullptr) {
+        return Result::NotFound;
+    }
+    
+    if (allow != nullptr) {
+        allow->clear();
+        for (size_t i = 0; i < kMethodCount; ++i) {
+            if (node->entries[i].handler) {
+                if (!allow->empty()) {
+                    *allow += ", ";
+                }
+                *allow += method_name(static_cast<HttpMethod>(i));
+                if (static_cast<HttpMethod>(i) == HttpMethod::GET && !node->entries[static_cast<size_t>(HttpMethod::HEAD)].handler) {
+                    *allow += ", HEAD";
+                }
+            }
+        }
+    }
+    return Result::MethodNotAllowed;
+}
@@ -1,9 +1,12 @@
 #include "server.h"
+#include "compression.h"
+#include "http_parser.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <iostream>
 #include <sstream>
 #include <algorithm>
@@ -11,81 +14,340 @@
 #include <fstream>
 #include <cstring>
 #include <vector>
+#include <ctime>
+#include <random>
+#include <stdexcept>
+#include <filesystem>
 
-HttpServer::HttpServer(int port) : port_(port), server_fd_(-1), running_(false) {
+namespace {
+
+// 单个字节区间 [start, start + length)
+struct ByteRange {
+    size_t start;
+    size_t length;
+};
+
+const size_t kMaxRanges = 16;   // 超过该数量的Range请求按整体返回，避免被拆成大量碎片
+
+const size_t kCompressMinSize = 1024;                   // 小于此大小的动态响应不压缩
+// 动态响应整体压缩到第二个缓冲区，超过此大小的按原样发送，限制单个请求的峰值内存
+const size_t kCompressMaxSize = 4 * 1024 * 1024;
+
+std::string format_http_date(time_t t) {
+    char buf[64];
+    struct tm tm_utc;
+    gmtime_r(&t, &tm_utc);
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm_utc);
+    return buf;
+}
+
+std::string trim_spaces(const std::string& str) {
+    size_t begin = str.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = str.find_last_not_of(" \t");
+    return str.substr(begin, end - begin + 1);
+}
+
+bool parse_size(const std::string& str, size_t& value) {
+    if (str.empty() || str.size() > 18) {
+        return false;
+    }
+    value = 0;
+    for (char c : str) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + (c - '0');
+    }
+    return true;
+}
+
+/**
+ * 解析Range请求头
+ * 返回false表示格式无法识别，按RFC 7233应忽略Range并返回完整内容；
+ * 返回true且ranges为空表示所有区间都不可满足（416）
+ */
+bool parse_range_header(const std::string& header, size_t entity_size, std::vector<ByteRange>& ranges) {
+    ranges.clear();
+    std::string value = trim_spaces(header);
+    if (value.compare(0, 6, "bytes=") != 0) {
+        return false;
+    }
+
+    std::istringstream ss(value.substr(6));
+    std::string spec;
+    size_t spec_count = 0;
+    while (std::getline(ss, spec, ',')) {
+        spec = trim_spaces(spec);
+        if (spec.empty()) {
+            continue;
+        }
+        if (++spec_count > kMaxRanges) {
+            return false;
+        }
+
+        size_t dash = spec.find('-');
+        if (dash == std::string::npos) {
+            return false;
+        }
+        std::string first = spec.substr(0, dash);
+        std::string last = spec.substr(dash + 1);
+
+        if (first.empty()) {
+            // 后缀区间：最后N个字节
+            size_t suffix;
+            if (!parse_size(last, suffix)) {
+                return false;
+            }
+            if (suffix == 0 || entity_size == 0) {
+                continue;
+            }
+            suffix = std::min(suffix, entity_size);
+            ranges.push_back({entity_size - suffix, suffix});
+            continue;
+        }
+
+        size_t start;
+        if (!parse_size(first, start)) {
+            return false;
+        }
+        size_t end = entity_size > 0 ? entity_size - 1 : 0;
+        if (!last.empty()) {
+            size_t requested_end;
+            if (!parse_size(last, requested_end) || requested_end < start) {
+                return false;
+            }
+            end = std::min(end, requested_end);
+        }
+        if (start >= entity_size) {
+            continue;  // 该区间不可满足
+        }
+        ranges.push_back({start, end - start + 1});
+    }
+
+    return spec_count > 0;
+}
+
+std::string make_boundary() {
+    static thread_local std::mt19937_64 gen(std::random_device{}());
+    std::ostringstream oss;
+    oss << "112share_" << std::hex << gen();
+    return oss.str();
+}
+
+// 解析HTTP日期（RFC 7231 IMF-fixdate）
+bool parse_http_date(const std::string& value, time_t& t) {
+    struct tm tm_utc;
+    memset(&tm_utc, 0, sizeof(tm_utc));
+    const char* end = strptime(value.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm_utc);
+    if (end == nullptr) {
+        return false;
+    }
+    t = timegm(&tm_utc);
+    return true;
+}
+
+// If-None-Match列表中是否有与etag匹配的项（弱比较，忽略W/前缀）
+bool etag_list_matches(const std::string& list, const std::string& etag) {
+    std::string target = etag.compare(0, 2, "W/") == 0 ? etag.substr(2) : etag;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string item = trim_spaces(list.substr(pos, end - pos));
+        pos = end + 1;
+        if (item == "*") {
+            return true;
+        }
+        if (item.compare(0, 2, "W/") == 0) {
+            item.erase(0, 2);
+        }
+        if (item == target) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+HttpServer::HttpServer(int port)
+    : port_(port), server_fd_(-1), upload_temp_dir_("/tmp"), running_(false),
+      io_threads_(0), worker_threads_(0), max_queue_size_(1024),
+      keep_alive_timeout_(15), max_keep_alive_requests_(1000), send_timeout_(30) {
 }
 
 HttpServer::~HttpServer() {
     stop();
 }
 
-bool HttpServer::start() {
-    server_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd_ < 0) {
+void HttpServer::setIoThreads(int threads) {
+    io_threads_ = threads;
+}
+
+void HttpServer::setWorkerThreads(size_t threads, size_t max_queue_size) {
+    worker_threads_ = threads;
+    max_queue_size_ = max_queue_size;
+}
+
+void HttpServer::setKeepAlive(int idle_timeout_seconds, int max_requests) {
+    keep_alive_timeout_ = idle_timeout_seconds;
+    max_keep_alive_requests_ = max_requests;
+}
+
+void HttpServer::setSendTimeout(int seconds) {
+    send_timeout_ = seconds;
+}
+
+void HttpServer::setRouteConcurrency(const std::string& method, const std::string& path, int max_inflight) {
+    RouteEntry* entry = register_route(method, path);
+    if (entry != nullptr) {
+        entry->limit = std::make_unique<RouteLimit>(max_inflight);
+    }
+}
+
+RouteEntry* HttpServer::register_route(const std::string& method, const std::string& path) {
+    // 路由树在start()之后只读，工作线程匹配时不加锁
+    if (running_) {
+        std::cerr << "服务器运行中，忽略路由注册: " << method << " " << path << std::endl;
+        return nullptr;
+    }
+    HttpMethod m = Router::parse_method(method);
+    if (m == HttpMethod::Unknown) {
+        std::cerr << "不支持的请求方法: " << method << std::endl;
+        return nullptr;
+    }
+    return &router_.entry(m, path);
+}
+
+const RouteEntry* HttpServer::match_raw_path(std::string_view method, std::string_view raw_path) const {
+    // 请求行中的路径尚未解码，而handleRoute按解码后的路径分发；这里按同样的路径匹配，
+    // 否则 /api/%75pload 这类编码过的路径会绕过并发限制和上传的流式处理，却仍然到达同一个处理器
+    const RouteEntry* entry;
+    RouteParams params;
+    Router::Result result;
+    if (raw_path.find('%') == std::string_view::npos) {
+        result = router_.match(Router::parse_method(method), raw_path, entry, params);
+    } else {
+        std::string decoded = url_decode(std::string(raw_path));
+        result = router_.match(Router::parse_method(method), decoded, entry, params);
+    }
+    return result == Router::Result::Found ? entry : nullptr;
+}
+
+RouteLimit* HttpServer::find_route_limit(std::string_view method, std::string_view path) const {
+    const RouteEntry* entry = match_raw_path(method, path);
+    return entry != nullptr ? entry->limit.get() : nullptr;
+}
+
+bool HttpServer::route_saturated(std::string_view method, std::string_view path) const {
+    RouteLimit* limit = find_route_limit(method, path);
+    return limit != nullptr && limit->inflight.load() >= limit->max_inflight;
+}
+
+int HttpServer::create_listener() {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
         std::cerr << "创建套接字失败" << std::endl;
-        return false;
+        return -1;
     }
     
     int opt = 1;
-    if (setsockopt(server_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1) {
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1 ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1) {
         std::cerr << "设置套接字选项失败" << std::endl;
-        close(server_fd_);
-        return false;
+        close(fd);
+        return -1;
     }
     
     struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
     address.sin_port = htons(port_);
     
-    if (bind(server_fd_, (struct sockaddr*)&address, sizeof(address)) == -1) {
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
         std::cerr << "绑定地址失败" << std::endl;
-        close(server_fd_);
-        return false;
+        close(fd);
+        return -1;
     }
     
-    if (listen(server_fd_, 10) == -1) {
+    if (listen(fd, SOMAXCONN) == -1) {
         std::cerr << "监听失败" << std::endl;
-        close(server_fd_);
-        return false;
+        close(fd);
+        return -1;
     }
     
-    running_ = true;
+    return fd;
+}
+
+bool HttpServer::start() {
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    int io_threads = io_threads_ > 0 ? io_threads_ : static_cast<int>(cores);
+    size_t worker_threads = worker_threads_ > 0 ? worker_threads_ : cores * 2;
+    
+    // 每个事件循环一个监听套接字，由内核通过SO_REUSEPORT分发新连接
+    for (int i = 0; i < io_threads; ++i) {
+        int fd = create_listener();
+        if (fd < 0) {
+            loops_.clear();
+            return false;
+        }
+        
+        auto loop = std::make_unique<EventLoop>(this, fd);
+        if (!loop->init()) {
+            loops_.clear();
+            return false;
+        }
+        loops_.push_back(std::move(loop));
+    }
     
-    std::thread accept_thread([this]() {
-        while (running_) {
-            struct sockaddr_in client_addr;
-            socklen_t client_len = sizeof(client_addr);
-            
-            int client_fd = accept(server_fd_, (struct sockaddr*)&client_addr, &client_len);
-            if (client_fd == -1) {
-                if (running_) {
-                    std::cerr << "接受连接失败" << std::endl;
-                }
-                continue;
-            }
-            
-            std::thread client_thread([this, client_fd]() {
-                handle_client(client_fd);
-            });
-            client_thread.detach();
+    if (!static_root_.empty()) {
+        asset_cache_ = std::make_unique<AssetCache>(static_root_, [this](const std::string& type) {
+            return is_compressible(type);
+        });
+        if (!asset_cache_->start()) {
+            asset_cache_.reset();
         }
-    });
-    accept_thread.detach();
+    }
+    
+    worker_pool_ = std::make_unique<ThreadPool>(worker_threads, max_queue_size_);
+    running_ = true;
     
-    std::cout << "HTTP服务器在端口 " << port_ << " 启动成功" << std::endl;
+    for (auto& loop : loops_) {
+        EventLoop* raw = loop.get();
+        loop_threads_.emplace_back([raw]() { raw->run(); });
+    }
+    
+    std::cout << "HTTP服务器在端口 " << port_ << " 启动成功 (事件循环: " << io_threads
+              << ", 工作线程: " << worker_threads << ", 请求解析: " << HttpParser::simd_level() << ")" << std::endl;
     return true;
 }
 
 void HttpServer::stop() {
-    if (running_) {
-        running_ = false;
-        
-        if (server_fd_ >= 0) {
-            close(server_fd_);
-            server_fd_ = -1;
+    if (!running_.exchange(false)) {
+        return;
+    }
+    
+    for (auto& loop : loops_) {
+        loop->stop();
+    }
+    for (auto& thread : loop_threads_) {
+        if (thread.joinable() && thread.get_id() != std::this_thread::get_id()) {
+            thread.join();
         }
     }
+    
+    if (worker_pool_) {
+        worker_pool_->shutdown();
+    }
+    if (asset_cache_) {
+        asset_cache_->stop();
+    }
 }
 
 bool HttpServer::is_running() const {
@@ -93,211 +355,483 @@ bool HttpServer::is_running() const {
 }
 
 void HttpServer::addRoute(const std::string& method, const std::string& path, RouteHandler handler) {
-    std::lock_guard<std::mutex> lock(routes_mutex_);
-    routes_[method + " " + path] = handler;
+    RouteEntry* entry = register_route(method, path);
+    if (entry != nullptr) {
+        entry->handler = std::move(handler);
+    }
 }
 
 void HttpServer::setStaticRoot(const std::string& root) {
     static_root_ = root;
 }
 
-void HttpServer::handle_client(int client_fd) {
-    // 先读取HTTP头部来确定Content-Length
-    std::string headers;
-    char buffer[4096];
-    ssize_t total_read = 0;
-    bool headers_complete = false;
+void HttpServer::setUploadTempDir(const std::string& dir) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "创建上传临时目录失败: " << dir << " (" << ec.message() << ")" << std::endl;
+        return;
+    }
+    upload_temp_dir_ = dir;
+}
+
+bool HttpServer::is_upload_route(std::string_view method, std::string_view path) const {
+    const RouteEntry* entry = match_raw_path(method, path);
+    return entry != nullptr && entry->upload;
+}
+
+bool HttpServer::dispatch(EventLoop* loop, int fd, uint64_t conn_id, std::string raw_request, bool keep_alive,
+                          std::vector<MultipartPart> parts) {
+    auto uploaded = std::make_shared<std::vector<MultipartPart>>(std::move(parts));
+    auto remove_temp_files = [uploaded]() {
+        for (const auto& part : *uploaded) {
+            if (!part.temp_path.empty()) {
+                unlink(part.temp_path.c_str());  // 处理器已移走的文件会返回ENOENT，忽略即可
+            }
+        }
+    };
+    
+    // 按请求行找到路由的并发限制，名额用尽时与线程池满一样快速拒绝
+    std::string_view line(raw_request.data(), raw_request.find("\r\n"));
+    size_t method_end = line.find(' ');
+    size_t target_end = line.find(' ', method_end + 1);
+    RouteLimit* limit = nullptr;
+    if (method_end != std::string_view::npos && target_end != std::string_view::npos) {
+        std::string_view target = line.substr(method_end + 1, target_end - method_end - 1);
+        limit = find_route_limit(line.substr(0, method_end), target.substr(0, target.find('?')));
+    }
+    bool head_only = line.substr(0, method_end) == "HEAD";
+    if (limit != nullptr && limit->inflight.fetch_add(1) >= limit->max_inflight) {
+        limit->inflight.fetch_sub(1);
+        remove_temp_files();
+        return false;
+    }
     
-    // 读取并解析HTTP头部
-    while (!headers_complete && total_read < sizeof(buffer) - 1) {
-        ssize_t bytes_read = recv(client_fd, buffer + total_read, sizeof(buffer) - 1 - total_read, 0);
-        if (bytes_read <= 0) {
-            close(client_fd);
-            return;
+    auto task = [this, loop, fd, conn_id, keep_alive, head_only, raw = std::move(raw_request), uploaded,
+                 remove_temp_files, limit]() mutable {
+        std::vector<OutputChunk> output;
+        try {
+            HttpRequest request = parse_request(std::move(raw));
+            request.parts = *uploaded;
+            HttpResponse response = handleRoute(request);
+            set_connection_headers(response, keep_alive);
+            output = build_output(request, response);
+        } catch (const std::exception& e) {
+            HttpResponse response;
+            response.status_code = 500;
+            response.body = "Internal Server Error";
+            set_connection_headers(response, keep_alive);
+            output.clear();
+            output.emplace_back(head_only ? generate_head(response, response.body.size()) : generate_response(response));
+        }
+        remove_temp_files();
+        if (limit != nullptr) {
+            limit->inflight.fetch_sub(1);
+        }
+        loop->post_response(fd, conn_id, std::move(output));
+    };
+    if (!worker_pool_->submit(std::move(task))) {
+        remove_temp_files();
+        if (limit != nullptr) {
+            limit->inflight.fetch_sub(1);
+        }
+        return false;
+    }
+    return true;
+}
+
+void HttpServer::set_connection_headers(HttpResponse& response, bool keep_alive) {
+    if (keep_alive) {
+        response.headers["Connection"] = "keep-alive";
+        response.headers["Keep-Alive"] = "timeout=" + std::to_string(keep_alive_timeout_) +
+                                         ", max=" + std::to_string(max_keep_alive_requests_);
+    } else {
+        response.headers["Connection"] = "close";
+    }
+}
+
+void HttpServer::set_file_validators(HttpResponse& response, off_t size, time_t mtime, long mtime_nsec,
+                                     off_t offset, size_t length) {
+    if (response.headers.find("Last-Modified") == response.headers.end()) {
+        response.headers["Last-Modified"] = format_http_date(mtime);
+    }
+    if (response.headers.find("ETag") == response.headers.end()) {
+        std::ostringstream etag;
+        etag << "\"" << std::hex << size << "-" << mtime << "." << mtime_nsec << "-" << offset;
+        if (offset + static_cast<off_t>(length) < size) {
+            etag << "-" << length;  // 只发送文件的一段（如预览分页）时，不同长度的段是不同的实体
         }
+        etag << "\"";
+        response.headers["ETag"] = etag.str();
+    }
+}
+
+std::vector<OutputChunk> HttpServer::build_output(const HttpRequest& request, HttpResponse& response) {
+    std::vector<OutputChunk> output;
+    
+    // HEAD只发送响应头，Content-Length等仍按GET时的实体生成；响应体不能发出，
+    // 否则会被同一连接上的客户端当作下一个响应的开头
+    bool head_only = request.method == "HEAD";
+    bool cacheable = request.method == "GET" || head_only;
+    auto push_memory_response = [&]() {
+        output.emplace_back(head_only ? generate_head(response, response.body.size()) : generate_response(response));
+    };
+    
+    // 打开文件响应体，确定实体范围
+    std::shared_ptr<FileHandle> file;
+    size_t entity_size = response.body.size();
+    off_t entity_offset = 0;
+    if (!response.file_path.empty()) {
+        int file_fd = open(response.file_path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (file_fd < 0 || fstat(file_fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            if (file_fd >= 0) {
+                close(file_fd);
+            }
+            response.file_path.clear();
+            response.status_code = 404;
+            response.body = "Not Found";
+            response.headers.erase("Content-Disposition");
+            response.headers["Content-Type"] = "text/plain";
+            push_memory_response();
+            return output;
+        }
+        file = std::make_shared<FileHandle>(file_fd);
         
-        total_read += bytes_read;
-        buffer[total_read] = '\0';
+        entity_offset = std::min<off_t>(std::max<off_t>(response.file_offset, 0), st.st_size);
+        entity_size = static_cast<size_t>(st.st_size - entity_offset);
+        if (response.file_length >= 0) {
+            entity_size = std::min(entity_size, static_cast<size_t>(response.file_length));
+        }
         
-        // 检查是否已读取完整的HTTP头部（以\r\n\r\n结束）
-        std::string current_data(buffer, total_read);
-        size_t header_end = current_data.find("\r\n\r\n");
-        if (header_end != std::string::npos) {
-            headers = current_data.substr(0, header_end + 4);
-            headers_complete = true;
+        set_file_validators(response, st.st_size, st.st_mtim.tv_sec, st.st_mtim.tv_nsec, entity_offset, entity_size);
+    } else if (response.mapped_file) {
+        const MappedFile& mapped = *response.mapped_file;
+        entity_offset = std::min<off_t>(std::max<off_t>(response.file_offset, 0), mapped.size());
+        entity_size = mapped.size() - static_cast<size_t>(entity_offset);
+        if (response.file_length >= 0) {
+            entity_size = std::min(entity_size, static_cast<size_t>(response.file_length));
         }
+        set_file_validators(response, mapped.size(), mapped.mtime(), mapped.mtime_nsec(), entity_offset, entity_size);
+    } else if (response.shared_body) {
+        entity_size = response.shared_body->size();
     }
-    
-    if (!headers_complete) {
-        close(client_fd);
-        return;
+    std::shared_ptr<const MappedFile> mapping = response.mapped_file;
+    std::shared_ptr<const std::string> shared = response.shared_body;
+    
+    // 缓存验证器匹配时只返回304，不发送内容
+    if (response.status_code == 200 && cacheable && is_not_modified(request, response)) {
+        response.status_code = 304;
+        response.body.clear();
+        response.file_path.clear();
+        response.mapped_file.reset();
+        response.shared_body.reset();
+        response.headers.erase("Content-Disposition");
+        output.emplace_back(generate_head(response, 0));
+        return output;
     }
     
-    // 解析Content-Length
-    size_t content_length = 0;
-    size_t cl_pos = headers.find("Content-Length:");
-    if (cl_pos == std::string::npos) {
-        cl_pos = headers.find("content-length:");
+    // 共享响应体已是处理器选好的表示（如预压缩变体），不再压缩
+    if (!file && !mapping && !shared) {
+        compress_body(request, response);
+        entity_size = response.body.size();
     }
     
-    if (cl_pos != std::string::npos) {
-        size_t value_start = headers.find(":", cl_pos) + 1;
-        size_t value_end = headers.find("\r\n", value_start);
-        if (value_end != std::string::npos) {
-            std::string length_str = headers.substr(value_start, value_end - value_start);
-            // 移除前导空格
-            length_str.erase(0, length_str.find_first_not_of(' '));
-            content_length = std::stoull(length_str);
+    // 文件和映射响应默认支持Range；内存响应需处理器显式声明Accept-Ranges
+    bool rangeable = file || mapping || response.headers.find("Accept-Ranges") != response.headers.end();
+    std::vector<ByteRange> ranges;
+    bool use_ranges = false;
+    
+    if (rangeable) {
+        response.headers["Accept-Ranges"] = "bytes";
+        
+        auto range_it = request.headers.find("range");
+        if (range_it != request.headers.end() && response.status_code == 200 && request.method == "GET") {
+            // If-Range不匹配时说明客户端缓存的版本已过期，返回完整内容
+            bool if_range_ok = true;
+            auto if_range_it = request.headers.find("if-range");
+            if (if_range_it != request.headers.end()) {
+                std::string validator = trim_spaces(if_range_it->second);
+                auto etag_it = response.headers.find("ETag");
+                auto modified_it = response.headers.find("Last-Modified");
+                if_range_ok = (!validator.empty() && validator[0] == '"')
+                    ? (etag_it != response.headers.end() && etag_it->second == validator)
+                    : (modified_it != response.headers.end() && modified_it->second == validator);
+            }
+            use_ranges = if_range_ok && parse_range_header(range_it->second, entity_size, ranges);
         }
     }
     
-    // 构建完整的HTTP请求
-    std::string raw_request = headers;
-    
-    // 如果有body内容，继续读取
-    if (content_length > 0) {
-        // 检查header中是否已经包含了部分body
-        size_t header_end = headers.find("\r\n\r\n");
-        size_t body_in_buffer = total_read - (header_end + 4);
-        
-        // 为body数据分配足够的空间
-        std::vector<char> body_buffer(content_length);
-        size_t body_read = 0;
-        
-        // 如果缓冲区中已有部分body数据
-        if (body_in_buffer > 0) {
-            size_t copy_size = std::min(body_in_buffer, content_length);
-            memcpy(body_buffer.data(), buffer + header_end + 4, copy_size);
-            body_read = copy_size;
+    auto push_entity_slice = [&](size_t start, size_t length) {
+        if (head_only) {
+            return;
         }
-        
-        // 继续读取剩余的body数据
-        while (body_read < content_length) {
-            ssize_t bytes_read = recv(client_fd, body_buffer.data() + body_read, 
-                                    content_length - body_read, 0);
-            if (bytes_read <= 0) {
-                break;
-            }
-            body_read += bytes_read;
+        if (file) {
+            output.emplace_back(file, entity_offset + static_cast<off_t>(start), length);
+        } else if (mapping) {
+            output.emplace_back(mapping, entity_offset + static_cast<off_t>(start), length);
+        } else if (shared) {
+            output.emplace_back(shared, static_cast<off_t>(start), length);
+        } else {
+            output.emplace_back(response.body.substr(start, length));
         }
-        
-        // 将body添加到请求中
-        raw_request.append(body_buffer.data(), body_read);
+    };
+    
+    if (!use_ranges) {
+        if (file || mapping || shared) {
+            output.emplace_back(generate_head(response, entity_size));
+            push_entity_slice(0, entity_size);
+        } else {
+            push_memory_response();
+        }
+        return output;
     }
     
-    HttpRequest request = parse_request(raw_request);
-    HttpResponse response;
+    if (ranges.empty()) {
+        // 所有区间都不可满足
+        response.status_code = 416;
+        response.headers["Content-Range"] = "bytes */" + std::to_string(entity_size);
+        response.headers.erase("Content-Disposition");
+        response.file_path.clear();
+        response.mapped_file.reset();
+        response.shared_body.reset();
+        response.body.clear();
+        push_memory_response();
+        return output;
+    }
     
-    std::string route_key = request.method + " " + request.path;
-    auto route_iter = routes_.find(route_key);
+    response.status_code = 206;
     
-    if (route_iter != routes_.end()) {
-        route_iter->second(request, response);
-    } else {
-        if (!handle_static_file(request.path, response)) {
-            response.status_code = 404;
-            response.body = "Not Found";
-        }
+    if (ranges.size() == 1) {
+        const ByteRange& range = ranges[0];
+        response.headers["Content-Range"] = "bytes " + std::to_string(range.start) + "-" +
+            std::to_string(range.start + range.length - 1) + "/" + std::to_string(entity_size);
+        output.emplace_back(generate_head(response, range.length));
+        push_entity_slice(range.start, range.length);
+        return output;
     }
     
-    std::string response_str = generate_response(response);
-    send(client_fd, response_str.c_str(), response_str.length(), 0);
+    // 多区间：multipart/byteranges，各分段头部在内存中，数据部分仍走sendfile或映射
+    std::string boundary = make_boundary();
+    std::string part_type;
+    auto type_it = response.headers.find("Content-Type");
+    if (type_it != response.headers.end()) {
+        part_type = "Content-Type: " + type_it->second + "\r\n";
+    }
     
-    close(client_fd);
+    std::vector<std::string> part_heads;
+    size_t total_length = 0;
+    for (const auto& range : ranges) {
+        std::string head = "\r\n--" + boundary + "\r\n" + part_type +
+            "Content-Range: bytes " + std::to_string(range.start) + "-" +
+            std::to_string(range.start + range.length - 1) + "/" + std::to_string(entity_size) + "\r\n\r\n";
+        total_length += head.size() + range.length;
+        part_heads.push_back(std::move(head));
+    }
+    std::string closing = "\r\n--" + boundary + "--\r\n";
+    total_length += closing.size();
+    
+    response.headers["Content-Type"] = "multipart/byteranges; boundary=" + boundary;
+    output.emplace_back(generate_head(response, total_length));
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        output.emplace_back(std::move(part_heads[i]));
+        push_entity_slice(ranges[i].start, ranges[i].length);
+    }
+    output.emplace_back(std::move(closing));
+    return output;
 }
 
-HttpRequest HttpServer::parse_request(const std::string& raw_request) {
-    HttpRequest request;
+void HttpServer::setIncompressibleTypes(const std::set<std::string>& mime_types) {
+    incompressible_types_ = mime_types;
+}
+
+bool HttpServer::is_compressible(const std::string& content_type) const {
+    std::string type = content_type.substr(0, content_type.find(';'));
+    type.erase(type.find_last_not_of(" \t") + 1);
+    std::transform(type.begin(), type.end(), type.begin(), ::tolower);
+    if (type.empty() || type == "application/octet-stream") {
+        return false;
+    }
+    return incompressible_types_.count(type) == 0;
+}
+
+bool HttpServer::is_not_modified(const HttpRequest& request, const HttpResponse& response) {
+    // If-None-Match存在时优先于If-Modified-Since
+    auto none_match_it = request.headers.find("if-none-match");
+    if (none_match_it != request.headers.end()) {
+        auto etag_it = response.headers.find("ETag");
+        return etag_it != response.headers.end() && etag_list_matches(none_match_it->second, etag_it->second);
+    }
     
-    std::istringstream iss(raw_request);
-    std::string line;
+    auto since_it = request.headers.find("if-modified-since");
+    auto modified_it = response.headers.find("Last-Modified");
+    if (since_it == request.headers.end() || modified_it == response.headers.end()) {
+        return false;
+    }
+    time_t since, modified;
+    if (!parse_http_date(trim_spaces(since_it->second), since) || !parse_http_date(modified_it->second, modified)) {
+        return false;
+    }
+    return modified <= since;
+}
+
+void HttpServer::compress_body(const HttpRequest& request, HttpResponse& response) {
+    if (response.status_code != 200 || response.body.size() < kCompressMinSize ||
+        response.body.size() > kCompressMaxSize || response.headers.count("Content-Encoding") > 0 || response.headers.count("Accept-Ranges") > 0) {
+        return;
+    }
+    auto type_it = response.headers.find("Content-Type");
+    if (type_it == response.headers.end() || !is_compressible(type_it->second)) {
+        return;
+    }
+    response.headers["Vary"] = "Accept-Encoding";
     
-    if (std::getline(iss, line)) {
-        std::istringstream line_iss(line);
-        std::string path_query;
-        line_iss >> request.method >> path_query;
-        
-        size_t query_pos = path_query.find('?');
-        if (query_pos != std::string::npos) {
-            request.path = path_query.substr(0, query_pos);
-            request.query_string = path_query.substr(query_pos + 1);
-            request.params = parse_query_params(request.query_string);
-        } else {
-            request.path = path_query;
-        }
-        
-        request.path = url_decode(request.path);
+    auto accept_it = request.headers.find("accept-encoding");
+    if (accept_it == request.headers.end()) {
+        return;
+    }
+    ContentEncoding encoding = Compression::negotiate(accept_it->second, false);
+    if (encoding == ContentEncoding::Identity) {
+        return;
     }
     
-    // 解析头部
-    bool headers_done = false;
-    while (std::getline(iss, line) && !headers_done) {
-        // 移除行尾的\r
-        if (!line.empty() && line.back() == '\r') {
-            line.pop_back();
-        }
-        
-        // 空行表示头部结束
-        if (line.empty()) {
-            headers_done = true;
-            break;
-        }
-        
-        size_t colon_pos = line.find(':');
-        if (colon_pos != std::string::npos) {
-            std::string name = line.substr(0, colon_pos);
-            std::string value = line.substr(colon_pos + 1);
-            
-            value.erase(0, value.find_first_not_of(' '));
-            
-            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
-            request.headers[name] = value;
+    std::string compressed;
+    compressed.reserve(response.body.size() / 4);
+    if (Compression::zlib_compress(response.body, encoding, compressed) &&
+        compressed.size() < response.body.size()) {
+        response.body.swap(compressed);
+        response.headers["Content-Encoding"] = Compression::encoding_name(encoding);
+    }
+}
+
+std::string HttpServer::overload_response() {
+    HttpResponse response;
+    response.status_code = 503;
+    response.body = "Service Unavailable";
+    response.headers["Connection"] = "close";
+    response.headers["Retry-After"] = "1";
+    return generate_response(response);
+}
+
+HttpResponse HttpServer::handleRoute(HttpRequest& request) {
+    HttpResponse response;
+    
+    HttpMethod method = Router::parse_method(request.method);
+    const RouteEntry* entry;
+    RouteParams params;
+    std::string allow;
+    Router::Result result = router_.match(method, request.path, entry, params, &allow);
+    
+    if (result == Router::Result::Found) {
+        for (size_t i = 0; i < params.count; ++i) {
+            request.params[std::string(params.items[i].first)].assign(params.items[i].second);
         }
+        entry->handler(request, response);
+    } else if (result == Router::Result::MethodNotAllowed && method == HttpMethod::OPTIONS) {
+        // 跨域预检：路径存在时返回204，允许的方法和请求头由generate_head统一附加
+        response.status_code = 204;
+        response.headers["Allow"] = allow;
+    } else if (result == Router::Result::MethodNotAllowed) {
+        response.status_code = 405;
+        response.body = "Method Not Allowed";
+        response.headers["Allow"] = allow;
+    } else if ((method != HttpMethod::GET && method != HttpMethod::HEAD) || !handle_static_file(request, response)) {
+        response.status_code = 404;
+        response.body = "Not Found";
     }
     
-    // 解析body - 直接从原始请求中提取
-    size_t header_end = raw_request.find("\r\n\r\n");
-    if (header_end != std::string::npos) {
-        request.body = raw_request.substr(header_end + 4);
+    return response;
+}
+
+HttpRequest HttpServer::parse_request(std::string raw_request) {
+    HttpRequest request;
+    
+    // 事件循环已校验过请求头，这里再解析一次得到指向raw_request的视图
+    ParsedRequest parsed;
+    if (HttpParser::parse_head(raw_request.data(), raw_request.size(), parsed, raw_request.size()) !=
+        HttpParser::Result::Complete) {
+        throw std::runtime_error("malformed request head");
+    }
+    
+    request.method.assign(parsed.method);
+    request.version.assign(parsed.version);
+    request.path = url_decode(std::string(parsed.path));
+    if (!parsed.query.empty()) {
+        request.query_string.assign(parsed.query);
+        request.params = parse_query_params(request.query_string);
     }
     
+    // 头部名称统一转为小写
+    for (size_t i = 0; i < parsed.header_count; ++i) {
+        std::string name(parsed.headers[i].name);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        request.headers[name].assign(parsed.headers[i].value);
+    }
+    
+    // 请求体原地保留，去掉请求头部分后移交给request，避免再复制一份
+    raw_request.erase(0, parsed.head_length);
+    request.body = std::move(raw_request);
+    
     return request;
 }
 
 std::string HttpServer::generate_response(const HttpResponse& response) {
+    return generate_head(response, response.body.length()) + response.body;
+}
+
+std::string HttpServer::generate_head(const HttpResponse& response, size_t content_length) {
     std::ostringstream oss;
     
     oss << "HTTP/1.1 " << response.status_code;
     switch (response.status_code) {
         case 200: oss << " OK"; break;
+        case 204: oss << " No Content"; break;
+        case 206: oss << " Partial Content"; break;
+        case 304: oss << " Not Modified"; break;
         case 400: oss << " Bad Request"; break;
         case 401: oss << " Unauthorized"; break;
         case 403: oss << " Forbidden"; break;
         case 404: oss << " Not Found"; break;
         case 405: oss << " Method Not Allowed"; break;
+        case 409: oss << " Conflict"; break;
+        case 413: oss << " Payload Too Large"; break;
+        case 415: oss << " Unsupported Media Type"; break;
+        case 416: oss << " Range Not Satisfiable"; break;
+        case 460: oss << " Checksum Mismatch"; break;
         case 500: oss << " Internal Server Error"; break;
+        case 503: oss << " Service Unavailable"; break;
         default: oss << " Unknown"; break;
     }
     oss << "\r\n";
     
-    oss << "Content-Length: " << response.body.length() << "\r\n";
+    // 304没有响应体，也不能声明与完整响应不一致的长度；204不允许带Content-Length
+    if (response.status_code != 304 && response.status_code != 204) {
+        oss << "Content-Length: " << content_length << "\r\n";
+    }
     
     for (const auto& header : response.headers) {
+        if (header.first == "Content-Length") {
+            continue;  // 由上面统一生成，避免重复
+        }
         oss << header.first << ": " << header.second << "\r\n";
     }
     
     oss << "Access-Control-Allow-Origin: *\r\n";
-    oss << "Access-Control-Allow-Methods: GET, POST, PUT, DELETE, OPTIONS\r\n";
-    oss << "Access-Control-Allow-Headers: Content-Type, Authorization\r\n";
+    oss << "Access-Control-Allow-Methods: GET, HEAD, POST, PUT, PATCH, DELETE, OPTIONS\r\n";
+    oss << "Access-Control-Allow-Headers: Content-Type, Authorization, Range, Upload-Offset, Upload-Checksum\r\n";
+    oss << "Access-Control-Expose-Headers: Content-Range, Accept-Ranges, Location, Upload-Offset, Upload-Length\r\n";
     
     oss << "\r\n";
     
-    oss << response.body;
-    
     return oss.str();
 }
 
-bool HttpServer::handle_static_file(const std::string& path, HttpResponse& response) {
+bool HttpServer::handle_static_file(const HttpRequest& request, HttpResponse& response) {
+    const std::string& path = request.path;
+    if (path.find("..") != std::string::npos) {
+        return false;
+    }
+    
     std::string file_path = static_root_;
     
     if (path == "/") {
@@ -306,38 +840,51 @@ bool HttpServer::handle_static_file(const std::string& path, HttpResponse& respo
         file_path += path;
     }
     
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file.is_open()) {
-        return false;
-    }
-    
-    std::ostringstream oss;
-    oss << file.rdbuf();
-    response.body = oss.str();
-    
-    std::string ext;
-    size_t dot_pos = file_path.find_last_of('.');
-    if (dot_pos != std::string::npos) {
-        ext = file_path.substr(dot_pos + 1);
-    }
-    
-    if (ext == "html") {
-        response.headers["Content-Type"] = "text/html; charset=utf-8";
-    } else if (ext == "css") {
-        response.headers["Content-Type"] = "text/css";
-    } else if (ext == "js") {
-        response.headers["Content-Type"] = "application/javascript";
-    } else if (ext == "json") {
-        response.headers["Content-Type"] = "application/json";
-    } else if (ext == "png") {
-        response.headers["Content-Type"] = "image/png";
-    } else if (ext == "jpg" || ext == "jpeg") {
-        response.headers["Content-Type"] = "image/jpeg";
-    } else {
-        response.headers["Content-Type"] = "application/octet-stream";
+    std::shared_ptr<const StaticAsset> asset = asset_cache_ ? asset_cache_->find(file_path) : nullptr;
+    if (!asset) {
+        // 未缓存（超出容量或过大）的文件直接sendfile，验证器由build_output按mtime生成
+        struct stat st;
+        if (stat(file_path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            return false;
+        }
+        response.set_file_body(file_path);
+        response.headers["Content-Type"] = AssetCache::content_type_for(file_path);
+        response.headers["Cache-Control"] = "no-cache";
+        response.status_code = 200;
+        return true;
     }
     
     response.status_code = 200;
+    response.headers["Content-Type"] = asset->content_type;
+    response.headers["Last-Modified"] = asset->last_modified;
+    response.headers["Cache-Control"] = asset->cache_control;
+    
+    // 按Accept-Encoding选择预压缩变体；Range请求针对原始内容。
+    // 响应体与缓存共享所选变体，由shared_ptr保证资源被重新加载时仍然有效
+    const std::string* body = &asset->body;
+    std::string etag = asset->etag;
+    if (!asset->gzip.empty() || !asset->brotli.empty()) {
+        response.headers["Vary"] = "Accept-Encoding";
+        auto accept_it = request.headers.find("accept-encoding");
+        if (accept_it != request.headers.end() && request.headers.count("range") == 0) {
+            ContentEncoding encoding = Compression::negotiate(accept_it->second, !asset->brotli.empty());
+            if (encoding == ContentEncoding::Brotli) {
+                body = &asset->brotli;
+            } else if (encoding == ContentEncoding::Gzip && !asset->gzip.empty()) {
+                body = &asset->gzip;
+            }
+            if (body != &asset->body) {
+                // 不同编码是不同的表示，ETag须区分
+                response.headers["Content-Encoding"] = Compression::encoding_name(encoding);
+                etag.insert(etag.size() - 1, std::string("-") + Compression::encoding_name(encoding));
+            }
+        }
+    }
+    if (body == &asset->body) {
+        response.headers["Accept-Ranges"] = "bytes";
+    }
+    response.headers["ETag"] = etag;
+    response.set_shared_body(std::shared_ptr<const std::string>(asset, body));
     return true;
 }
 
@@ -368,6 +915,14 @@ void HttpServer::add_post_route(const std::string& path, RouteHandler handler) {
     addRoute("POST", path, handler);
 }
 
+void HttpServer::add_upload_route(const std::string& path, RouteHandler handler) {
+    RouteEntry* entry = register_route("POST", path);
+    if (entry != nullptr) {
+        entry->handler = std::move(handler);
+        entry->upload = true;
+    }
+}
+
 std::map<std::string, std::string> HttpServer::parse_query_params(const std::string& query_string) {
     std::map<std::string, std::string> params;
     
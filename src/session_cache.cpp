@@ -0,0 +1,148 @@
+#include "session_cache.h"
+#include <iostream>
+#include <cstring>
+
+SessionCache::SessionCache() : stopping_(false) {
+}
+
+SessionCache::~SessionCache() {
+    stop_sweeper();
+}
+
+SessionCache::Shard& SessionCache::shard_for(const std::string& session_id) {
+    return shards_[std::hash<std::string>()(session_id) % kShardCount];
+}
+
+bool SessionCache::get(const std::string& session_id, CachedSession& session) {
+    Shard& shard = shard_for(session_id);
+    time_t now = time(nullptr);
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.sessions.find(session_id);
+        if (it == shard.sessions.end()) {
+            return false;
+        }
+        if (it->second.expires > now) {
+            session = it->second;
+            return true;
+        }
+    }
+    
+    // 惰性过期：重新加写锁后再确认一次，期间可能已被续期或删除
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(session_id);
+    if (it != shard.sessions.end() && it->second.expires <= now) {
+        shard.sessions.erase(it);
+    }
+    return false;
+}
+
+void SessionCache::put(const std::string& session_id, const CachedSession& session) {
+    Shard& shard = shard_for(session_id);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    shard.sessions[session_id] = session;
+}
+
+void SessionCache::erase(const std::string& session_id) {
+    Shard& shard = shard_for(session_id);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    shard.sessions.erase(session_id);
+    shard.epoch++;
+}
+
+uint64_t SessionCache::epoch(const std::string& session_id) {
+    Shard& shard = shard_for(session_id);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.epoch;
+}
+
+bool SessionCache::put_if_unchanged(const std::string& session_id, const CachedSession& session, uint64_t epoch) {
+    Shard& shard = shard_for(session_id);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    if (shard.epoch != epoch) {
+        return false;
+    }
+    shard.sessions[session_id] = session;
+    return true;
+}
+
+void SessionCache::erase_user(int user_id) {
+    for (Shard& shard : shards_) {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.epoch++;
+        for (auto it = shard.sessions.begin(); it != shard.sessions.end();) {
+            if (it->second.user_id == user_id) {
+                it = shard.sessions.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+size_t SessionCache::sweep() {
+    time_t now = time(nullptr);
+    size_t removed = 0;
+    // 逐个分片加锁，清理期间其他分片的鉴权不受影响
+    for (Shard& shard : shards_) {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        for (auto it = shard.sessions.begin(); it != shard.sessions.end();) {
+            if (it->second.expires <= now) {
+                it = shard.sessions.erase(it);
+                ++removed;
+            } else {
+                ++it;
+            }
+        }
+    }
+    return removed;
+}
+
+size_t SessionCache::size() const {
+    size_t total = 0;
+    for (const Shard& shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        total += shard.sessions.size();
+    }
+    return total;
+}
+
+void SessionCache::start_sweeper(std::chrono::seconds interval, std::function<void()> on_sweep) {
+    stop_sweeper();
+    {
+        std::lock_guard<std::mutex> lock(sweeper_mutex_);
+        stopping_ = false;
+    }
+    sweeper_ = std::thread([this, interval, on_sweep]() {
+        std::unique_lock<std::mutex> lock(sweeper_mutex_);
+        while (!sweeper_cond_.wait_for(lock, interval, [this]() { return stopping_; })) {
+            lock.unlock();
+            sweep();
+            if (on_sweep) {
+                on_sweep();
+            }
+            lock.lock();
+        }
+    });
+}
+
+void SessionCache::stop_sweeper() {
+    {
+        std::lock_guard<std::mutex> lock(sweeper_mutex_);
+        stopping_ = true;
+    }
+    sweeper_cond_.notify_all();
+    if (sweeper_.joinable()) {
+        sweeper_.join();
+    }
+}
+
+time_t SessionCache::parse_timestamp(const std::string& text) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char* end = strptime(text.c_str(), "%Y-%m-%d %H:%M:%S", &tm);
+    if (end == nullptr || *end != '\0') {
+        return 0;
+    }
+    return timegm(&tm);
+}
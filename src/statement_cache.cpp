@@ -0,0 +1,87 @@
+#include "statement_cache.h"
+#include <iostream>
+
+StatementCache::Handle& StatementCache::Handle::operator=(Handle&& other) noexcept {
+    if (this != &other) {
+        release();
+        cache_ = other.cache_;
+        sql_ = other.sql_;
+        stmt_ = other.stmt_;
+        other.stmt_ = nullptr;
+    }
+    return *this;
+}
+
+void StatementCache::Handle::release() {
+    if (stmt_ != nullptr) {
+        cache_->give_back(sql_, stmt_);
+        stmt_ = nullptr;
+    }
+}
+
+StatementCache::StatementCache(sqlite3* db) : db_(db), hits_(0), misses_(0) {
+}
+
+StatementCache::~StatementCache() {
+    clear();
+}
+
+void StatementCache::attach(sqlite3* db) {
+    clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    db_ = db;
+}
+
+StatementCache::Handle StatementCache::acquire(std::string_view sql) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (db_ == nullptr) {
+        return Handle();
+    }
+    
+    auto it = idle_.find(sql);
+    if (it != idle_.end() && !it->second.empty()) {
+        sqlite3_stmt* stmt = it->second.back();
+        it->second.pop_back();
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return Handle(this, it->first, stmt);
+    }
+    if (it == idle_.end()) {
+        it = idle_.emplace(std::string(sql), std::vector<sqlite3_stmt*>()).first;
+    }
+    sqlite3* db = db_;
+    lock.unlock();
+    
+    // 编译不需要持有缓存锁；键字符串存放在map节点中，插入后地址不变
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v3(db, sql.data(), static_cast<int>(sql.size()), SQLITE_PREPARE_PERSISTENT,
+                           &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "SQL编译失败: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(stmt);
+        return Handle();
+    }
+    return Handle(this, it->first, stmt);
+}
+
+void StatementCache::give_back(std::string_view sql, sqlite3_stmt* stmt) {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = idle_.find(sql);
+    if (it == idle_.end() || it->second.size() >= kMaxIdlePerSql) {
+        sqlite3_finalize(stmt);
+        return;
+    }
+    it->second.push_back(stmt);
+}
+
+void StatementCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : idle_) {
+        for (sqlite3_stmt* stmt : entry.second) {
+            sqlite3_finalize(stmt);
+        }
+        entry.second.clear();
+    }
+}
@@ -0,0 +1,93 @@
+#include "sync_batcher.h"
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+SyncBatcher::SyncBatcher()
+    : fd_(-1), window_(0), requested_(0), completed_(0), failed_(0), batches_(0), stopping_(false) {
+}
+
+SyncBatcher::~SyncBatcher() {
+    stop();
+}
+
+bool SyncBatcher::start(const std::string& path, std::chrono::milliseconds window) {
+    stop();
+    fd_ = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd_ < 0) {
+        std::cerr << "打开同步目录失败: " << path << std::endl;
+        return false;
+    }
+    window_ = window;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = false;
+    }
+    thread_ = std::thread(&SyncBatcher::run, this);
+    return true;
+}
+
+void SyncBatcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    request_cond_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool SyncBatcher::running() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return thread_.joinable() && !stopping_;
+}
+
+bool SyncBatcher::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopping_ || !thread_.joinable()) {
+        return false;
+    }
+    uint64_t ticket = ++requested_;
+    request_cond_.notify_one();
+    done_cond_.wait(lock, [this, ticket]() { return completed_ >= ticket || stopping_; });
+    return completed_ >= ticket && failed_ < ticket;
+}
+
+uint64_t SyncBatcher::batches() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return batches_;
+}
+
+void SyncBatcher::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        request_cond_.wait(lock, [this]() { return requested_ > completed_ || stopping_; });
+
+        // 窗口为0时立即同步，上一次syncfs期间到达的请求自然合并为下一批；
+        // 否则再等一个窗口收集更多等待者。停止时立即同步剩余请求
+        if (!stopping_ && window_.count() > 0) {
+            request_cond_.wait_for(lock, window_, [this]() { return stopping_; });
+        }
+        uint64_t target = requested_;
+        if (target == completed_) {
+            break;  // 停止且没有未完成的请求
+        }
+
+        lock.unlock();
+        bool ok = syncfs(fd_) == 0;
+        lock.lock();
+
+        if (!ok) {
+            std::cerr << "syncfs失败，本批 " << target - completed_ << " 个文件未确认落盘" << std::endl;
+            failed_ = target;
+        }
+        completed_ = target;
+        ++batches_;
+        done_cond_.notify_all();
+    }
+}
@@ -0,0 +1,135 @@
+#include "thread_pool.h"
+#include <iostream>
+#include <chrono>
+
+namespace {
+const std::chrono::milliseconds kRecheckInterval(1);
+}
+
+ThreadPool::ThreadPool(size_t thread_count, size_t max_queue_size)
+    : max_queue_size_(max_queue_size), queued_(0), next_queue_(0), steals_(0), stopping_(false) {
+    if (thread_count == 0) {
+        thread_count = 1;
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this, i]() { worker_loop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    shutdown();
+}
+
+bool ThreadPool::submit(std::function<void()> task) {
+    if (stopping_) {
+        return false;
+    }
+
+    // 先占用名额再入队，保证排队总数不超过上限
+    if (queued_.fetch_add(1) >= max_queue_size_) {
+        queued_.fetch_sub(1);
+        return false;
+    }
+
+    WorkQueue& queue = *queues_[next_queue_.fetch_add(1) % queues_.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+
+    // 空锁保证休眠线程要么已看到新任务，要么已进入wait能收到通知
+    { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+    cond_.notify_one();
+    return true;
+}
+
+void ThreadPool::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        if (stopping_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    cond_.notify_all();
+
+    for (auto& worker : workers_) {
+        if (worker.joinable() && worker.get_id() != std::this_thread::get_id()) {
+            worker.join();
+        }
+    }
+}
+
+bool ThreadPool::pop_local(size_t index, std::function<void()>& task) {
+    WorkQueue& queue = *queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    return true;
+}
+
+bool ThreadPool::steal(size_t index, std::function<void()>& task) {
+    // 第一轮只尝试加锁，不与正在存取的线程争用；有队列因锁被跳过时第二轮阻塞加锁，
+    // 否则唯一的任务恰好在被跳过的队列里时，空闲线程会反复查找而不休眠
+    bool skipped = false;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t i = 1; i < queues_.size(); ++i) {
+            WorkQueue& victim = *queues_[(index + i) % queues_.size()];
+            std::unique_lock<std::mutex> lock(victim.mutex, std::defer_lock);
+            if (pass == 0 && !lock.try_lock()) {
+                skipped = true;
+                continue;
+            }
+            if (pass == 1) {
+                lock.lock();
+            }
+            if (victim.tasks.empty()) {
+                continue;
+            }
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            steals_++;
+            return true;
+        }
+        if (!skipped) {
+            break;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::worker_loop(size_t index) {
+    while (true) {
+        std::function<void()> task;
+        if (pop_local(index, task) || steal(index, task)) {
+            queued_.fetch_sub(1);
+            // 任务抛出的异常不能让工作线程退出
+            try {
+                task();
+            } catch (const std::exception& e) {
+                std::cerr << "线程池任务异常: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "线程池任务抛出未知异常" << std::endl;
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        if (queued_.load() > 0) {
+            // 计数已增加但任务尚未入队，或已出队尚未减计数：短暂等待后重新查找，不空转。
+            // 入队完成后submit会通知；通知若先于这里的等待发出，最多多等一个周期
+            cond_.wait_for(lock, kRecheckInterval);
+            continue;
+        }
+        if (stopping_) {
+            return;  // 已停止且队列已清空
+        }
+        cond_.wait(lock, [this]() { return stopping_ || queued_.load() > 0; });
+    }
+}
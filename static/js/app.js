@@ -69,6 +69,9 @@ createApp({
             // 预览相关
             previewFileData: null,
             previewContent: '',
+            previewNext: null,          // 下一页的查询参数，为null时已到文件末尾
+            previewLoading: false,
+            previewTotalLines: 0,
             
             // 消息提示
             message: null
@@ -574,12 +577,10 @@ createApp({
         async loadPreviewContent(file) {
             try {
                 if (this.isTextFile(file.filename)) {
-                    console.log('Loading text file content...');
-                    const response = await axios.get(`/api/download?id=${file.id}`, {
-                        responseType: 'text'
-                    });
-                    console.log('Text content loaded:', response.data.substring(0, 50));
-                    this.previewContent = response.data;
+                    // 分页加载，大文件只取第一页，滚动到底部后再加载更多
+                    this.previewContent = '';
+                    this.previewNext = { line: 0 };
+                    await this.loadMorePreview();
                 } else {
                     console.log('Non-text file, setting default message');
                     this.previewContent = '此文件类型不支持预览';
@@ -590,6 +591,48 @@ createApp({
             }
         },
         
+        async loadMorePreview() {
+            const file = this.previewFileData;
+            if (!file || !this.previewNext || this.previewLoading) {
+                return;
+            }
+            this.previewLoading = true;
+            try {
+                const response = await axios.get(`/api/files/${file.id}/preview`, {
+                    params: this.previewNext,
+                    responseType: 'text',
+                    transformResponse: data => data
+                });
+                if (this.previewFileData !== file) {
+                    return;  // 加载期间已切换到其他文件
+                }
+                const headers = response.headers;
+                this.previewContent += response.data;
+                this.previewTotalLines = parseInt(headers['x-total-lines'] || '0', 10);
+                if (headers['x-preview-truncated'] !== 'true') {
+                    this.previewNext = null;
+                } else if (headers['x-next-line'] !== undefined) {
+                    this.previewNext = { line: headers['x-next-line'] };
+                } else {
+                    // 超长的单行按字节偏移继续读取
+                    this.previewNext = { offset: headers['x-next-offset'] };
+                }
+            } catch (error) {
+                console.error('Error loading preview page:', error);
+                this.previewNext = null;
+                this.showMessage('预览加载失败: ' + error.message, 'error');
+            } finally {
+                this.previewLoading = false;
+            }
+        },
+        
+        onPreviewScroll(event) {
+            const el = event.target;
+            if (el.scrollTop + el.clientHeight >= el.scrollHeight - 200) {
+                this.loadMorePreview();
+            }
+        },
+        
         downloadFile(file) {
             const link = document.createElement('a');
             link.href = `/api/download?id=${file.id}`;
@@ -968,6 +1011,7 @@ createApp({
             this.uploadCategories = [];
             this.previewFileData = null;
             this.previewContent = '';
+            this.previewNext = null;
         },
         
         // 消息提示
@@ -0,0 +1,26 @@
+// 热点查询计划检查：新建一个数据库执行全部迁移，再对热点查询做EXPLAIN QUERY PLAN，
+// 任一查询退化为全表扫描或临时排序时以非零状态退出。由ctest运行，发布构建中同样生效
+#include "database.h"
+#include <iostream>
+#include <cstdio>
+#include <string>
+
+int main(int argc, char* argv[]) {
+    std::string path = argc > 1 ? argv[1] : "check_query_plans.db";
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::remove((path + suffix).c_str());
+    }
+
+    bool ok;
+    {
+        Database db(path);
+        ok = db.initialize() && db.checkQueryPlans();
+        db.close();
+    }
+    for (const char* suffix : {"", "-wal", "-shm"}) {
+        std::remove((path + suffix).c_str());
+    }
+
+    std::cout << (ok ? "热点查询计划检查通过" : "热点查询计划检查失败") << std::endl;
+    return ok ? 0 : 1;
+}